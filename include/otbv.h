@@ -1,9 +1,286 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
 #include <string>
+#include <tuple>
 #include <vector>
 
 namespace otbv {
+/**
+ * @brief Axis-aligned box of voxels. The range is [s, e) on every axis
+ */
+struct Box {
+  size_t xs, xe, ys, ye, zs, ze;
+};
+
+/**
+ * @brief Voxel coordinates x, y, z
+ */
+using Coord = std::array<uint32_t, 3>;
+
+/**
+ * @brief Run of occupied voxels [z_start, z_end) in the row x, y
+ */
+struct Run {
+  uint32_t x, y, z_start, z_end;
+};
+
+/**
+ * @brief Homogeneous box of the encoded tree. \p box is clipped to the volume
+ */
+struct Leaf {
+  Box box;
+  bool value;
+  size_t depth;
+};
+
+/**
+ * @brief Selects the leaves reported by a traversal. \p OCCUPIED skips empty
+ * leaves
+ */
+enum class LeafFilter { ALL, OCCUPIED };
+
+/**
+ * @brief Callback receiving the leaves of a traversal
+ */
+using LeafVisitor = std::function<void(const Leaf &)>;
+
+/**
+ * @brief Classification of a box of voxels, as reported by a \ref
+ * BoxClassifier
+ */
+enum class Occupancy { EMPTY, FULL, MIXED };
+
+/**
+ * @brief Callback labelling a box of the volume as empty, full or mixed
+ */
+using BoxClassifier = std::function<Occupancy(const Box &)>;
+
+/**
+ * @brief Callback returning the value of a single voxel at x, y, z
+ */
+using VoxelClassifier = std::function<bool(size_t, size_t, size_t)>;
+
+/**
+ * @brief Indexed triangle mesh, in world coordinates
+ */
+struct TriangleMesh {
+  std::vector<std::array<double, 3>> vertices;
+  std::vector<std::array<uint32_t, 3>> triangles;
+};
+
+/**
+ * @brief Rule deciding whether a point is inside a mesh. \p PARITY counts ray
+ * crossings (even-odd), \p WINDING sums their orientation (non-zero)
+ */
+enum class InsideRule { PARITY, WINDING };
+
+/**
+ * @brief Element layout of a .npy volume. \p BOOL and \p UINT8 hold one byte
+ * per voxel of a 3-dimensional array, and any nonzero byte is occupied. \p
+ * PACKBITS is the 1-dimensional uint8 array returned by np.packbits on the
+ * flattened volume, which does not record the shape.
+ */
+enum class NpyLayout { BOOL, UINT8, PACKBITS };
+
+/**
+ * @brief Element type of a raw or NRRD volume
+ */
+enum class ScalarType {
+  UINT8,
+  INT8,
+  UINT16,
+  INT16,
+  UINT32,
+  INT32,
+  FLOAT32,
+  FLOAT64
+};
+
+/**
+ * @brief Layout of a headerless raw volume file
+ */
+struct RawLayout {
+  std::tuple<size_t, size_t, size_t> shape;
+  ScalarType type = ScalarType::UINT8;
+  // x varies fastest, rather than z
+  bool fortran_order = false;
+  bool big_endian = false;
+  // bytes before the first voxel
+  size_t offset = 0;
+};
+
+/**
+ * @brief Accumulates point batches into a set of occupied voxels, and encodes
+ * them without visiting empty space. Voxel x, y, z covers [origin + x *
+ * voxel_size, origin + (x + 1) * voxel_size) on the x axis, and likewise for y
+ * and z. Points outside of the volume are dropped.
+ */
+class PointCloudEncoder {
+public:
+  /**
+   * @param threads Number of threads used to sort each batch. 0 uses the
+   * hardware concurrency
+   * @throws std::invalid_argument If \p resolution is empty or above the
+   * allowed maximum, or \p voxel_size is not positive
+   */
+  PointCloudEncoder(const std::tuple<size_t, size_t, size_t> &resolution,
+                    const std::array<double, 3> &origin, double voxel_size,
+                    size_t threads = 0);
+
+  /**
+   * @brief Marks the voxels containing \p points as occupied
+   */
+  void insert(const std::vector<std::array<float, 3>> &points);
+
+  /**
+   * @brief Returns the number of distinct occupied voxels so far
+   */
+  size_t size() const;
+
+  /**
+   * @brief Encodes the occupied voxels inserted so far
+   */
+  std::vector<bool> encode() const;
+
+private:
+  std::tuple<size_t, size_t, size_t> resolution;
+  std::array<double, 3> origin;
+  double voxel_size;
+  size_t threads;
+  // sorted, unique Morton codes of occupied voxels
+  std::vector<uint64_t> keys;
+};
+
+/**
+ * @brief Pull-style iterator over the leaves of an encoding, in file order.
+ * Leaves lying entirely in the padding are skipped. The encoding must outlive
+ * the iterator.
+ */
+class LeafIterator {
+public:
+  LeafIterator(const std::vector<bool> &encoding,
+               const std::tuple<size_t, size_t, size_t> &resolution,
+               LeafFilter filter = LeafFilter::ALL);
+
+  /**
+   * @brief Iterates over a whole OTBV file held in memory, for example
+   * memory-mapped
+   *
+   * @throws std::runtime_error If the header is malformed
+   */
+  LeafIterator(const char *file_bytes, size_t length,
+               LeafFilter filter = LeafFilter::ALL);
+
+  LeafIterator(LeafIterator &&) noexcept;
+  LeafIterator &operator=(LeafIterator &&) noexcept;
+  ~LeafIterator();
+
+  /**
+   * @brief Stores the next leaf in \p leaf
+   *
+   * @return false once all leaves have been visited
+   * @throws std::out_of_range If the encoding ends early
+   */
+  bool next(Leaf &leaf);
+
+  /**
+   * @brief Returns the shape of the volume
+   */
+  std::tuple<size_t, size_t, size_t> resolution() const;
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl;
+};
+
+/**
+ * @brief Mutable octree held in memory, for mixes of many edits and queries.
+ * Split nodes live in a contiguous pool and refer to their children by 32-bit
+ * index, with empty and full leaves stored as tagged values. Reads and single
+ * voxel writes take O(depth).
+ *
+ * Serialisation is lazy: subtrees that were never edited are copied from the
+ * token range they were read from, and only edited ones are re-emitted. The
+ * output is canonical if the source encoding was.
+ */
+class Octree {
+public:
+  /**
+   * @brief Builds the tree from \p encoding, of shape \p resolution, in a
+   * single pass
+   *
+   * @throws std::out_of_range If the encoding ends early
+   */
+  Octree(std::vector<bool> encoding,
+         const std::tuple<size_t, size_t, size_t> &resolution);
+
+  /**
+   * @brief Builds the tree from the volume stored in \p filename
+   */
+  explicit Octree(const std::string &filename);
+
+  /**
+   * @throws std::out_of_range If the voxel lies outside of the volume
+   */
+  bool get(size_t x, size_t y, size_t z) const;
+
+  /**
+   * @throws std::out_of_range If the voxel lies outside of the volume
+   */
+  void set(size_t x, size_t y, size_t z, bool value);
+
+  /**
+   * @brief Sets every voxel of \p box to \p value. Parts of \p box outside
+   * of the volume are ignored.
+   */
+  void set_box(const Box &box, bool value);
+
+  /**
+   * @brief Returns the encoding of the current tree
+   */
+  std::vector<bool> encode() const;
+
+  /**
+   * @brief Writes the current tree to \p filename
+   */
+  void save(const std::string &filename) const;
+
+  std::tuple<size_t, size_t, size_t> resolution() const;
+
+  /**
+   * @brief Returns the number of split nodes in use
+   */
+  size_t node_count() const;
+
+private:
+  static constexpr uint32_t EMPTY = 0xfffffffe, FULL = 0xffffffff;
+
+  struct Node {
+    // index of a split child, or EMPTY or FULL
+    uint32_t children[8];
+    // tokens of the node in \p source, valid while the node is not dirty
+    size_t start, end;
+    bool dirty;
+  };
+
+  std::vector<bool> source;
+  std::tuple<size_t, size_t, size_t> shape;
+  size_t side;
+  std::vector<Node> nodes;
+  std::vector<uint32_t> free_nodes;
+  uint32_t root;
+
+  void build();
+  uint32_t allocate();
+  void release(uint32_t ref);
+};
+
 /**
  * @brief Encodes \p data and writes it to \p filename
  */
@@ -19,8 +296,829 @@ void save(const std::string &filename,
 void save(const std::string &filename, const std::vector<bool> &data,
           const std::tuple<size_t, size_t, size_t> &resolution);
 
+/**
+ * @brief Writes an already encoded volume of shape \p resolution to \p
+ * filename
+ */
+void save_encoding(const std::string &filename,
+                   const std::vector<bool> &encoding,
+                   const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Overload of \p save_encoding. With \p checksum, the CRC32C of the
+ * data is stored after the header, so that corruption can be detected without
+ * decoding.
+ */
+void save_encoding(const std::string &filename,
+                   const std::vector<bool> &encoding,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   bool checksum);
+
+/**
+ * @brief Writes \p encoding, a volume of shape \p resolution, to \p filename
+ * with the anisotropic layout, flagged in the header. \p load_encoding turns
+ * it back into the usual layout, see \p to_anisotropic.
+ */
+void save_anisotropic(const std::string &filename,
+                      const std::vector<bool> &encoding,
+                      const std::tuple<size_t, size_t, size_t> &resolution,
+                      bool checksum = false);
+
+/**
+ * @brief Reads the encoded volume from \p filename without decoding it, and
+ * stores its shape in \p resolution
+ */
+std::vector<bool>
+load_encoding(const std::string &filename,
+              std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Overload of \p load_encoding. With \p verify_checksum, the data of
+ * a checksummed file is checked before it is parsed.
+ *
+ * @throws std::runtime_error If the checksum does not match
+ */
+std::vector<bool>
+load_encoding(const std::string &filename,
+              std::tuple<size_t, size_t, size_t> &resolution,
+              bool verify_checksum);
+
 /**
  * @brief Reads and decodes the volume from \p filename
  */
 std::vector<std::vector<std::vector<bool>>> load(const std::string &filename);
-} // namespace otbv
\ No newline at end of file
+
+/**
+ * @brief Overload of \p load, checking the checksum first with \p
+ * verify_checksum
+ *
+ * @throws std::runtime_error If the checksum does not match
+ */
+std::vector<std::vector<std::vector<bool>>> load(const std::string &filename,
+                                                 bool verify_checksum);
+
+/**
+ * @brief Writes \p encoding, a multi-channel tree of \p channels channels for
+ * a volume of shape \p resolution, to \p filename. The number of channels is
+ * stored in the header. See \p merge_channels.
+ *
+ * @throws std::invalid_argument If \p channels is not in [1, 255]
+ */
+void save_channels(const std::string &filename,
+                   const std::vector<bool> &encoding,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   size_t channels, bool checksum = false);
+
+/**
+ * @brief Reads the multi-channel tree from \p filename without decoding it,
+ * and stores its shape in \p resolution and its number of channels in \p
+ * channels. Single-channel files are read as trees of 1 channel.
+ *
+ * @throws std::runtime_error If the file is malformed, or the checksum does
+ * not match with \p verify_checksum
+ */
+std::vector<bool> load_channels(const std::string &filename,
+                                std::tuple<size_t, size_t, size_t> &resolution,
+                                size_t &channels, bool verify_checksum = false);
+
+/**
+ * @brief Checks that \p encoding holds exactly one well formed tree for a
+ * volume of shape \p resolution, without decoding it. Walks the tokens only,
+ * keeping one counter per level.
+ *
+ * @throws std::out_of_range If the encoding ends early
+ * @throws std::runtime_error If a node is split below single voxels, or data
+ * follows the tree
+ */
+void validate(const std::vector<bool> &encoding,
+              const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Overload of \p validate for a whole OTBV file held in memory, for
+ * example memory-mapped. The header must also match the file: no reserved
+ * bits, a padded flag matching the resolution, zero padding bits, no bytes
+ * after the data, and a matching checksum if there is one. Both layouts and
+ * multi-channel trees are accepted.
+ *
+ * @throws std::runtime_error If the header is malformed
+ */
+void validate(const char *file_bytes, size_t length);
+
+/**
+ * @brief Checks the checksum of a whole OTBV file held in memory, at the speed
+ * of reading it and without parsing the tree
+ *
+ * @return Whether the file has a checksum
+ * @throws std::runtime_error If the header is malformed or the checksum does
+ * not match
+ */
+bool verify_checksum(const char *file_bytes, size_t length);
+
+/**
+ * @brief Calls \p visitor with every leaf of \p encoding that passes \p
+ * filter, in file order. Leaves lying entirely in the padding are skipped.
+ *
+ * @throws std::out_of_range If the encoding ends early
+ */
+void for_each_leaf(const std::vector<bool> &encoding,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   const LeafVisitor &visitor,
+                   LeafFilter filter = LeafFilter::ALL);
+
+/**
+ * @brief Overload of \p for_each_leaf for a whole OTBV file held in memory,
+ * for example memory-mapped
+ *
+ * @throws std::runtime_error If the header is malformed
+ */
+void for_each_leaf(const char *file_bytes, size_t length,
+                   const LeafVisitor &visitor,
+                   LeafFilter filter = LeafFilter::ALL);
+
+/**
+ * @brief Parallel \p for_each_leaf. The encoding is split into subtrees by a
+ * quick scan of their offsets, and the subtrees are walked on \p threads
+ * threads. \p visitor is called concurrently and in no particular order.
+ *
+ * @param threads 0 uses the hardware concurrency
+ */
+void for_each_leaf_parallel(
+    const std::vector<bool> &encoding,
+    const std::tuple<size_t, size_t, size_t> &resolution,
+    const LeafVisitor &visitor, LeafFilter filter = LeafFilter::ALL,
+    size_t threads = 0);
+
+/**
+ * @brief Encodes an implicit volume of shape \p resolution. Only boxes that
+ * \p classify reports as mixed are subdivided, so the cost scales with the
+ * surface of the volume rather than with its size.
+ *
+ * Boxes passed to \p classify are clipped to \p resolution. Single voxels are
+ * queried through \p voxel when it is provided, and through \p classify
+ * otherwise.
+ *
+ * @param threads When above 1, the 8 top-level octants are encoded in
+ * parallel and both callbacks must be safe to call concurrently
+ *
+ * @throws std::invalid_argument If \p resolution is empty or above the
+ * allowed maximum
+ * @throws std::runtime_error If a single voxel is classified as mixed
+ */
+std::vector<bool>
+encode_from_oracle(const std::tuple<size_t, size_t, size_t> &resolution,
+                   const BoxClassifier &classify,
+                   const VoxelClassifier &voxel = nullptr,
+                   size_t threads = 1);
+
+/**
+ * @brief Voxelises \p mesh straight into an encoded volume of shape \p
+ * resolution. Voxel x, y, z covers [origin + x * voxel_size, origin + (x + 1) *
+ * voxel_size) on the x axis, and likewise for y and z.
+ *
+ * Voxels touched by a triangle are occupied. Boxes not touched by any triangle
+ * are classified as a whole from their centre, using \p rule.
+ *
+ * @param threads Number of threads encoding the top-level octants. 0 uses the
+ * hardware concurrency
+ * @throws std::invalid_argument If \p voxel_size is not positive, or a
+ * triangle references a missing vertex
+ */
+std::vector<bool>
+voxelize_mesh(const TriangleMesh &mesh,
+              const std::tuple<size_t, size_t, size_t> &resolution,
+              const std::array<double, 3> &origin, double voxel_size,
+              InsideRule rule = InsideRule::PARITY, size_t threads = 0);
+
+/**
+ * @brief Encodes the occupancy of \p points in a single batch. See \ref
+ * PointCloudEncoder
+ */
+std::vector<bool>
+encode_from_points(const std::vector<std::array<float, 3>> &points,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   const std::array<double, 3> &origin, double voxel_size,
+                   size_t threads = 0);
+
+/**
+ * @brief Encodes a volume of shape \p resolution from the coordinates of its
+ * occupied voxels. Duplicates are allowed.
+ *
+ * @param threads Number of threads used for sorting. 0 uses the hardware
+ * concurrency
+ * @throws std::invalid_argument If a coordinate lies outside of \p resolution
+ */
+std::vector<bool>
+encode_from_coords(const std::vector<Coord> &coords,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   size_t threads = 0);
+
+/**
+ * @brief Encodes a volume of shape \p resolution from runs of occupied voxels
+ * along z. Runs may overlap and come in any order. Time and memory scale with
+ * the number of runs, not with their length.
+ *
+ * @throws std::invalid_argument If a run lies outside of \p resolution
+ */
+std::vector<bool>
+encode_from_runs(const std::vector<Run> &runs,
+                 const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Returns the coordinates of the occupied voxels in \p encoding, in the
+ * order in which the encoding stores them
+ */
+std::vector<Coord>
+decode_to_coords(const std::vector<bool> &encoding,
+                 const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Returns the occupied voxels in \p encoding as maximal runs along z,
+ * sorted by x, then y, then z_start
+ */
+std::vector<Run>
+decode_to_runs(const std::vector<bool> &encoding,
+               const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Decodes \p encoding, a volume of shape \p resolution, straight into
+ * \p out in a single pass, writing \p on_value to occupied voxels and \p
+ * off_value to the others, for example 255 and 0, or 1.0f and 0.0f. Uniform
+ * leaves are filled row by row, and 2x2x2 nodes of single voxels are read in
+ * one go.
+ *
+ * Available for uint8_t, int8_t, uint16_t, int16_t, uint32_t, int32_t, float
+ * and double.
+ *
+ * @param strides Byte strides of x, y and z in \p out, possibly negative, or
+ * nullptr for C order
+ * @throws std::out_of_range If the encoding ends early
+ * @throws std::runtime_error If the tree is malformed
+ */
+template <typename T>
+void decode_into(const std::vector<bool> &encoding,
+                 const std::tuple<size_t, size_t, size_t> &resolution, T *out,
+                 const ptrdiff_t *strides = nullptr, T on_value = T(1),
+                 T off_value = T(0));
+
+/**
+ * @brief Overload of \p decode_into for a whole OTBV file held in memory, for
+ * example memory-mapped. Both layouts are supported.
+ *
+ * @throws std::runtime_error If the header is malformed or the file holds
+ * several channels
+ */
+template <typename T>
+void decode_into(const char *file_bytes, size_t length, T *out,
+                 const ptrdiff_t *strides = nullptr, T on_value = T(1),
+                 T off_value = T(0));
+
+/**
+ * @brief How \ref decode_into_region combines a volume with the buffer it is
+ * decoded into. \p OVERWRITE writes every voxel, \p OR only the occupied
+ * ones, with the on value, and \p AND only the empty ones, with the off value.
+ */
+enum class Blend { OVERWRITE, OR, AND };
+
+/**
+ * @brief Decodes \p encoding, a volume of shape \p resolution, into the window
+ * of \p out, a larger buffer of shape \p out_shape, whose corner is at \p
+ * origin. Voxel x, y, z lands on x + origin[0], y + origin[1], z + origin[2],
+ * and voxels falling outside of \p out are skipped, as are the subtrees
+ * holding only such voxels. Uniform leaves are filled straight into \p out,
+ * so that placing many volumes costs about the sum of their leaf counts.
+ * Available for the same types as \p decode_into.
+ *
+ * @param origin Position of the volume in \p out, possibly negative
+ * @param blend Voxels of the volume that are written, see \ref Blend
+ * @param strides Byte strides of x, y and z in \p out, possibly negative, or
+ * nullptr for C order
+ * @throws std::out_of_range If the encoding ends early
+ * @throws std::runtime_error If the tree is malformed
+ */
+template <typename T>
+void decode_into_region(const std::vector<bool> &encoding,
+                        const std::tuple<size_t, size_t, size_t> &resolution,
+                        T *out,
+                        const std::tuple<size_t, size_t, size_t> &out_shape,
+                        const std::array<ptrdiff_t, 3> &origin, Blend blend,
+                        const ptrdiff_t *strides = nullptr, T on_value = T(1),
+                        T off_value = T(0));
+
+/**
+ * @brief Overload of \p decode_into_region for a whole OTBV file held in
+ * memory, for example memory-mapped. Both layouts are supported.
+ *
+ * @throws std::runtime_error If the header is malformed or the file holds
+ * several channels
+ */
+template <typename T>
+void decode_into_region(const char *file_bytes, size_t length, T *out,
+                        const std::tuple<size_t, size_t, size_t> &out_shape,
+                        const std::array<ptrdiff_t, 3> &origin, Blend blend,
+                        const ptrdiff_t *strides = nullptr, T on_value = T(1),
+                        T off_value = T(0));
+
+/**
+ * @brief Returns the canonical form of \p encoding, a volume of shape \p
+ * resolution: nodes in the padding are empty leaves, and no split node has 8
+ * leaf children of one value, counting padding children as either. Two
+ * canonical encodings are equal exactly when their volumes are. Runs in a
+ * single pass over the tokens, keeping one frame per level.
+ *
+ * @throws std::out_of_range If the encoding ends early
+ */
+std::vector<bool>
+canonicalize(const std::vector<bool> &encoding,
+             const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Returns \p encoding, a volume of shape \p resolution, rewritten with
+ * the anisotropic layout. Instead of padding the volume to a cube, every axis
+ * is padded to a power of two of its own, and nodes are split along their
+ * longest axes only, into 2, 4 or 8 children ordered as usual. Flat and
+ * elongated volumes no longer spend levels and tokens on padding. The result
+ * is canonical.
+ *
+ * @throws std::out_of_range If the encoding ends early
+ */
+std::vector<bool>
+to_anisotropic(const std::vector<bool> &encoding,
+               const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Returns \p encoding, a volume of shape \p resolution in the
+ * anisotropic layout, rewritten with the usual layout. The result is
+ * canonical.
+ *
+ * @throws std::out_of_range If the encoding ends early
+ */
+std::vector<bool>
+to_isotropic(const std::vector<bool> &encoding,
+             const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Error allowed by \p simplify. A node whose minority voxels make up at
+ * most \p max_minority_fraction of it becomes a leaf of its majority value.
+ * Other nodes become such leaves while the voxels they misclassify fit in the
+ * remaining \p error_budget, larger nodes first. The defaults are lossless.
+ */
+struct LossyOptions {
+  // in [0, 0.5)
+  double max_minority_fraction = 0;
+  // in voxels, over the whole volume
+  size_t error_budget = 0;
+};
+
+/**
+ * @brief Result of \p simplify
+ */
+struct LossyEncoding {
+  std::vector<bool> encoding;
+  // voxels whose value differs from the original volume
+  size_t error_voxels;
+};
+
+/**
+ * @brief Returns a smaller, canonical encoding of \p encoding, a volume of
+ * shape \p resolution, that misclassifies voxels within the limits of \p
+ * options, and the number of voxels it misclassifies. Fewer leaves also
+ * decode faster, which suits previews.
+ *
+ * @throws std::invalid_argument If the minority fraction is out of range
+ * @throws std::out_of_range If the encoding ends early
+ */
+LossyEncoding simplify(const std::vector<bool> &encoding,
+                       const std::tuple<size_t, size_t, size_t> &resolution,
+                       const LossyOptions &options);
+
+/**
+ * @brief Merges \p encodings, aligned masks of shape \p resolution, into one
+ * multi-channel tree. A node is split wherever any channel is mixed, so
+ * structure shared by the masks, such as their common empty space, is stored
+ * and walked once. Leaves carry one value per channel still mixed above them,
+ * and splits flag which channels become uniform there, with their values.
+ * With a single channel, this is the usual encoding. Canonical when the
+ * inputs are.
+ *
+ * @throws std::invalid_argument If there are not between 1 and 255 channels
+ * @throws std::out_of_range If an encoding ends early
+ * @throws std::runtime_error If an encoding is followed by data
+ */
+std::vector<bool>
+merge_channels(const std::vector<std::vector<bool>> &encodings,
+               const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Returns the canonical single-channel encoding of the channel \p
+ * channel of \p encoding, a multi-channel tree of \p channels channels for a
+ * volume of shape \p resolution
+ *
+ * @throws std::invalid_argument If \p channel is not below \p channels
+ * @throws std::out_of_range If the encoding ends early
+ */
+std::vector<bool>
+extract_channel(const std::vector<bool> &encoding,
+                const std::tuple<size_t, size_t, size_t> &resolution,
+                size_t channels, size_t channel);
+
+/**
+ * @brief Decodes every channel of \p encoding, a multi-channel tree of \p
+ * channels channels for a volume of shape \p resolution, into \p out: one
+ * byte per voxel and channel, in C order with the channel last. The tree is
+ * walked once for all channels.
+ *
+ * @throws std::out_of_range If the encoding ends early
+ */
+void decode_channels(const std::vector<bool> &encoding,
+                     const std::tuple<size_t, size_t, size_t> &resolution,
+                     size_t channels, uint8_t *out);
+
+/**
+ * @brief Decodes the channel \p channel of \p encoding, a multi-channel tree
+ * of \p channels channels for a volume of shape \p resolution, into \p out:
+ * one byte per voxel, in C order
+ *
+ * @throws std::invalid_argument If \p channel is not below \p channels
+ * @throws std::out_of_range If the encoding ends early
+ */
+void decode_channel(const std::vector<bool> &encoding,
+                    const std::tuple<size_t, size_t, size_t> &resolution,
+                    size_t channels, size_t channel, uint8_t *out);
+
+/**
+ * @brief Sets every voxel of \p box in \p encoding, a volume of shape \p
+ * resolution, to \p value. Only the smallest subtree containing \p box is
+ * re-encoded and spliced back into the stream, and ancestors that become
+ * uniform are collapsed. Parts of \p box outside of the volume are ignored.
+ *
+ * @throws std::out_of_range If the encoding ends early
+ */
+void set_box(std::vector<bool> &encoding,
+             const std::tuple<size_t, size_t, size_t> &resolution,
+             const Box &box, bool value);
+
+/**
+ * @brief Sets the voxel x, y, z of \p encoding to \p value. See \ref set_box
+ *
+ * @throws std::out_of_range If the voxel lies outside of the volume
+ */
+void set_voxel(std::vector<bool> &encoding,
+               const std::tuple<size_t, size_t, size_t> &resolution, size_t x,
+               size_t y, size_t z, bool value);
+
+/**
+ * @brief Encodes the bool or uint8 array in the .npy file \p filename, in C or
+ * Fortran order, and stores its shape in \p resolution. The file is streamed
+ * row by row, and never held in memory as a whole.
+ *
+ * @throws std::runtime_error If the file cannot be read, or does not hold a
+ * 3-dimensional bool or uint8 array
+ */
+std::vector<bool> encode_npy(const std::string &filename,
+                             std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Encodes the .npy file \p filename holding a volume of shape \p
+ * resolution in the \p NpyLayout::PACKBITS layout, flattened in C order or,
+ * if \p fortran_order is set, in Fortran order
+ *
+ * @throws std::runtime_error If the file cannot be read, or its length does
+ * not match \p resolution
+ */
+std::vector<bool>
+encode_npy_packbits(const std::string &filename,
+                    const std::tuple<size_t, size_t, size_t> &resolution,
+                    bool fortran_order = false);
+
+/**
+ * @brief Decodes \p encoding, of shape \p resolution, into the .npy file \p
+ * filename, one slab at a time
+ *
+ * @param fortran_order Lay the voxels out in Fortran order. For \p
+ * NpyLayout::PACKBITS, this is the order the volume is flattened in.
+ * @throws std::runtime_error If the file cannot be written
+ */
+void decode_to_npy(const std::string &filename,
+                   const std::vector<bool> &encoding,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   NpyLayout layout = NpyLayout::BOOL,
+                   bool fortran_order = false);
+
+/**
+ * @brief Encodes the raw volume file \p filename, laid out as \p layout. The
+ * file is memory-mapped and read through a strided view, and a voxel is
+ * occupied if its value is above \p threshold.
+ *
+ * @throws std::system_error If the file cannot be mapped
+ * @throws std::runtime_error If the file is shorter than \p layout requires
+ */
+std::vector<bool> encode_raw(const std::string &filename,
+                             const RawLayout &layout, double threshold = 0);
+
+/**
+ * @brief Decodes \p encoding into a raw volume file \p filename laid out as \p
+ * layout, whose shape is the resolution of the encoding. Occupied voxels are
+ * 1, and the rest, as well as the \p layout.offset leading bytes, are 0. The
+ * output is memory-mapped, and empty regions are never written.
+ *
+ * @throws std::system_error If the file cannot be created
+ */
+void decode_to_raw(const std::string &filename,
+                   const std::vector<bool> &encoding, const RawLayout &layout);
+
+/**
+ * @brief Encodes the NRRD file \p filename, with attached data or a detached
+ * header, and stores its shape in \p resolution. NRRD lists the fastest axis
+ * first, which becomes x. A voxel is occupied if its value is above \p
+ * threshold.
+ *
+ * @throws std::runtime_error If the header is malformed, or describes
+ * anything but a raw encoded 3-dimensional volume of a \ref ScalarType
+ */
+std::vector<bool> encode_nrrd(const std::string &filename,
+                              std::tuple<size_t, size_t, size_t> &resolution,
+                              double threshold = 0);
+
+/**
+ * @brief Decodes \p encoding, of shape \p resolution, into the NRRD file \p
+ * filename with attached raw data of type \p type
+ */
+void decode_to_nrrd(const std::string &filename,
+                    const std::vector<bool> &encoding,
+                    const std::tuple<size_t, size_t, size_t> &resolution,
+                    ScalarType type = ScalarType::UINT8);
+
+/**
+ * @brief Element type of the batches assembled by a \ref DataLoader.
+ * Occupied voxels are 1, empty ones 0.
+ */
+enum class BatchType { UINT8, FLOAT32 };
+
+/**
+ * @brief Settings of a \ref DataLoader
+ */
+struct DataLoaderOptions {
+  size_t batch_size = 1;
+  // every sample is cropped, or zero padded, to this shape. Zeros take the
+  // shape of the first volume
+  std::tuple<size_t, size_t, size_t> sample_shape = {0, 0, 0};
+  BatchType type = BatchType::UINT8;
+  // the order of the samples is shuffled anew every epoch
+  bool shuffle = true;
+  // crops start at a random offset instead of the centre of the volume
+  bool random_crop = false;
+  // each sample is mirrored along these axes with probability 1/2
+  std::array<bool, 3> random_flip = {false, false, false};
+  // the last batch of an epoch is dropped, rather than returned short
+  bool drop_last = true;
+  // 0 for as many epochs as are read
+  size_t epochs = 0;
+  // decoding threads. 0 uses the hardware concurrency
+  size_t threads = 0;
+  // preallocated batches, either being filled or held by the caller
+  size_t prefetch = 4;
+  uint64_t seed = 0;
+};
+
+struct DataLoaderState;
+
+/**
+ * @brief A batch of samples returned by a \ref DataLoader, laid out
+ * contiguously as samples, x, y, z. The memory is returned to the loader's
+ * pool when the batch is destroyed or reassigned.
+ */
+class Batch {
+public:
+  Batch() = default;
+  Batch(Batch &&) noexcept;
+  Batch &operator=(Batch &&) noexcept;
+  ~Batch();
+
+  void *data() const { return pointer; }
+
+  BatchType type = BatchType::UINT8;
+  // samples, x, y, z. Fewer samples than the batch size only if the last
+  // batch of an epoch is kept
+  std::array<size_t, 4> shape = {0, 0, 0, 0};
+  // in bytes
+  std::array<ptrdiff_t, 4> strides = {0, 0, 0, 0};
+  size_t epoch = 0, index = 0;
+  // positions of the samples in \ref DataLoader::sources
+  std::vector<size_t> samples;
+
+private:
+  friend class DataLoader;
+  std::shared_ptr<DataLoaderState> state;
+  size_t slot = 0;
+  void *pointer = nullptr;
+
+  void release();
+};
+
+/**
+ * @brief Decodes OTBV files into batches on a pool of worker threads, ahead
+ * of the caller. Crops and flips are applied while decoding, straight into
+ * the batch.
+ */
+class DataLoader {
+public:
+  /**
+   * @throws std::invalid_argument If there are fewer files than a batch
+   * holds, or a setting is zero
+   * @throws std::runtime_error If the sample shape has to be read from a
+   * malformed file
+   */
+  DataLoader(const std::vector<std::string> &files,
+             const DataLoaderOptions &options);
+
+  /**
+   * @brief Loads the samples in \p source: a directory searched recursively
+   * for .otbv files, an uncompressed .tar archive, or a text file listing one
+   * path per line, relative to the list
+   *
+   * @throws std::runtime_error If \p source cannot be read
+   */
+  DataLoader(const std::string &source, const DataLoaderOptions &options);
+
+  DataLoader(const DataLoader &) = delete;
+  DataLoader &operator=(const DataLoader &) = delete;
+  ~DataLoader();
+
+  /**
+   * @brief Waits for the next batch and stores it in \p batch, releasing the
+   * one it held
+   *
+   * @return false at the end of every epoch, after which the next call starts
+   * the following epoch, and for good once \p epochs epochs have been read
+   * @throws std::runtime_error If a sample could not be decoded
+   */
+  bool next(Batch &batch);
+
+  /**
+   * @brief Returns the names of the samples, in their unshuffled order
+   */
+  const std::vector<std::string> &sources() const;
+
+  size_t batches_per_epoch() const;
+
+private:
+  std::shared_ptr<DataLoaderState> state;
+};
+
+/**
+ * @brief Draws random patches from an encoded volume, centred on occupied
+ * voxels more often than uniform crops would be. A coarse index of the tree
+ * records the occupied voxel count and token offset of every node of side \p
+ * cell, so that drawing a voxel or decoding a patch only walks the subtrees
+ * involved.
+ *
+ * The const members may be called from several threads at once.
+ */
+class PatchSampler {
+public:
+  /**
+   * @param cell Edge of the indexed nodes, rounded up to a power of 2. Smaller
+   * cells make sampling cheaper and the index larger
+   * @throws std::out_of_range If the encoding ends early
+   */
+  PatchSampler(std::vector<bool> encoding,
+               const std::tuple<size_t, size_t, size_t> &resolution,
+               size_t cell = 16);
+
+  /**
+   * @brief Indexes the volume stored in \p filename
+   */
+  explicit PatchSampler(const std::string &filename, size_t cell = 16);
+
+  /**
+   * @brief Returns the number of occupied voxels
+   */
+  uint64_t occupied() const;
+
+  std::tuple<size_t, size_t, size_t> resolution() const;
+
+  /**
+   * @brief Draws a voxel: with probability \p foreground uniformly among the
+   * occupied voxels, otherwise uniformly over the whole volume. Empty volumes
+   * are always sampled uniformly.
+   */
+  Coord sample_voxel(std::mt19937_64 &rng, double foreground = 1) const;
+
+  /**
+   * @brief Draws a voxel with \p sample_voxel and decodes the patch of shape
+   * \p patch_shape around it into \p out. The patch is shifted to lie within
+   * the volume where the volume is large enough.
+   *
+   * @return The position of the first voxel of the patch
+   */
+  Coord sample_patch(const std::tuple<size_t, size_t, size_t> &patch_shape,
+                     uint8_t *out, std::mt19937_64 &rng,
+                     double foreground = 1) const;
+
+  /**
+   * @brief Decodes \p region into \p out, one byte per voxel in C order, 1 if
+   * occupied. Voxels of \p region outside of the volume are 0.
+   */
+  void decode_region(const Box &region, uint8_t *out) const;
+
+private:
+  struct Node {
+    // the node of the tree, and its part within the volume
+    Box node, clipped;
+    size_t start, depth;
+    uint64_t occupied;
+  };
+
+  std::vector<bool> encoding;
+  std::tuple<size_t, size_t, size_t> shape;
+  size_t cell, grid[3];
+  std::vector<Node> nodes;
+  // occupied voxels before each node
+  std::vector<uint64_t> prefix;
+  // node covering each cell, x slowest
+  std::vector<uint32_t> cells;
+
+  void build(size_t requested);
+};
+
+/**
+ * @brief Settings of a \ref JournaledVolume
+ */
+struct JournalOptions {
+  // the journal is folded into the volume once it holds this many edits
+  size_t max_records = 4096;
+  // compaction runs on a background thread instead of in the editing call
+  bool background = true;
+};
+
+/**
+ * @brief OTBV file edited through an append-only journal sidecar, \p
+ * filename + ".journal". Box edits are appended in a few bytes each, and
+ * folded into a fresh canonical file by a compactor once the journal grows
+ * past a threshold. The new file and the trimmed journal replace the old ones
+ * by atomic renames, under an exclusive lock on \p filename + ".lock", so that
+ * readers always see a volume and a journal that belong together. Several
+ * processes may edit and read the same volume.
+ */
+class JournaledVolume {
+public:
+  /**
+   * @throws std::runtime_error If \p filename cannot be read
+   */
+  explicit JournaledVolume(const std::string &filename,
+                           const JournalOptions &options = {});
+
+  JournaledVolume(const JournaledVolume &) = delete;
+  JournaledVolume &operator=(const JournaledVolume &) = delete;
+
+  /**
+   * @brief Waits for a running compaction
+   */
+  ~JournaledVolume();
+
+  /**
+   * @brief Appends an edit setting every voxel of \p box to \p value. Parts
+   * of \p box outside of the volume are ignored.
+   *
+   * @throws std::system_error If the journal cannot be written
+   * @throws std::runtime_error If a background compaction failed
+   */
+  void set_box(const Box &box, bool value);
+
+  /**
+   * @throws std::out_of_range If the voxel lies outside of the volume
+   */
+  void set_voxel(size_t x, size_t y, size_t z, bool value);
+
+  /**
+   * @brief Returns the encoding of the volume with every journaled edit
+   * applied
+   */
+  std::vector<bool> load_encoding() const;
+
+  /**
+   * @brief Folds the journal into the volume file now, on the calling thread
+   */
+  void compact();
+
+  /**
+   * @brief Returns the number of edits in the journal
+   */
+  size_t pending() const;
+
+  std::tuple<size_t, size_t, size_t> resolution() const;
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl;
+};
+
+/**
+ * @brief Reads the encoded volume from \p filename, with the edits of its
+ * journal sidecar applied if there is one, and stores its shape in \p
+ * resolution. See \ref JournaledVolume
+ */
+std::vector<bool>
+load_journaled(const std::string &filename,
+               std::tuple<size_t, size_t, size_t> &resolution);
+} // namespace otbv
@@ -0,0 +1,119 @@
+#ifndef OTBV_C_H
+#define OTBV_C_H
+
+/*
+ * C interface to libotbv. Volumes are passed as caller-owned buffers of one
+ * uint8_t per voxel, described by a shape and byte strides, so that bindings
+ * can hand numpy or ndarray buffers through without copies. Functions never
+ * throw; they report failures through an otbv_status.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* bumped on any incompatible change to this header */
+#define OTBV_C_ABI_VERSION 2
+
+typedef enum otbv_status {
+  OTBV_OK = 0,
+  OTBV_ERROR_INVALID_ARGUMENT = 1,
+  OTBV_ERROR_IO = 2,
+  OTBV_ERROR_FORMAT = 3,
+  OTBV_ERROR_BUFFER_TOO_SMALL = 4,
+  OTBV_ERROR_OUT_OF_MEMORY = 5,
+  OTBV_ERROR_INTERNAL = 6
+} otbv_status;
+
+typedef struct otbv_info {
+  /* x, y, z */
+  size_t shape[3];
+  /* number of tokens in the encoding */
+  size_t encoded_bits;
+  /* size of the whole file, header included */
+  size_t file_size;
+  /* masks sharing the tree, 1 for plain files. otbv_decode reads only those */
+  size_t channels;
+  /* non-zero if the header stores a checksum of the data */
+  int checksummed;
+  /* non-zero if the tree uses the anisotropic layout */
+  int anisotropic;
+} otbv_info;
+
+/**
+ * @brief Returns OTBV_C_ABI_VERSION as the library was built
+ */
+int otbv_abi_version(void);
+
+/**
+ * @brief Returns a static description of \p status
+ */
+const char *otbv_status_string(otbv_status status);
+
+/**
+ * @brief Returns the message of the last error raised on the calling thread,
+ * or an empty string. Valid until the next call on that thread.
+ */
+const char *otbv_last_error(void);
+
+/**
+ * @brief Reads the header of the OTBV file held in \p file_bytes
+ */
+otbv_status otbv_info_buffer(const void *file_bytes, size_t length,
+                             otbv_info *info);
+
+/**
+ * @brief Reads the header of the OTBV file \p filename
+ */
+otbv_status otbv_info_file(const char *filename, otbv_info *info);
+
+/**
+ * @brief Returns an upper bound on the size of the file produced by encoding
+ * a volume of shape \p shape
+ */
+size_t otbv_encode_bound(const size_t shape[3]);
+
+/**
+ * @brief Encodes a volume into the bytes of an OTBV file
+ *
+ * @param data First voxel of the volume. Non-zero voxels are occupied
+ * @param strides Byte strides of x, y and z, possibly negative. NULL means
+ * C order
+ * @param out Receives the file, if it fits in \p capacity bytes
+ * @param out_size Receives the size of the file. On
+ * OTBV_ERROR_BUFFER_TOO_SMALL, the size required
+ */
+otbv_status otbv_encode(const uint8_t *data, const size_t shape[3],
+                        const ptrdiff_t strides[3], void *out,
+                        size_t capacity, size_t *out_size);
+
+/**
+ * @brief Encodes a volume and writes it to \p filename. See otbv_encode
+ */
+otbv_status otbv_save(const char *filename, const uint8_t *data,
+                      const size_t shape[3], const ptrdiff_t strides[3]);
+
+/**
+ * @brief Decodes the OTBV file held in \p file_bytes into \p out, which must
+ * hold the shape reported by otbv_info_buffer. Voxels are written as 0 or 1.
+ *
+ * @param strides Byte strides of x, y and z, possibly negative. NULL means
+ * C order
+ */
+otbv_status otbv_decode(const void *file_bytes, size_t length, uint8_t *out,
+                        const ptrdiff_t strides[3]);
+
+/**
+ * @brief Reads and decodes \p filename into \p out. See otbv_decode
+ */
+otbv_status otbv_load(const char *filename, uint8_t *out,
+                      const ptrdiff_t strides[3]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTBV_C_H */
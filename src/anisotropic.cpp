@@ -0,0 +1,167 @@
+#include "../include/otbv.h"
+#include "conversion.h"
+#include "traversal.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+namespace {
+
+/**
+ * @brief Tree of an encoding held as nodes, the children of every node next
+ * to each other, answering whether a box is empty, full or mixed. Both are
+ * walked with a \ref NodeWalk, which gives the boxes: the nodes of a depth
+ * are met in the order of their ids, so each walk only keeps the id of the
+ * next node of every depth.
+ */
+class TreeIndex {
+public:
+  TreeIndex(const std::vector<bool> &encoding, const Box &root) : tree(root) {
+    nodes.push_back({0, 0, false});
+    std::array<size_t, RECURSION_MAX_DEPTH + 2> next;
+    next[0] = 0;
+    size_t idx = 0;
+    NodeWalk walk = tree;
+    walk.run([&](const NodeKey &key, const Box &box) {
+      if (idx >= encoding.size()) {
+        throw std::out_of_range("Unexpected end of the encoding");
+      }
+      Node &node = nodes[next[key.depth]++];
+      if (!encoding[idx]) {
+        if (idx + 1 >= encoding.size()) {
+          throw std::out_of_range("Unexpected end of the encoding");
+        }
+        node.value = encoding[idx + 1];
+        idx += 2;
+        return Step::NEXT;
+      }
+      idx++;
+      const size_t first = nodes.size(),
+                   count = split_children(split_axes(box));
+      node.first = first;
+      node.children = static_cast<uint8_t>(count);
+      next[key.depth + 1] = first;
+      nodes.resize(first + count, Node{0, 0, false});
+      return Step::DESCEND;
+    });
+    if (idx != encoding.size()) {
+      throw std::runtime_error("Trailing data after the end of the tree.");
+    }
+  }
+
+  /**
+   * @brief Node of the index, from which queries start
+   */
+  struct Start {
+    NodeKey key;
+    size_t id;
+  };
+
+  /**
+   * @brief Returns whether the leaves within \p box are all empty, all full,
+   * or both, stopping as soon as both are met. \p start must contain \p
+   * box, and is moved down to the deepest node that does, so that queries
+   * for the parts of \p box start there.
+   */
+  Occupancy classify(const Box &box, Start &start) const {
+    // 1 for empty and 2 for full
+    uint8_t seen = 0;
+    bool narrowing = true;
+    std::array<size_t, RECURSION_MAX_DEPTH + 2> next;
+    next[start.key.depth] = start.id;
+    NodeWalk(tree, start.key).run([&](const NodeKey &key, const Box &node_box) {
+      if (3 == seen) {
+        return Step::STOP;
+      }
+      const size_t id = next[key.depth]++;
+      const Node &node = nodes[id];
+      const Box part = intersect(node_box, box);
+      if (0 == volume(part)) {
+        return Step::NEXT;
+      }
+      // nodes containing the box form a path from the start, which ends at
+      // the first node that only overlaps it
+      narrowing = narrowing && volume(part) == volume(box);
+      if (narrowing) {
+        start = {key, id};
+      }
+      if (0 == node.children) {
+        seen |= node.value ? 2 : 1;
+        return Step::NEXT;
+      }
+      next[key.depth + 1] = node.first;
+      return Step::DESCEND;
+    });
+    return 3 == seen ? Occupancy::MIXED
+                     : (2 == seen ? Occupancy::FULL : Occupancy::EMPTY);
+  }
+
+private:
+  struct Node {
+    // index of the first child, and the number of children, 0 for leaves
+    size_t first;
+    uint8_t children;
+    bool value;
+  };
+  NodeWalk tree;
+  std::vector<Node> nodes;
+};
+
+} // namespace
+
+/**
+ * @brief Helper function. Rewrites \p encoding from one layout to the other.
+ * Nodes in the padding are empty leaves, and uniform nodes are leaves, so the
+ * output is canonical.
+ */
+static std::vector<bool>
+relayout(const std::vector<bool> &encoding,
+         const std::tuple<size_t, size_t, size_t> &resolution,
+         bool anisotropic) {
+  check_resolution(resolution);
+  const TreeIndex index(encoding, root_node(resolution, !anisotropic));
+  const size_t x_res = std::get<0>(resolution), y_res = std::get<1>(resolution),
+               z_res = std::get<2>(resolution);
+  std::vector<bool> out;
+  // the children of a node lie within it, so their queries start where the
+  // query of the node ended up
+  std::array<TreeIndex::Start, RECURSION_MAX_DEPTH + 2> starts;
+  starts[0] = {{0, 0}, 0};
+  NodeWalk(root_node(resolution, anisotropic))
+      .run([&](const NodeKey &key, const Box &node) {
+        const Box clipped = clip(node, x_res, y_res, z_res);
+        TreeIndex::Start start = starts[key.depth];
+        const Occupancy occupancy = 0 == volume(clipped)
+                                        ? Occupancy::EMPTY
+                                        : index.classify(clipped, start);
+        if (Occupancy::MIXED != occupancy) {
+          out.push_back(0);
+          out.push_back(Occupancy::FULL == occupancy);
+          return Step::NEXT;
+        }
+        out.push_back(1);
+        starts[key.depth + 1] = start;
+        return Step::DESCEND;
+      });
+  return out;
+}
+
+std::vector<bool>
+to_anisotropic(const std::vector<bool> &encoding,
+               const std::tuple<size_t, size_t, size_t> &resolution) {
+  return relayout(encoding, resolution, true);
+}
+
+std::vector<bool>
+to_isotropic(const std::vector<bool> &encoding,
+             const std::tuple<size_t, size_t, size_t> &resolution) {
+  return relayout(encoding, resolution, false);
+}
+
+} // namespace otbv
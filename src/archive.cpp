@@ -0,0 +1,133 @@
+#include "archive.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace otbv {
+
+static constexpr size_t TAR_BLOCK = 512;
+
+/**
+ * @brief Helper function. Returns the NUL-terminated string in the \p length
+ * bytes at \p field
+ */
+static std::string tar_string(const char *field, size_t length) {
+  return std::string(field, strnlen(field, length));
+}
+
+/**
+ * @brief Helper function. Parses a numeric header field, in octal or in the
+ * GNU base-256 form flagged by the top bit of its first byte
+ */
+static size_t tar_number(const char *field, size_t length) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(field);
+  size_t value = 0;
+  if (bytes[0] & 0x80) {
+    for (size_t i = 1; i < length; i++) {
+      if (value >> 56) {
+        throw std::runtime_error("Tar header field is out of range");
+      }
+      value = (value << 8) | bytes[i];
+    }
+    return value;
+  }
+  size_t i = 0;
+  while (i < length && ' ' == field[i]) {
+    i++;
+  }
+  for (; i < length && field[i] >= '0' && field[i] <= '7'; i++) {
+    value = (value << 3) | static_cast<size_t>(field[i] - '0');
+  }
+  return value;
+}
+
+/**
+ * @brief Helper function. Checks the header checksum, computed with the
+ * checksum field itself read as spaces
+ */
+static bool tar_checksum_ok(const char *header) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(header);
+  size_t sum = 0;
+  for (size_t i = 0; i < TAR_BLOCK; i++) {
+    sum += (i >= 148 && i < 156) ? ' ' : bytes[i];
+  }
+  return sum == tar_number(header + 148, 8);
+}
+
+/**
+ * @brief Helper function. Returns the path record of the pax extended header
+ * \p records, or an empty string
+ */
+static std::string pax_path(const char *records, size_t size) {
+  size_t pos = 0;
+  while (pos < size) {
+    // "<length> <key>=<value>\n", the length counting the whole record
+    size_t length = 0, i = pos;
+    for (; i < size && records[i] >= '0' && records[i] <= '9'; i++) {
+      length = length * 10 + static_cast<size_t>(records[i] - '0');
+    }
+    if (0 == length || pos + length > size || i >= size || ' ' != records[i]) {
+      break;
+    }
+    const std::string record(records + i + 1, pos + length - i - 1);
+    if (0 == record.compare(0, 5, "path=") && !record.empty() &&
+        '\n' == record.back()) {
+      return record.substr(5, record.size() - 6);
+    }
+    pos += length;
+  }
+  return "";
+}
+
+std::vector<ArchiveMember> list_tar_members(const char *bytes, size_t size) {
+  std::vector<ArchiveMember> members;
+  std::string long_name;
+  size_t pos = 0;
+  while (pos + TAR_BLOCK <= size) {
+    const char *header = bytes + pos;
+    if (std::all_of(header, header + TAR_BLOCK,
+                    [](char byte) { return 0 == byte; })) {
+      // end of archive marker
+      return members;
+    }
+    if (!tar_checksum_ok(header)) {
+      throw std::runtime_error("Tar header checksum mismatch at offset " +
+                               std::to_string(pos));
+    }
+    const size_t data = pos + TAR_BLOCK, length = tar_number(header + 124, 12);
+    if (length > size - data) {
+      throw std::runtime_error("Tar archive is truncated");
+    }
+    const char type = header[156];
+    if ('L' == type) {
+      long_name = tar_string(bytes + data, length);
+    } else if ('x' == type) {
+      long_name = pax_path(bytes + data, length);
+    } else {
+      std::string name = long_name;
+      if (name.empty()) {
+        const std::string prefix = tar_string(header + 345, 155);
+        name = tar_string(header, 100);
+        if (0 == std::memcmp(header + 257, "ustar", 5) && !prefix.empty()) {
+          name = prefix + "/" + name;
+        }
+      }
+      long_name.clear();
+      if ('0' == type || '\0' == type || '7' == type) {
+        members.push_back({name, data, length});
+      }
+    }
+    pos = data + (length + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+  }
+  if (pos != size) {
+    throw std::runtime_error("Tar archive is truncated");
+  }
+  return members;
+}
+
+} // namespace otbv
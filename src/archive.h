@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace otbv {
+
+/**
+ * @brief A regular file stored in an archive, \p size bytes starting \p
+ * offset bytes into it
+ */
+struct ArchiveMember {
+  std::string name;
+  size_t offset, size;
+};
+
+/**
+ * @brief Lists the regular files of the uncompressed tar archive \p bytes, in
+ * archive order. Long names in GNU and pax extension headers are honoured.
+ *
+ * @throws std::runtime_error If the archive is malformed or truncated
+ */
+std::vector<ArchiveMember> list_tar_members(const char *bytes, size_t size);
+
+} // namespace otbv
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace otbv {
+
+/**
+ * @brief Read-only view of \p count bits packed most significant bit first,
+ * starting \p first bits into \p bytes. Indexes like a std::vector<bool>.
+ */
+struct PackedBits {
+  const uint8_t *bytes;
+  size_t first, count;
+
+  size_t size() const { return count; }
+
+  bool operator[](size_t idx) const {
+    const size_t bit = first + idx;
+    return (bytes[bit >> 3] >> (7 - (bit & 7))) & 1;
+  }
+};
+
+/**
+ * @brief Returns the \p count bits of \p bits from \p idx on, at most 64, the
+ * first in the most significant place. Generic version, reading them one by
+ * one.
+ */
+template <typename Bits>
+uint64_t bit_window(const Bits &bits, const size_t idx, const size_t count) {
+  uint64_t window = 0;
+  for (size_t i = 0; i < count; i++) {
+    window = (window << 1) | bits[idx + i];
+  }
+  return window;
+}
+
+/**
+ * @brief Overload of \p bit_window reading whole bytes at once
+ */
+inline uint64_t bit_window(const PackedBits &bits, const size_t idx,
+                           const size_t count) {
+  if (0 == count) {
+    return 0;
+  }
+  const size_t bit = bits.first + idx;
+  const size_t bytes = (bit % 8 + count + 7) / 8;
+  const uint8_t *p = bits.bytes + bit / 8;
+  uint64_t window = 0;
+  for (size_t i = 0; i < 8; i++) {
+    window = (window << 8) | (i < bytes ? p[i] : 0);
+  }
+  window <<= bit % 8;
+  if (bytes > 8) {
+    window |= p[8] >> (8 - bit % 8);
+  }
+  return window >> (64 - count);
+}
+
+} // namespace otbv
@@ -0,0 +1,15 @@
+#include "canonical.h"
+
+#include <cstddef>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+std::vector<bool>
+canonicalize(const std::vector<bool> &encoding,
+             const std::tuple<size_t, size_t, size_t> &resolution) {
+  return canonicalize_bits(encoding, resolution);
+}
+
+} // namespace otbv
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "../include/otbv.h"
+#include "conversion.h"
+#include "traversal.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+/**
+ * @brief Returns the bit mask of the children of \p node lying entirely in
+ * the padding of a volume of shape \p x_res, \p y_res, \p z_res
+ */
+inline uint8_t padding_children(const Box &node, const size_t x_res,
+                                const size_t y_res, const size_t z_res) {
+  if (node.xe <= x_res && node.ye <= y_res && node.ze <= z_res) {
+    return 0;
+  }
+  uint8_t mask = 0;
+  for (size_t i = 0; i < 8; i++) {
+    if (0 == volume(clip(child_box(node, i), x_res, y_res, z_res))) {
+      mask |= 1 << i;
+    }
+  }
+  return mask;
+}
+
+/**
+ * @brief Streams the tree in \p bits into its canonical form: nodes lying in
+ * the padding become empty leaves, and split nodes whose children are leaves
+ * of one value, ignoring padding children, are collapsed, from the bottom up.
+ * Tokens after the end of the tree are dropped.
+ *
+ * @tparam Bits std::vector<bool>, \ref PackedBits, or anything else indexable
+ * with a \p size()
+ * @throws std::out_of_range If the encoding ends early
+ */
+template <typename Bits>
+std::vector<bool>
+canonicalize_bits(const Bits &bits,
+                  const std::tuple<size_t, size_t, size_t> &resolution) {
+  check_resolution(resolution);
+  const size_t x_res = std::get<0>(resolution), y_res = std::get<1>(resolution),
+               z_res = std::get<2>(resolution);
+  // start and padding children of the split node open at every level
+  std::array<size_t, RECURSION_MAX_DEPTH + 1> starts;
+  std::array<uint8_t, RECURSION_MAX_DEPTH + 1> paddings;
+  size_t idx = 0;
+  std::vector<bool> out;
+  out.reserve(bits.size());
+  NodeWalk(max_res_pow2_roof(resolution))
+      .run(
+          [&](const NodeKey &key, const Box &node) {
+            if (idx >= bits.size()) {
+              throw std::out_of_range("Unexpected end of the encoding");
+            }
+            if (0 == volume(clip(node, x_res, y_res, z_res))) {
+              idx = skip_node(bits, idx);
+              out.push_back(0);
+              out.push_back(0);
+              return Step::NEXT;
+            }
+            if (bits[idx]) {
+              starts[key.depth] = out.size();
+              paddings[key.depth] =
+                  padding_children(node, x_res, y_res, z_res);
+              out.push_back(1);
+              idx++;
+              return Step::DESCEND;
+            }
+            if (idx + 1 >= bits.size()) {
+              throw std::out_of_range("Unexpected end of the encoding");
+            }
+            out.push_back(0);
+            out.push_back(bits[idx + 1]);
+            idx += 2;
+            return Step::NEXT;
+          },
+          [&](const NodeKey &key) {
+            collapse_uniform_children(out, starts[key.depth],
+                                      paddings[key.depth]);
+          });
+  return out;
+}
+
+} // namespace otbv
@@ -0,0 +1,155 @@
+#include "channels.h"
+#include "../include/otbv.h"
+#include "conversion.h"
+#include "io.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+std::vector<bool>
+merge_channels(const std::vector<std::vector<bool>> &encodings,
+               const std::tuple<size_t, size_t, size_t> &resolution) {
+  check_resolution(resolution);
+  const size_t channels = encodings.size();
+  if (0 == channels || channels > MAX_CHANNELS) {
+    throw std::invalid_argument("The number of channels must lie in [1, 255]");
+  }
+  // every encoding is read at its own position, and channels mixed in the
+  // parent, according to its row of rows, take part in the node
+  std::vector<size_t> idx(channels, 0);
+  std::vector<int8_t> rows((RECURSION_MAX_DEPTH + 3) * channels,
+                           MIXED_CHANNEL);
+  std::vector<bool> out;
+  NodeWalk(max_res_pow2_roof(resolution))
+      .run([&](const NodeKey &key, const Box &) {
+        const int8_t *parent = rows.data() + key.depth * channels;
+        int8_t *state = rows.data() + (key.depth + 1) * channels;
+        std::copy(parent, parent + channels, state);
+        size_t active = 0;
+        bool split = false;
+        for (size_t c = 0; c < channels; c++) {
+          if (MIXED_CHANNEL != parent[c]) {
+            continue;
+          }
+          active++;
+          const std::vector<bool> &encoding = encodings[c];
+          if (idx[c] + 1 >= encoding.size()) {
+            throw std::out_of_range("Unexpected end of the encoding");
+          }
+          if (encoding[idx[c]]) {
+            idx[c]++;
+            split = true;
+          } else {
+            state[c] = encoding[idx[c] + 1];
+            idx[c] += 2;
+          }
+        }
+        out.push_back(split);
+        if (!split || active > 1) {
+          for (size_t c = 0; c < channels; c++) {
+            if (MIXED_CHANNEL == parent[c]) {
+              if (split) {
+                out.push_back(MIXED_CHANNEL == state[c]);
+              }
+              if (MIXED_CHANNEL != state[c]) {
+                out.push_back(state[c]);
+              }
+            }
+          }
+        }
+        return split ? Step::DESCEND : Step::NEXT;
+      });
+  for (size_t c = 0; c < channels; c++) {
+    if (idx[c] != encodings[c].size()) {
+      throw std::runtime_error("Trailing data after the end of the tree.");
+    }
+  }
+  return out;
+}
+
+/**
+ * @brief Helper function. Throws unless \p channel is one of \p channels
+ */
+static void check_channel(const size_t channels, const size_t channel) {
+  if (channel >= channels) {
+    throw std::invalid_argument("The channel does not exist in the encoding");
+  }
+}
+
+std::vector<bool>
+extract_channel(const std::vector<bool> &encoding,
+                const std::tuple<size_t, size_t, size_t> &resolution,
+                size_t channels, size_t channel) {
+  check_channel(channels, channel);
+  std::vector<bool> out;
+  walk_channels(encoding, resolution, channels,
+                [&](const Box &, const int8_t *parent, const int8_t *state,
+                    bool) {
+                  if (MIXED_CHANNEL != parent[channel]) {
+                    return;
+                  }
+                  if (MIXED_CHANNEL == state[channel]) {
+                    out.push_back(1);
+                  } else {
+                    out.push_back(0);
+                    out.push_back(state[channel]);
+                  }
+                });
+  // splits of non-canonical inputs are kept by the merge
+  return canonicalize(out, resolution);
+}
+
+/**
+ * @brief Helper function. Decodes the channels [\p first, \p first + \p count)
+ * of \p encoding into \p out, \p count bytes per voxel. Every channel is
+ * written once, by the node where it becomes uniform.
+ */
+static void decode_range(const std::vector<bool> &encoding,
+                         const std::tuple<size_t, size_t, size_t> &resolution,
+                         const size_t channels, const size_t first,
+                         const size_t count, uint8_t *out) {
+  check_resolution(resolution);
+  const size_t x_res = std::get<0>(resolution), y_res = std::get<1>(resolution),
+               z_res = std::get<2>(resolution);
+  std::fill(out, out + x_res * y_res * z_res * count, 0);
+  walk_channels(
+      encoding, resolution, channels,
+      [&](const Box &node, const int8_t *parent, const int8_t *state, bool) {
+        const Box box = clip(node, x_res, y_res, z_res);
+        for (size_t c = 0; c < count && volume(box); c++) {
+          if (MIXED_CHANNEL != parent[first + c] || 1 != state[first + c]) {
+            continue;
+          }
+          for (size_t x = box.xs; x < box.xe; x++) {
+            for (size_t y = box.ys; y < box.ye; y++) {
+              uint8_t *row = out + ((x * y_res + y) * z_res) * count + c;
+              for (size_t z = box.zs; z < box.ze; z++) {
+                row[z * count] = 1;
+              }
+            }
+          }
+        }
+      });
+}
+
+void decode_channels(const std::vector<bool> &encoding,
+                     const std::tuple<size_t, size_t, size_t> &resolution,
+                     size_t channels, uint8_t *out) {
+  decode_range(encoding, resolution, channels, 0, channels, out);
+}
+
+void decode_channel(const std::vector<bool> &encoding,
+                    const std::tuple<size_t, size_t, size_t> &resolution,
+                    size_t channels, size_t channel, uint8_t *out) {
+  check_channel(channels, channel);
+  decode_range(encoding, resolution, channels, channel, 1, out);
+}
+
+} // namespace otbv
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "conversion.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+// value of a channel that is still mixed, and read from the encoding
+static constexpr int8_t MIXED_CHANNEL = -1;
+
+/**
+ * @brief Walks the multi-channel tree \p bits of \p channels channels, for a
+ * volume of shape \p resolution, in file order. Calls \p visitor with every
+ * node, its parent's row of channel values and its own, and whether it is a
+ * leaf. A value is 0 or 1 once its channel is uniform, and \p MIXED_CHANNEL
+ * before. Every channel mixed in the parent is mixed in the split nodes that
+ * flag it so, and takes a value otherwise.
+ *
+ * Splits list one flag per channel mixed in their parent, followed by the
+ * value of the channel when the flag is 0, unless only one channel is mixed
+ * there. Leaves list the values of the channels mixed in their parent.
+ *
+ * @throws std::out_of_range If the encoding ends early
+ * @throws std::runtime_error If the tree is malformed or followed by data
+ */
+template <typename Bits, typename Visitor>
+void walk_channels(const Bits &bits,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   const size_t channels, Visitor &&visitor) {
+  check_resolution(resolution);
+  if (0 == channels) {
+    throw std::invalid_argument("An encoding holds at least one channel");
+  }
+  // one row of channel values per level, that of the root's parent first
+  std::vector<int8_t> rows((RECURSION_MAX_DEPTH + 3) * channels,
+                           MIXED_CHANNEL);
+  size_t idx = 0;
+  const auto read = [&]() -> bool {
+    if (idx >= bits.size()) {
+      throw std::out_of_range("Unexpected end of the encoding");
+    }
+    return bits[idx++];
+  };
+  NodeWalk(max_res_pow2_roof(resolution))
+      .run([&](const NodeKey &key, const Box &node) {
+        const int8_t *parent = rows.data() + key.depth * channels;
+        int8_t *state = rows.data() + (key.depth + 1) * channels;
+        std::copy(parent, parent + channels, state);
+        const size_t active =
+            std::count(parent, parent + channels, MIXED_CHANNEL);
+        const bool split = read();
+        if (split && 1 == volume(node)) {
+          throw std::runtime_error("A node is split below the size of a "
+                                   "voxel. The data is likely malformed.");
+        }
+        // a split with a single mixed channel needs no flags
+        if (!split || active > 1) {
+          size_t mixed = 0;
+          for (size_t c = 0; c < channels; c++) {
+            if (MIXED_CHANNEL != parent[c]) {
+              continue;
+            }
+            if (split && read()) {
+              mixed++;
+              continue;
+            }
+            state[c] = read();
+          }
+          if (split && 0 == mixed) {
+            throw std::runtime_error("A node is split although no channel is "
+                                     "mixed. The data is likely malformed.");
+          }
+        }
+        visitor(node, parent, static_cast<const int8_t *>(state), !split);
+        return split ? Step::DESCEND : Step::NEXT;
+      });
+  if (idx != bits.size()) {
+    throw std::runtime_error("Trailing data after the end of the tree.");
+  }
+}
+
+} // namespace otbv
@@ -1,4 +1,5 @@
 #include "conversion.h"
+#include "traversal.h"
 
 #include <algorithm>
 #include <array>
@@ -10,9 +11,6 @@
 #include <tuple>
 #include <vector>
 
-// enough to accommodate volumes @ 1M per dimension
-static constexpr size_t RECURSION_MAX_DEPTH = 20;
-
 namespace otbv {
 
 // https://www.reddit.com/r/cpp_questions/comments/1h3sva9/
@@ -42,6 +40,73 @@ size_t max_res_pow2_roof(const size_t &x_res, const size_t &y_res,
   return pow2_roof(max_res);
 }
 
+bool is_padded(const std::tuple<size_t, size_t, size_t> &resolution) {
+  const size_t side = max_res_pow2_roof(resolution);
+  return side != std::get<0>(resolution) || side != std::get<1>(resolution) ||
+         side != std::get<2>(resolution);
+}
+
+void check_resolution(const std::tuple<size_t, size_t, size_t> &resolution) {
+  const size_t x_res = std::get<0>(resolution), //
+      y_res = std::get<1>(resolution),          //
+      z_res = std::get<2>(resolution);
+  if (0 == x_res || 0 == y_res || 0 == z_res) {
+    throw std::invalid_argument("A volume cannot have a dimension of size 0");
+  }
+  if (x_res > MAX_RESOLUTION || y_res > MAX_RESOLUTION ||
+      z_res > MAX_RESOLUTION) {
+    throw std::invalid_argument("Provided resolution is above allowed "
+                                "maximum 10e5 per dimension.");
+  }
+}
+
+size_t volume(const Box &box) {
+  if (box.xe <= box.xs || box.ye <= box.ys || box.ze <= box.zs) {
+    return 0;
+  }
+  return (box.xe - box.xs) * (box.ye - box.ys) * (box.ze - box.zs);
+}
+
+Box clip(const Box &box, const size_t x_res, const size_t y_res,
+         const size_t z_res) {
+  return {box.xs, std::min(box.xe, x_res), box.ys,
+          std::min(box.ye, y_res), box.zs, std::min(box.ze, z_res)};
+}
+
+Box intersect(const Box &a, const Box &b) {
+  return {std::max(a.xs, b.xs), std::min(a.xe, b.xe), std::max(a.ys, b.ys),
+          std::min(a.ye, b.ye), std::max(a.zs, b.zs), std::min(a.ze, b.ze)};
+}
+
+bool collapse_uniform_children(std::vector<bool> &encoding,
+                               const size_t node_start,
+                               const uint8_t padding_children) {
+  // split token followed by 8 leaves of 2 tokens each
+  if (encoding.size() - node_start != 17 || !encoding[node_start] ||
+      0xff == padding_children) {
+    return false;
+  }
+  bool value = false, seen = false;
+  for (size_t child = 0; child < 8; child++) {
+    const size_t i = node_start + 1 + 2 * child;
+    if (encoding[i]) {
+      return false;
+    }
+    if ((padding_children >> child) & 1) {
+      continue;
+    }
+    if (seen && encoding[i + 1] != value) {
+      return false;
+    }
+    value = encoding[i + 1];
+    seen = true;
+  }
+  encoding.resize(node_start);
+  encoding.push_back(0);
+  encoding.push_back(value);
+  return true;
+}
+
 template <typename T> vector3<T> reshape_to_cubic(const std::vector<T> &data) {
   const size_t data_size = data.size();
   double edge_len = std::cbrt(data_size);
@@ -132,54 +197,29 @@ template <typename T> size_t size(const vector3<T> &data) {
   return size;
 }
 
-void encode_recursive(const vector3<bool> &data, std::vector<bool> &encoding,
-                      const size_t xs, const size_t xe, const size_t ys,
-                      const size_t ye, const size_t zs, const size_t ze,
-                      size_t depth) {
-  if (depth > RECURSION_MAX_DEPTH) {
-    throw std::runtime_error("Reached maximum recursion depth while encoding. "
-                             "The data is likely too large or malformed.");
-  }
-  // start index inclusive, end index exclusive
-  size_t subvolume_size = (xe - xs) * (ye - ys) * (ze - zs);
-  if (0 == subvolume_size) {
-    printf("%zu, %zu, %zu, %zu, %zu, %zu\n", xs, xe, ys, ye, zs, ze);
+std::vector<bool> encode(const vector3<bool> &data) {
+  std::vector<bool> out;
+  const size_t side = data.size();
+  if (side != pow2_roof(side)) {
     throw std::invalid_argument(
-        "Encountered a subvolume with a size of 0 when encoding the volume.");
+        "The volume must be padded to a cube with a side of a power of 2.");
   }
-  if (is_subvolume_homogeneous(data, xs, xe, ys, ye, zs, ze)) {
-    // leaf
-    encoding.push_back(0);
-    encoding.push_back(data[xs][ys][zs]);
-    return;
-  }
-
-  size_t x_split = (xe + xs) >> 1;
-  size_t y_split = (ye + ys) >> 1;
-  size_t z_split = (ze + zs) >> 1;
-
-  encoding.push_back(1);
-
-  for (char i = 0; i < 2; i++) {
-    size_t xfirst = i ? x_split : xs;
-    size_t xsecond = i ? xe : x_split;
-    for (char j = 0; j < 2; j++) {
-      size_t yfirst = j ? y_split : ys;
-      size_t ysecond = j ? ye : y_split;
-      for (char k = 0; k < 2; k++) {
-        size_t zfirst = k ? z_split : zs;
-        size_t zsecond = k ? ze : z_split;
-        encode_recursive(data, encoding, xfirst, xsecond, yfirst, ysecond,
-                         zfirst, zsecond, depth + 1);
-      }
+  NodeWalk(side).run([&](const NodeKey &, const Box &node) {
+    // start index inclusive, end index exclusive
+    if (0 == volume(node)) {
+      throw std::invalid_argument(
+          "Encountered a subvolume with a size of 0 when encoding the volume.");
     }
-  }
-}
-
-std::vector<bool> encode(const vector3<bool> &data) {
-  std::vector<bool> out;
-  size_t resolution = data.size();
-  encode_recursive(data, out, 0, resolution, 0, resolution, 0, resolution, 0);
+    if (is_subvolume_homogeneous(data, node.xs, node.xe, node.ys, node.ye,
+                                 node.zs, node.ze)) {
+      // leaf
+      out.push_back(0);
+      out.push_back(data[node.xs][node.ys][node.zs]);
+      return Step::NEXT;
+    }
+    out.push_back(1);
+    return Step::DESCEND;
+  });
   return out;
 }
 
@@ -235,60 +275,45 @@ inline void set_range(vector3<bool> &data, bool value, const size_t xs,
   // start index inclusive, end index exclusive
   for (size_t x = xs; x < xe; x++) {
     for (size_t y = ys; y < ye; y++) {
-      for (size_t z = zs; z < ze; z++) {
-        data[x][y][z] = value;
-      }
-    }
-  }
-}
-
-size_t decode_recursive(const std::vector<bool> &encoding, vector3<bool> &out,
-                        size_t next_idx, const size_t xs, const size_t xe,
-                        const size_t ys, const size_t ye, const size_t zs,
-                        const size_t ze, size_t depth) {
-  if (depth > RECURSION_MAX_DEPTH) {
-    throw std::runtime_error("Reached maximum recursion depth while decoding. "
-                             "The data is likely too large or malformed.");
-  }
-  if (next_idx >= encoding.size()) {
-    throw std::out_of_range("Unexpected end of the encoding");
-  }
-  bool token = encoding[next_idx];
-  next_idx++;
-  if (!token) {
-    // leaf
-    if (next_idx >= encoding.size()) {
-      throw std::out_of_range("Unexpected end of the encoding");
+      std::fill(data[x][y].begin() + zs, data[x][y].begin() + ze, value);
     }
-    bool value = encoding[next_idx];
-    set_range(out, value, xs, xe, ys, ye, zs, ze);
-    return next_idx + 1;
-  } else {
-    std::array<size_t, 3> x_split = {xs, (xs + xe) / 2, xe};
-    std::array<size_t, 3> y_split = {ys, (ys + ye) / 2, ye};
-    std::array<size_t, 3> z_split = {zs, (zs + ze) / 2, ze};
-    for (int x : {0, 1}) {
-      for (int y : {0, 1}) {
-        for (int z : {0, 1}) {
-          next_idx = decode_recursive(
-              encoding, out, next_idx, x_split[x], x_split[x + 1], y_split[y],
-              y_split[y + 1], z_split[z], z_split[z + 1], depth + 1);
-        }
-      }
-    }
-    return next_idx;
   }
 }
 
 vector3<bool> decode(const std::vector<bool> &encoding,
                      const std::tuple<size_t, size_t, size_t> &resolution) {
+  check_resolution(resolution);
+  // allocated at the size of the volume, as leaves are clipped to it
   vector3<bool> out;
-  size_t decoding_res = max_res_pow2_roof(resolution);
-  cut_volume(out, decoding_res, decoding_res, decoding_res);
-  size_t end_idx = decode_recursive(encoding, out, 0, 0, decoding_res, 0,
-                                    decoding_res, 0, decoding_res, 0);
-  assert(end_idx == encoding.size());
   cut_volume(out, resolution);
+  const size_t x_res = std::get<0>(resolution), y_res = std::get<1>(resolution),
+               z_res = std::get<2>(resolution);
+  size_t idx = 0;
+  NodeWalk(max_res_pow2_roof(resolution))
+      .run([&](const NodeKey &, const Box &node) {
+        if (node.xs >= x_res || node.ys >= y_res || node.zs >= z_res) {
+          // the padding is skipped
+          idx = skip_node(encoding, idx);
+          return Step::NEXT;
+        }
+        if (idx >= encoding.size()) {
+          throw std::out_of_range("Unexpected end of the encoding");
+        }
+        if (encoding[idx]) {
+          idx++;
+          return Step::DESCEND;
+        }
+        // leaf
+        if (idx + 1 >= encoding.size()) {
+          throw std::out_of_range("Unexpected end of the encoding");
+        }
+        set_range(out, encoding[idx + 1], node.xs, std::min(node.xe, x_res),
+                  node.ys, std::min(node.ye, y_res), node.zs,
+                  std::min(node.ze, z_res));
+        idx += 2;
+        return Step::NEXT;
+      });
+  assert(idx == encoding.size());
   return out;
 }
 
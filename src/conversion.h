@@ -1,6 +1,9 @@
 #pragma once
 
+#include "../include/otbv.h"
+
 #include <cstddef>
+#include <cstdint>
 #include <tuple>
 #include <vector>
 
@@ -8,6 +11,12 @@ template <typename T> using vector3 = std::vector<std::vector<std::vector<T>>>;
 
 namespace otbv {
 
+// enough to accommodate volumes @ 1M per dimension
+static constexpr size_t RECURSION_MAX_DEPTH = 20;
+static constexpr size_t MAX_RESOLUTION = 100'000;
+static constexpr size_t MAX_VOLUME =
+    MAX_RESOLUTION * MAX_RESOLUTION * MAX_RESOLUTION;
+
 /**
  * @brief Returns the smallest power of 2 greater than or equal to \p number.
  */
@@ -26,6 +35,47 @@ size_t max_res_pow2_roof(const std::tuple<size_t, size_t, size_t> &resolution);
 size_t max_res_pow2_roof(const size_t &x_res, const size_t &y_res,
                          const size_t &z_res);
 
+/**
+ * @brief Returns true if a volume of shape \p resolution is not a cube with a
+ * power of 2 edge, and has to be padded before encoding
+ */
+bool is_padded(const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Throws std::invalid_argument if \p resolution is empty or above the
+ * allowed maximum
+ */
+void check_resolution(const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Returns the number of voxels in \p box
+ */
+size_t volume(const Box &box);
+
+/**
+ * @brief Returns \p box clipped to [0, \p x_res) x [0, \p y_res) x [0, \p
+ * z_res). The result may be empty.
+ */
+Box clip(const Box &box, const size_t x_res, const size_t y_res,
+         const size_t z_res);
+
+/**
+ * @brief Returns the intersection of \p a and \p b. The result may be empty.
+ */
+Box intersect(const Box &a, const Box &b);
+
+/**
+ * @brief Replaces a split node starting at \p node_start in \p encoding by a
+ * single leaf, if all 8 of its children are leaves with the same value.
+ *
+ * @param padding_children Bit i is set if child i lies entirely in the
+ * padding. Such children match any value.
+ * @return true if the node was collapsed
+ */
+bool collapse_uniform_children(std::vector<bool> &encoding,
+                               const size_t node_start,
+                               const uint8_t padding_children = 0);
+
 /**
  * @brief Returns a copy of \p data reshaped into a cubic tensor, if possible
  *
@@ -68,18 +118,11 @@ bool is_subvolume_homogeneous(const vector3<T> &data, const size_t xs,
 template <typename T> size_t size(const vector3<T> &data);
 
 /**
- * @brief Helper function. Takes a volume slice and a reference to the encoding
- * vector, and encodes the slice
- */
-void encode_recursive(const vector3<bool> &data, std::vector<bool> &encoding,
-                      const size_t xs, const size_t xe, const size_t ys,
-                      const size_t ye, const size_t zs, const size_t ze,
-                      size_t depth);
-
-/**
- * @brief Encodes the binary volume
+ * @brief Encodes the binary volume, a cube with a side of a power of 2 as made
+ * by \ref pad_to_cube
  *
  * @return std::vector<bool>
+ * @throws std::invalid_argument If \p data is not such a cube
  */
 std::vector<bool> encode(const vector3<bool> &data);
 
@@ -114,16 +157,8 @@ vector3<bool> pad_to_cube(const vector3<bool> &data);
 template <typename T> vector3<T> deep_copy(const vector3<T> &vector);
 
 /**
- * @brief Helper function. Takes a volume slice and a reference to the encoding
- * vector, and decodes the value for the slice
- */
-size_t decode_recursive(const std::vector<bool> &encoding, vector3<bool> &out,
-                        size_t next_idx, const size_t xs, const size_t xe,
-                        const size_t ys, const size_t ye, const size_t zs,
-                        const size_t ze, size_t depth);
-
-/**
- * @brief Decodes the encoded volume
+ * @brief Decodes the encoded volume. Only \p resolution is allocated, never
+ * the padded cube, and subtrees in the padding are skipped.
  */
 vector3<bool> decode(const std::vector<bool> &encoding,
                      const std::tuple<size_t, size_t, size_t> &resolution);
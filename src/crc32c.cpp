@@ -0,0 +1,97 @@
+#include "crc32c.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define OTBV_CRC32C_SSE42 1
+#endif
+
+namespace otbv {
+
+// reflected Castagnoli polynomial
+static constexpr uint32_t POLYNOMIAL = 0x82f63b78;
+
+using Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+/**
+ * @brief Helper function. Returns the slicing-by-8 tables: entry \p b of
+ * table \p k is the checksum of the byte \p b followed by \p k zero bytes
+ */
+static Tables make_tables() {
+  Tables tables;
+  for (uint32_t b = 0; b < 256; b++) {
+    uint32_t crc = b;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (crc & 1 ? POLYNOMIAL : 0);
+    }
+    tables[0][b] = crc;
+  }
+  for (uint32_t b = 0; b < 256; b++) {
+    for (size_t k = 1; k < 8; k++) {
+      const uint32_t previous = tables[k - 1][b];
+      tables[k][b] = (previous >> 8) ^ tables[0][previous & 0xff];
+    }
+  }
+  return tables;
+}
+
+/**
+ * @brief Helper function. Portable version, reading 8 bytes per step
+ */
+static uint32_t crc32c_software(const uint8_t *data, size_t length,
+                                uint32_t crc) {
+  static const Tables tables = make_tables();
+  for (; length >= 8; data += 8, length -= 8) {
+    // the tables take the bytes in little-endian order on any host
+    const uint32_t low = (data[0] | data[1] << 8 | data[2] << 16 |
+                          static_cast<uint32_t>(data[3]) << 24) ^
+                         crc;
+    const uint32_t high = data[4] | data[5] << 8 | data[6] << 16 |
+                          static_cast<uint32_t>(data[7]) << 24;
+    crc = tables[7][low & 0xff] ^ tables[6][(low >> 8) & 0xff] ^
+          tables[5][(low >> 16) & 0xff] ^ tables[4][low >> 24] ^
+          tables[3][high & 0xff] ^ tables[2][(high >> 8) & 0xff] ^
+          tables[1][(high >> 16) & 0xff] ^ tables[0][high >> 24];
+  }
+  for (; length; data++, length--) {
+    crc = (crc >> 8) ^ tables[0][(crc ^ *data) & 0xff];
+  }
+  return crc;
+}
+
+#ifdef OTBV_CRC32C_SSE42
+/**
+ * @brief Helper function. SSE4.2 version, reading 8 bytes per instruction
+ */
+__attribute__((target("sse4.2"))) static uint32_t
+crc32c_sse42(const uint8_t *data, size_t length, uint32_t crc) {
+  uint64_t crc64 = crc;
+  for (; length >= 8; data += 8, length -= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = static_cast<uint32_t>(crc64);
+  for (; length; data++, length--) {
+    crc = _mm_crc32_u8(crc, *data);
+  }
+  return crc;
+}
+#endif
+
+uint32_t crc32c(const uint8_t *data, size_t length, uint32_t crc) {
+  crc = ~crc;
+#ifdef OTBV_CRC32C_SSE42
+  static const bool sse42 = __builtin_cpu_supports("sse4.2");
+  if (sse42) {
+    return ~crc32c_sse42(data, length, crc);
+  }
+#endif
+  return ~crc32c_software(data, length, crc);
+}
+
+} // namespace otbv
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace otbv {
+
+/**
+ * @brief Returns the CRC32C (Castagnoli) checksum of the \p length bytes at
+ * \p data, continuing from the checksum \p crc of the bytes before them. Uses
+ * the SSE4.2 crc32 instruction when the processor has it.
+ */
+uint32_t crc32c(const uint8_t *data, size_t length, uint32_t crc = 0);
+
+} // namespace otbv
@@ -0,0 +1,129 @@
+#include "../include/otbv.h"
+#include "conversion.h"
+#include "io.h"
+#include "strided.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+/**
+ * @brief Helper function. Returns the target placing a volume of shape \p
+ * resolution at \p origin in \p out, of shape \p out_shape, laid out with byte
+ * strides \p strides, or in C order for elements of \p element_size bytes
+ */
+static DecodeTarget
+region_target(const std::tuple<size_t, size_t, size_t> &resolution,
+              uint8_t *out, const std::tuple<size_t, size_t, size_t> &out_shape,
+              const std::array<ptrdiff_t, 3> &origin, const Blend blend,
+              const ptrdiff_t *strides, const size_t element_size) {
+  check_resolution(resolution);
+  const size_t res[3] = {std::get<0>(resolution), std::get<1>(resolution),
+                         std::get<2>(resolution)};
+  const size_t shape[3] = {std::get<0>(out_shape), std::get<1>(out_shape),
+                           std::get<2>(out_shape)};
+  DecodeTarget target;
+  target.out = out;
+  target.blend = blend;
+  if (nullptr == strides) {
+    contiguous_strides(shape, element_size, target.strides);
+  } else {
+    std::copy(strides, strides + 3, target.strides);
+  }
+  // the voxels of the volume that fall within out
+  size_t starts[3], ends[3];
+  target.base = 0;
+  for (size_t a = 0; a < 3; a++) {
+    const ptrdiff_t start = std::max<ptrdiff_t>(0, -origin[a]);
+    const ptrdiff_t end =
+        std::min(static_cast<ptrdiff_t>(res[a]),
+                 static_cast<ptrdiff_t>(shape[a]) - origin[a]);
+    starts[a] = start;
+    ends[a] = std::max(start, end);
+    target.base += origin[a] * target.strides[a];
+  }
+  target.bounds = {starts[0], ends[0], starts[1], ends[1], starts[2], ends[2]};
+  return target;
+}
+
+template <typename T>
+void decode_into_region(const std::vector<bool> &encoding,
+                        const std::tuple<size_t, size_t, size_t> &resolution,
+                        T *out,
+                        const std::tuple<size_t, size_t, size_t> &out_shape,
+                        const std::array<ptrdiff_t, 3> &origin, Blend blend,
+                        const ptrdiff_t *strides, T on_value, T off_value) {
+  const DecodeTarget target =
+      region_target(resolution, reinterpret_cast<uint8_t *>(out), out_shape,
+                    origin, blend, strides, sizeof(T));
+  if (volume(target.bounds)) {
+    decode_strided(encoding, resolution, target, on_value, off_value);
+  }
+}
+
+template <typename T>
+void decode_into_region(const char *file_bytes, size_t length, T *out,
+                        const std::tuple<size_t, size_t, size_t> &out_shape,
+                        const std::array<ptrdiff_t, 3> &origin, Blend blend,
+                        const ptrdiff_t *strides, T on_value, T off_value) {
+  const Header header = parse_header(file_bytes, length);
+  require_single_channel(header);
+  const std::tuple<size_t, size_t, size_t> resolution = {
+      header.x_res, header.y_res, header.z_res};
+  const DecodeTarget target =
+      region_target(resolution, reinterpret_cast<uint8_t *>(out), out_shape,
+                    origin, blend, strides, sizeof(T));
+  if (volume(target.bounds)) {
+    decode_strided(data_bits(file_bytes + header.data_offset, header),
+                   resolution, target, on_value, off_value,
+                   header.anisotropic);
+  }
+}
+
+template <typename T>
+void decode_into(const std::vector<bool> &encoding,
+                 const std::tuple<size_t, size_t, size_t> &resolution, T *out,
+                 const ptrdiff_t *strides, T on_value, T off_value) {
+  decode_into_region(encoding, resolution, out, resolution, {0, 0, 0},
+                     Blend::OVERWRITE, strides, on_value, off_value);
+}
+
+template <typename T>
+void decode_into(const char *file_bytes, size_t length, T *out,
+                 const ptrdiff_t *strides, T on_value, T off_value) {
+  const Header header = parse_header(file_bytes, length);
+  decode_into_region(file_bytes, length, out,
+                     {header.x_res, header.y_res, header.z_res}, {0, 0, 0},
+                     Blend::OVERWRITE, strides, on_value, off_value);
+}
+
+// the element types of ScalarType
+#define OTBV_INSTANTIATE_DECODE_INTO(T)                                        \
+  template void decode_into<T>(const std::vector<bool> &,                      \
+                               const std::tuple<size_t, size_t, size_t> &,     \
+                               T *, const ptrdiff_t *, T, T);                  \
+  template void decode_into<T>(const char *, size_t, T *, const ptrdiff_t *,   \
+                               T, T);                                          \
+  template void decode_into_region<T>(                                         \
+      const std::vector<bool> &, const std::tuple<size_t, size_t, size_t> &,   \
+      T *, const std::tuple<size_t, size_t, size_t> &,                         \
+      const std::array<ptrdiff_t, 3> &, Blend, const ptrdiff_t *, T, T);       \
+  template void decode_into_region<T>(                                         \
+      const char *, size_t, T *, const std::tuple<size_t, size_t, size_t> &,   \
+      const std::array<ptrdiff_t, 3> &, Blend, const ptrdiff_t *, T, T);
+OTBV_INSTANTIATE_DECODE_INTO(uint8_t)
+OTBV_INSTANTIATE_DECODE_INTO(int8_t)
+OTBV_INSTANTIATE_DECODE_INTO(uint16_t)
+OTBV_INSTANTIATE_DECODE_INTO(int16_t)
+OTBV_INSTANTIATE_DECODE_INTO(uint32_t)
+OTBV_INSTANTIATE_DECODE_INTO(int32_t)
+OTBV_INSTANTIATE_DECODE_INTO(float)
+OTBV_INSTANTIATE_DECODE_INTO(double)
+#undef OTBV_INSTANTIATE_DECODE_INTO
+
+} // namespace otbv
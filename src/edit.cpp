@@ -0,0 +1,209 @@
+#include "../include/otbv.h"
+#include "canonical.h"
+#include "conversion.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+// no uniform value: the node is read from the encoding
+static constexpr int FROM_ENCODING = -1;
+
+/**
+ * @brief Helper function. Appends the tokens of the node \p root, of a tree
+ * of side \p side, with \p box set to \p value to \p out. The node is read
+ * from \p encoding at \p idx, which is moved past it. Subtrees that do not
+ * overlap \p box are copied unchanged.
+ */
+static void edit_node(const std::vector<bool> &encoding, size_t &idx,
+                      const size_t side, const NodeKey &root, const Box &box,
+                      const bool value, const size_t x_res, const size_t y_res,
+                      const size_t z_res, std::vector<bool> &out) {
+  // per level, the value of the leaf split open there, or FROM_ENCODING, and
+  // the start of the split node in out
+  std::array<int, RECURSION_MAX_DEPTH + 1> uniforms;
+  std::array<size_t, RECURSION_MAX_DEPTH + 1> starts;
+  NodeWalk(side, root).run(
+      [&](const NodeKey &key, const Box &node) {
+        // a node is either read from the encoding or part of a split leaf
+        const int uniform =
+            root.depth == key.depth ? FROM_ENCODING : uniforms[key.depth - 1];
+        const Box clipped = clip(node, x_res, y_res, z_res);
+        const size_t covered = volume(intersect(box, clipped));
+        if (0 == covered) {
+          if (FROM_ENCODING == uniform) {
+            const size_t end = skip_node(encoding, idx);
+            out.insert(out.end(), encoding.begin() + idx,
+                       encoding.begin() + end);
+            idx = end;
+          } else {
+            out.push_back(0);
+            out.push_back(volume(clipped) ? uniform : 0);
+          }
+          return Step::NEXT;
+        }
+        if (covered == volume(clipped)) {
+          if (FROM_ENCODING == uniform) {
+            idx = skip_node(encoding, idx);
+          }
+          out.push_back(0);
+          out.push_back(value);
+          return Step::NEXT;
+        }
+
+        // partly covered, so the node is split
+        int child_uniform = uniform;
+        if (FROM_ENCODING == uniform) {
+          if (idx + 1 >= encoding.size()) {
+            throw std::out_of_range("Unexpected end of the encoding");
+          }
+          if (!encoding[idx]) {
+            child_uniform = encoding[idx + 1];
+            idx += 2;
+          } else {
+            idx++;
+          }
+        }
+        if (child_uniform == static_cast<int>(value)) {
+          out.push_back(0);
+          out.push_back(value);
+          return Step::NEXT;
+        }
+        uniforms[key.depth] = child_uniform;
+        starts[key.depth] = out.size();
+        out.push_back(1);
+        return Step::DESCEND;
+      },
+      [&](const NodeKey &key) {
+        collapse_uniform_children(
+            out, starts[key.depth],
+            padding_children(node_box(key, side), x_res, y_res, z_res));
+      });
+}
+
+/**
+ * @brief Helper function. Returns the value shared by the 8 children of the
+ * split node at \p node_start, ignoring padding children, or -1 if any child
+ * is split or the values differ
+ */
+static int uniform_children(const std::vector<bool> &encoding,
+                            const size_t node_start, const uint8_t padding) {
+  int value = FROM_ENCODING;
+  for (size_t child = 0; child < 8; child++) {
+    const size_t i = node_start + 1 + 2 * child;
+    if (i + 1 >= encoding.size() || encoding[i]) {
+      return FROM_ENCODING;
+    }
+    if ((padding >> child) & 1) {
+      continue;
+    }
+    if (FROM_ENCODING != value && encoding[i + 1] != static_cast<bool>(value)) {
+      return FROM_ENCODING;
+    }
+    value = encoding[i + 1];
+  }
+  return value;
+}
+
+/**
+ * @brief Helper function. Replaces the tokens [\p start, \p end) of \p
+ * encoding by \p tokens, moving the tail of the stream once
+ */
+static void splice(std::vector<bool> &encoding, const size_t start,
+                   const size_t end, const std::vector<bool> &tokens) {
+  const size_t old_length = end - start;
+  const size_t common = std::min(old_length, tokens.size());
+  std::copy(tokens.begin(), tokens.begin() + common, encoding.begin() + start);
+  if (tokens.size() < old_length) {
+    encoding.erase(encoding.begin() + start + common, encoding.begin() + end);
+  } else {
+    encoding.insert(encoding.begin() + end, tokens.begin() + common,
+                    tokens.end());
+  }
+}
+
+void set_box(std::vector<bool> &encoding,
+             const std::tuple<size_t, size_t, size_t> &resolution,
+             const Box &box, bool value) {
+  check_resolution(resolution);
+  const size_t x_res = std::get<0>(resolution), y_res = std::get<1>(resolution),
+               z_res = std::get<2>(resolution);
+  const Box target = clip(box, x_res, y_res, z_res);
+  if (0 == volume(target)) {
+    return;
+  }
+
+  // descend to the smallest node holding the whole box, remembering the split
+  // nodes on the way
+  struct Ancestor {
+    size_t start;
+    uint8_t padding;
+  };
+  std::vector<Ancestor> path;
+  const size_t side = max_res_pow2_roof(resolution);
+  Box node = {0, side, 0, side, 0, side};
+  NodeKey key = {0, 0};
+  size_t idx = 0;
+  for (;;) {
+    if (idx >= encoding.size()) {
+      throw std::out_of_range("Unexpected end of the encoding");
+    }
+    if (!encoding[idx]) {
+      break;
+    }
+    int only = FROM_ENCODING;
+    for (size_t i = 0; i < 8; i++) {
+      if (volume(intersect(child_box(node, i), target))) {
+        only = FROM_ENCODING == only ? static_cast<int>(i) : 8;
+      }
+    }
+    if (8 == only) {
+      break;
+    }
+    path.push_back({idx, padding_children(node, x_res, y_res, z_res)});
+    idx++;
+    for (int i = 0; i < only; i++) {
+      idx = skip_node(encoding, idx);
+    }
+    node = child_box(node, only);
+    key = {key.prefix << 3 | static_cast<uint64_t>(only), key.depth + 1};
+  }
+
+  const size_t start = idx;
+  std::vector<bool> tokens;
+  edit_node(encoding, idx, side, key, target, value, x_res, y_res, z_res,
+            tokens);
+  splice(encoding, start, idx, tokens);
+
+  // a new leaf may make its ancestors uniform, from the bottom up
+  while (!path.empty() && 2 == tokens.size()) {
+    const Ancestor ancestor = path.back();
+    path.pop_back();
+    const int uniform =
+        uniform_children(encoding, ancestor.start, ancestor.padding);
+    if (FROM_ENCODING == uniform) {
+      break;
+    }
+    tokens = {0, static_cast<bool>(uniform)};
+    splice(encoding, ancestor.start, ancestor.start + 17, tokens);
+  }
+}
+
+void set_voxel(std::vector<bool> &encoding,
+               const std::tuple<size_t, size_t, size_t> &resolution, size_t x,
+               size_t y, size_t z, bool value) {
+  if (x >= std::get<0>(resolution) || y >= std::get<1>(resolution) ||
+      z >= std::get<2>(resolution)) {
+    throw std::out_of_range("Voxel lies outside of the volume");
+  }
+  set_box(encoding, resolution, {x, x + 1, y, y + 1, z, z + 1}, value);
+}
+
+} // namespace otbv
@@ -1,6 +1,10 @@
 #include "io.h"
 #include "conversion.h"
+#include "crc32c.h"
+#include "traversal.h"
+#include "validate.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -13,13 +17,11 @@
 namespace otbv {
 
 static constexpr char SIGNATURE[] = "OTBV\x96";
-static constexpr size_t MAX_RESOLUTION = 100'000;
-static constexpr size_t MAX_VOLUME =
-    MAX_RESOLUTION * MAX_RESOLUTION * MAX_RESOLUTION;
 
 void stream_data_as_file_bytes(
     std::ostream &stream, const std::vector<bool> &data,
-    const std::tuple<size_t, size_t, size_t> resolution, const bool padded) {
+    const std::tuple<size_t, size_t, size_t> resolution, const bool padded,
+    const bool checksum, const bool anisotropic, const size_t channels) {
   /*** metadata ***/
   char rem = data.size() % 8;
   char pad_len = rem == 0 ? 0 : 8 - rem;
@@ -27,6 +29,15 @@ void stream_data_as_file_bytes(
   meta_first |= (pad_len << 5);
   // flag for whether the volume was padded to cubic
   meta_first |= (padded << 4);
+  if (checksum) {
+    meta_first |= CHECKSUM_FLAG;
+  }
+  if (anisotropic) {
+    meta_first |= ANISOTROPIC_FLAG;
+  }
+  if (channels > 1) {
+    meta_first |= MULTICHANNEL_FLAG;
+  }
 
   uint32_t meta_res_x = std::get<0>(resolution), meta_res_y = 0, meta_res_z = 0;
   if (padded) {
@@ -37,12 +48,12 @@ void stream_data_as_file_bytes(
   uint32_t meta_data_len = (data.size() + pad_len) / 8;
 
   /*** data ***/
-  std::vector<bool> data_out;
-  data_out.reserve(pad_len + data.size());
-  for (int i = 0; i < pad_len; ++i) {
-    data_out.push_back(0);
+  // the padding bits lead the first byte
+  std::vector<uint8_t> data_out(meta_data_len);
+  for (size_t i = 0; i < data.size(); i++) {
+    const size_t bit = pad_len + i;
+    data_out[bit >> 3] |= static_cast<uint8_t>(data[i]) << (7 - (bit & 7));
   }
-  data_out.insert(data_out.end(), data.begin(), data.end());
 
   // signature
   stream.write(SIGNATURE, 5);
@@ -53,14 +64,18 @@ void stream_data_as_file_bytes(
   stream.write(reinterpret_cast<const char *>(&meta_res_z), sizeof(meta_res_z));
   stream.write(reinterpret_cast<const char *>(&meta_data_len),
                sizeof(meta_data_len));
-  // data
-  for (std::size_t i = 0; i < data_out.size(); i += 8) {
-    char c = 0;
-    for (int j = 0; j < 8; j++) {
-      c |= static_cast<char>(data_out[i + j]) << (7 - j);
-    }
-    stream.write(&c, 1);
+  if (checksum) {
+    const uint32_t crc = crc32c(data_out.data(), data_out.size());
+    stream.write(reinterpret_cast<const char *>(&crc), sizeof(crc));
   }
+  if (channels > 1) {
+    const uint8_t meta_channels = static_cast<uint8_t>(channels);
+    stream.write(reinterpret_cast<const char *>(&meta_channels),
+                 sizeof(meta_channels));
+  }
+  // data
+  stream.write(reinterpret_cast<const char *>(data_out.data()),
+               data_out.size());
 }
 
 void save(const std::string &filename, const std::vector<bool> &data,
@@ -79,9 +94,28 @@ void save(const std::string &filename,
   const std::vector<bool> encoded_data = encode(padded_data);
   const auto resolution =
       std::make_tuple(data.size(), data[0].size(), data[0][0].size());
+  save_encoding(filename, encoded_data, resolution);
+}
+
+void save_encoding(const std::string &filename,
+                   const std::vector<bool> &encoding,
+                   const std::tuple<size_t, size_t, size_t> &resolution) {
+  save_encoding(filename, encoding, resolution, false);
+}
+
+/**
+ * @brief Helper function. Writes \p encoding to \p filename and reports the
+ * size of the file
+ */
+static void write_encoding(const std::string &filename,
+                           const std::vector<bool> &encoding,
+                           const std::tuple<size_t, size_t, size_t> &resolution,
+                           bool checksum, bool anisotropic,
+                           size_t channels = 1) {
   std::ofstream file_out(filename, std::ofstream::binary);
-  stream_data_as_file_bytes(file_out, encoded_data, resolution,
-                            size(padded_data) > size(data));
+  stream_data_as_file_bytes(file_out, encoding, resolution,
+                            is_padded(resolution), checksum, anisotropic,
+                            channels);
   int bytes_written = file_out.tellp();
   if (bytes_written > 0) {
     printf("Written %d bytes\n", bytes_written);
@@ -89,64 +123,268 @@ void save(const std::string &filename,
   file_out.close();
 }
 
-uint32_t pack_chars(char *c) {
-  uint32_t val = 0;
-  val |= c[0];
-  val |= c[1] << 8;
-  val |= c[2] << 16;
-  val |= c[3] << 24;
-  return val;
+void save_encoding(const std::string &filename,
+                   const std::vector<bool> &encoding,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   bool checksum) {
+  write_encoding(filename, encoding, resolution, checksum, false);
 }
 
-std::vector<std::vector<std::vector<bool>>> load(const std::string &filename) {
-  std::ifstream file_in(filename, std::ios::binary);
-  if (!file_in) {
-    throw std::runtime_error("Could not open file for reading.");
+void save_anisotropic(const std::string &filename,
+                      const std::vector<bool> &encoding,
+                      const std::tuple<size_t, size_t, size_t> &resolution,
+                      bool checksum) {
+  write_encoding(filename, to_anisotropic(encoding, resolution), resolution,
+                 checksum, true);
+}
+
+void save_channels(const std::string &filename,
+                   const std::vector<bool> &encoding,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   size_t channels, bool checksum) {
+  if (0 == channels || channels > MAX_CHANNELS) {
+    throw std::invalid_argument("The number of channels must lie in [1, 255]");
   }
+  write_encoding(filename, encoding, resolution, checksum, false, channels);
+}
 
-  char sign_buffer[5], meta_buffer[17], padding_length;
-  uint32_t x_res, y_res, z_res;
+uint32_t pack_chars(const char *c) {
+  const uint8_t *u = reinterpret_cast<const uint8_t *>(c);
+  uint32_t val = 0;
+  val |= u[0];
+  val |= u[1] << 8;
+  val |= u[2] << 16;
+  val |= static_cast<uint32_t>(u[3]) << 24;
+  return val;
+}
 
+Header parse_header(const char *bytes, const size_t file_size) {
+  if (file_size < HEADER_SIZE) {
+    throw std::runtime_error("The file is too short to hold an OTBV header.");
+  }
   // signature
-  static_cast<void>(file_in.read(sign_buffer, 5));
-  if (std::memcmp(SIGNATURE, sign_buffer, 5)) {
+  if (std::memcmp(SIGNATURE, bytes, 5)) {
     throw std::runtime_error(
         "Signature validation failed. Could not confirm that the provided "
         "filename refers to a valid OTBV file.");
   }
 
   // metadata
-  static_cast<void>(file_in.read(meta_buffer, 17));
-  padding_length = meta_buffer[0] >> 5;
-  bool is_padded = (meta_buffer[0] >> 4) & 1;
-  x_res = pack_chars(meta_buffer + 1);
-  if (!is_padded) {
-    y_res = z_res = x_res;
+  const char *meta_buffer = bytes + 5;
+  Header header;
+  header.padding_length = static_cast<uint8_t>(meta_buffer[0]) >> 5;
+  header.padded = (meta_buffer[0] >> 4) & 1;
+  header.x_res = pack_chars(meta_buffer + 1);
+  if (!header.padded) {
+    header.y_res = header.z_res = header.x_res;
   } else {
-    y_res = pack_chars(meta_buffer + 5);
-    z_res = pack_chars(meta_buffer + 9);
+    header.y_res = pack_chars(meta_buffer + 5);
+    header.z_res = pack_chars(meta_buffer + 9);
   }
-
-  if (x_res > MAX_RESOLUTION || y_res > MAX_RESOLUTION ||
-      z_res > MAX_RESOLUTION) {
+  if (header.x_res > MAX_RESOLUTION || header.y_res > MAX_RESOLUTION ||
+      header.z_res > MAX_RESOLUTION) {
     throw std::runtime_error("Provided volume lists resolution above allowed "
                              "maximum 10e5 per dimension.");
   }
 
+  header.data_length = pack_chars(meta_buffer + 13);
+  header.checksummed = meta_buffer[0] & CHECKSUM_FLAG;
+  header.anisotropic = meta_buffer[0] & ANISOTROPIC_FLAG;
+  header.checksum = 0;
+  header.data_offset = HEADER_SIZE;
+  if (header.checksummed) {
+    if (file_size < MAX_HEADER_SIZE) {
+      throw std::runtime_error("The file is too short to hold its checksum.");
+    }
+    header.checksum = pack_chars(bytes + HEADER_SIZE);
+    header.data_offset += CHECKSUM_SIZE;
+  }
+  header.channels = 1;
+  if (meta_buffer[0] & MULTICHANNEL_FLAG) {
+    if (file_size < header.data_offset + CHANNELS_SIZE) {
+      throw std::runtime_error(
+          "The file is too short to hold its number of channels.");
+    }
+    header.channels = static_cast<uint8_t>(bytes[header.data_offset]);
+    if (header.channels < 2) {
+      throw std::runtime_error(
+          "A multi-channel file must hold at least 2 channels.");
+    }
+    header.data_offset += CHANNELS_SIZE;
+  }
+  const size_t available = file_size - header.data_offset;
+  if (header.data_length > available && 0 == header.data_length % 8 &&
+      header.data_length / 8 == available) {
+    // some writers store the data length in bits
+    header.data_length /= 8;
+  }
+  if (header.data_length > available) {
+    throw std::runtime_error("The file is shorter than its header declares.");
+  }
+  return header;
+}
+
+PackedBits data_bits(const char *data, const Header &header) {
+  const size_t bits = static_cast<size_t>(header.data_length) * 8;
+  if (header.padding_length > bits) {
+    throw std::runtime_error("The padding is longer than the data.");
+  }
+  return {reinterpret_cast<const uint8_t *>(data), header.padding_length,
+          bits - header.padding_length};
+}
+
+void check_checksum(const char *data, const Header &header) {
+  if (header.checksummed &&
+      crc32c(reinterpret_cast<const uint8_t *>(data), header.data_length) !=
+          header.checksum) {
+    throw std::runtime_error("The checksum does not match the data. The file "
+                             "is likely corrupted or truncated.");
+  }
+}
+
+void require_isotropic(const Header &header) {
+  if (header.anisotropic) {
+    throw std::runtime_error("The tree has the anisotropic layout, which this "
+                             "reader does not support. Load it with "
+                             "load_encoding instead.");
+  }
+}
+
+void require_single_channel(const Header &header) {
+  if (header.channels > 1) {
+    throw std::runtime_error("The tree has several channels, which this reader "
+                             "does not support. Load it with load_channels "
+                             "instead.");
+  }
+}
+
+bool verify_checksum(const char *file_bytes, size_t length) {
+  const Header header = parse_header(file_bytes, length);
+  check_checksum(file_bytes + header.data_offset, header);
+  return header.checksummed;
+}
+
+std::vector<bool>
+load_encoding(const std::string &filename,
+              std::tuple<size_t, size_t, size_t> &resolution) {
+  return load_encoding(filename, resolution, false);
+}
+
+/**
+ * @brief Helper function. Reads the header of \p filename into \p header and
+ * returns its data, checked against the checksum with \p verify_checksum and
+ * validated. Malformed trees are rejected before the encoding, or the volume
+ * decoded from it, is allocated. Multi-channel files are only read with \p
+ * multichannel.
+ */
+static std::vector<char> read_data(const std::string &filename, Header &header,
+                                   bool verify_checksum,
+                                   bool multichannel = false) {
+  std::ifstream file_in(filename, std::ios::binary | std::ios::ate);
+  if (!file_in) {
+    throw std::runtime_error("Could not open file for reading.");
+  }
+  const size_t file_size = static_cast<size_t>(file_in.tellg());
+  file_in.seekg(0);
+
+  char header_buffer[MAX_HEADER_SIZE] = {};
+  static_cast<void>(file_in.read(
+      header_buffer, std::min<size_t>(file_size, MAX_HEADER_SIZE)));
+  header = parse_header(header_buffer, file_size);
+  if (multichannel) {
+    require_isotropic(header);
+  } else {
+    require_single_channel(header);
+  }
+
   // data
-  uint32_t data_length = pack_chars(meta_buffer + 13);
-  char data_buffer[data_length];
-  static_cast<void>(file_in.read(data_buffer, data_length));
+  std::vector<char> data_buffer(header.data_length);
+  file_in.clear();
+  file_in.seekg(header.data_offset);
+  static_cast<void>(file_in.read(data_buffer.data(), header.data_length));
+  if (verify_checksum) {
+    check_checksum(data_buffer.data(), header);
+  }
+  validate_bits(data_bits(data_buffer.data(), header),
+                {header.x_res, header.y_res, header.z_res},
+                header.anisotropic, header.channels);
+  return data_buffer;
+}
+
+/**
+ * @brief Helper function. Unpacks the data section \p data of a file with the
+ * header \p header into an encoding
+ */
+static std::vector<bool> unpack(const std::vector<char> &data,
+                                const Header &header) {
+  const PackedBits bits = data_bits(data.data(), header);
   std::vector<bool> encoding;
-  encoding.reserve(data_length * 8);
-  for (size_t i = 0; i < data_length; i++) {
-    for (char j = 7; j >= 0; j--) {
-      encoding.push_back((data_buffer[i] >> j) & 1);
-    }
+  encoding.reserve(bits.size());
+  for (size_t i = 0; i < bits.size(); i++) {
+    encoding.push_back(bits[i]);
+  }
+  return encoding;
+}
+
+std::vector<bool>
+load_encoding(const std::string &filename,
+              std::tuple<size_t, size_t, size_t> &resolution,
+              bool verify_checksum) {
+  Header header;
+  const std::vector<char> data_buffer =
+      read_data(filename, header, verify_checksum);
+  resolution = {header.x_res, header.y_res, header.z_res};
+  const std::vector<bool> encoding = unpack(data_buffer, header);
+  if (header.anisotropic) {
+    return to_isotropic(encoding, resolution);
   }
-  encoding.erase(encoding.begin(), encoding.begin() + padding_length);
-  auto out = decode(encoding, {x_res, y_res, z_res});
+  return encoding;
+}
+
+std::vector<std::vector<std::vector<bool>>> load(const std::string &filename) {
+  return load(filename, false);
+}
+
+std::vector<std::vector<std::vector<bool>>> load(const std::string &filename,
+                                                 bool verify_checksum) {
+  Header header;
+  const std::vector<char> data_buffer =
+      read_data(filename, header, verify_checksum);
+  const std::tuple<size_t, size_t, size_t> resolution = {
+      header.x_res, header.y_res, header.z_res};
+  const PackedBits bits = data_bits(data_buffer.data(), header);
+  if (!header.anisotropic) {
+    return decode(unpack(data_buffer, header), resolution);
+  }
+
+  // anisotropic trees are decoded straight into the volume, never padded
+  vector3<bool> out(header.x_res,
+                    std::vector<std::vector<bool>>(
+                        header.y_res, std::vector<bool>(header.z_res)));
+  visit_leaves(
+      bits, resolution, LeafFilter::OCCUPIED,
+      [&](const Leaf &leaf) {
+        for (size_t x = leaf.box.xs; x < leaf.box.xe; x++) {
+          for (size_t y = leaf.box.ys; y < leaf.box.ye; y++) {
+            std::fill(out[x][y].begin() + leaf.box.zs,
+                      out[x][y].begin() + leaf.box.ze, true);
+          }
+        }
+      },
+      true);
   return out;
 }
 
+std::vector<bool>
+load_channels(const std::string &filename,
+              std::tuple<size_t, size_t, size_t> &resolution, size_t &channels,
+              bool verify_checksum) {
+  Header header;
+  const std::vector<char> data_buffer =
+      read_data(filename, header, verify_checksum, true);
+  resolution = {header.x_res, header.y_res, header.z_res};
+  channels = header.channels;
+  return unpack(data_buffer, header);
+}
+
 } // namespace otbv
@@ -1,18 +1,103 @@
 #pragma once
 
+#include "bits.h"
+
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <tuple>
 #include <vector>
 
 namespace otbv {
+
+// signature, metadata byte, 3 resolutions and the data length
+static constexpr size_t HEADER_SIZE = 22;
+// CRC32C of the data, stored after the header when the metadata asks for it
+static constexpr size_t CHECKSUM_SIZE = 4;
+// number of channels, stored after the checksum when the metadata asks for it
+static constexpr size_t CHANNELS_SIZE = 1;
+static constexpr size_t MAX_HEADER_SIZE =
+    HEADER_SIZE + CHECKSUM_SIZE + CHANNELS_SIZE;
+// metadata bit marking a checksummed file
+static constexpr uint8_t CHECKSUM_FLAG = 1;
+// metadata bit marking a tree with the anisotropic layout, see root_node
+static constexpr uint8_t ANISOTROPIC_FLAG = 2;
+// metadata bit marking a multi-channel tree, see merge_channels
+static constexpr uint8_t MULTICHANNEL_FLAG = 4;
+// the number of channels is stored in one byte
+static constexpr size_t MAX_CHANNELS = 255;
+
+/**
+ * @brief Metadata stored in the header of an OTBV file
+ */
+struct Header {
+  uint8_t padding_length;
+  bool padded;
+  uint32_t x_res, y_res, z_res;
+  // in bytes
+  uint32_t data_length;
+  bool checksummed;
+  uint32_t checksum;
+  bool anisotropic;
+  // 1 for single-channel files
+  uint8_t channels;
+  // in bytes, from the start of the file
+  size_t data_offset;
+};
+
+/**
+ * @brief Parses the header at the start of \p bytes, a file of \p file_size
+ * bytes, and checks it against the size of the file. Reads up to \p
+ * MAX_HEADER_SIZE bytes.
+ *
+ * @throws std::runtime_error If the header is malformed or does not fit the
+ * file
+ */
+Header parse_header(const char *bytes, const size_t file_size);
+
+/**
+ * @brief Returns a view of the encoding in \p data, the data section of a
+ * file with the header \p header
+ */
+PackedBits data_bits(const char *data, const Header &header);
+
+/**
+ * @brief Checks the data section \p data of a file with the header \p
+ * header against its checksum, if the file has one
+ *
+ * @throws std::runtime_error If the checksum does not match
+ */
+void check_checksum(const char *data, const Header &header);
+
 /**
  * @brief Formats \p data, \p resolution, and \p padded as a proper OTBV file,
- * and streams the resulting bytes to \p stream
+ * and streams the resulting bytes to \p stream. With \p checksum, the CRC32C
+ * of the data is stored after the header. \p anisotropic flags \p data as a
+ * tree with the anisotropic layout. With more than one of \p channels, \p data
+ * is a multi-channel tree, and the number of channels is stored after the
+ * checksum.
  */
 void stream_data_as_file_bytes(
     std::ostream &stream, const std::vector<bool> &data,
-    const std::tuple<size_t, size_t, size_t> resolution, const bool padded);
+    const std::tuple<size_t, size_t, size_t> resolution, const bool padded,
+    const bool checksum = false, const bool anisotropic = false,
+    const size_t channels = 1);
+
+/**
+ * @brief Throws if the file with the header \p header has the anisotropic
+ * layout, for readers of raw file data that only walk octrees
+ *
+ * @throws std::runtime_error If the tree is anisotropic
+ */
+void require_isotropic(const Header &header);
+
+/**
+ * @brief Throws if the file with the header \p header holds several channels,
+ * for readers of raw file data that expect one value per leaf
+ *
+ * @throws std::runtime_error If the tree has several channels
+ */
+void require_single_channel(const Header &header);
 
 /**
  * @brief Encodes \p data and writes it to \p filename
@@ -29,9 +114,55 @@ void save(const std::string &filename,
 void save(const std::string &filename, const std::vector<bool> &data,
           const std::tuple<size_t, size_t, size_t> &resolution);
 
+/**
+ * @brief Writes an already encoded volume of shape \p resolution to \p
+ * filename
+ */
+void save_encoding(const std::string &filename,
+                   const std::vector<bool> &encoding,
+                   const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Overload of \p save_encoding. With \p checksum, the CRC32C of the
+ * data is stored after the header, so that corruption can be detected without
+ * decoding.
+ */
+void save_encoding(const std::string &filename,
+                   const std::vector<bool> &encoding,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   bool checksum);
+
+/**
+ * @brief Reads the encoded volume from \p filename without decoding it, and
+ * stores its shape in \p resolution
+ */
+std::vector<bool>
+load_encoding(const std::string &filename,
+              std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Overload of \p load_encoding. With \p verify_checksum, the data of
+ * a checksummed file is checked before it is parsed.
+ *
+ * @throws std::runtime_error If the checksum does not match
+ */
+std::vector<bool>
+load_encoding(const std::string &filename,
+              std::tuple<size_t, size_t, size_t> &resolution,
+              bool verify_checksum);
+
 /**
  * @brief Reads and decodes the volume from \p filename
  */
 std::vector<std::vector<std::vector<bool>>> load(const std::string &filename);
 
+/**
+ * @brief Overload of \p load, checking the checksum first with \p
+ * verify_checksum
+ *
+ * @throws std::runtime_error If the checksum does not match
+ */
+std::vector<std::vector<std::vector<bool>>> load(const std::string &filename,
+                                                 bool verify_checksum);
+
 } // namespace otbv
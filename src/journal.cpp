@@ -0,0 +1,468 @@
+#include "../include/otbv.h"
+#include "conversion.h"
+#include "io.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace otbv {
+
+// every record: magic, the box as 6 little endian uint32, the value, and 3
+// reserved bytes
+static constexpr char JOURNAL_MAGIC[4] = {'O', 'T', 'B', 'J'};
+static constexpr size_t JOURNAL_RECORD_SIZE = 32;
+
+namespace {
+struct JournalRecord {
+  Box box;
+  bool value;
+};
+
+/**
+ * @brief Lock held on a lock file with flock until destruction
+ */
+class FileLock {
+public:
+  FileLock(const std::string &path, int operation) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(),
+                              "Could not open " + path);
+    }
+    while (::flock(fd, operation)) {
+      if (EINTR != errno) {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(),
+                                "Could not lock " + path);
+      }
+    }
+  }
+  ~FileLock() { ::close(fd); }
+
+  FileLock(const FileLock &) = delete;
+  FileLock &operator=(const FileLock &) = delete;
+
+private:
+  int fd;
+};
+
+/**
+ * @brief Identity and version of a file, to detect replacements
+ */
+struct FileStamp {
+  bool exists = false;
+  dev_t device = 0;
+  ino_t inode = 0;
+  off_t size = 0;
+  long long modified = 0;
+
+  bool same_file(const FileStamp &other) const {
+    return exists == other.exists && device == other.device &&
+           inode == other.inode;
+  }
+};
+} // namespace
+
+/**
+ * @brief Helper function. Returns the stamp of \p path, which may not exist
+ */
+static FileStamp stamp(const std::string &path) {
+  FileStamp out;
+  struct stat st;
+  if (0 == ::stat(path.c_str(), &st)) {
+    out.exists = true;
+    out.device = st.st_dev;
+    out.inode = st.st_ino;
+    out.size = st.st_size;
+    out.modified = st.st_mtim.tv_sec * 1'000'000'000ll + st.st_mtim.tv_nsec;
+  }
+  return out;
+}
+
+/**
+ * @brief Helper function. Returns the bytes of \p path, or nothing if it does
+ * not exist
+ */
+static std::vector<char> read_bytes(const std::string &path) {
+  std::ifstream file_in(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file_in),
+          std::istreambuf_iterator<char>()};
+}
+
+/**
+ * @brief Helper function. Writes \p bytes to \p path and flushes them to disk,
+ * so that renaming the file afterwards cannot expose a partial one
+ */
+static void write_synced(const std::string &path, const std::string &bytes) {
+  const int fd =
+      ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Could not open " + path);
+  }
+  size_t written = 0;
+  while (written < bytes.size()) {
+    const ssize_t n =
+        ::write(fd, bytes.data() + written, bytes.size() - written);
+    if (n < 0 && EINTR == errno) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    written += static_cast<size_t>(n);
+  }
+  if (written < bytes.size() || ::fsync(fd)) {
+    const int error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(),
+                            "Could not write " + path);
+  }
+  ::close(fd);
+}
+
+/**
+ * @brief Helper function. Serialises \p record
+ */
+static void pack_record(const JournalRecord &record,
+                        char out[JOURNAL_RECORD_SIZE]) {
+  std::memset(out, 0, JOURNAL_RECORD_SIZE);
+  std::memcpy(out, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+  const size_t bounds[6] = {record.box.xs, record.box.xe, record.box.ys,
+                            record.box.ye, record.box.zs, record.box.ze};
+  for (size_t i = 0; i < 6; i++) {
+    for (size_t byte = 0; byte < 4; byte++) {
+      out[4 + 4 * i + byte] =
+          static_cast<char>((bounds[i] >> (8 * byte)) & 0xff);
+    }
+  }
+  out[28] = record.value;
+}
+
+/**
+ * @brief Helper function. Parses the records of a journal. A record cut short
+ * by a crash at the end is ignored.
+ *
+ * @throws std::runtime_error If a record is malformed
+ */
+static std::vector<JournalRecord>
+parse_journal(const std::vector<char> &bytes) {
+  std::vector<JournalRecord> records;
+  for (size_t pos = 0; pos + JOURNAL_RECORD_SIZE <= bytes.size();
+       pos += JOURNAL_RECORD_SIZE) {
+    const char *record = bytes.data() + pos;
+    if (std::memcmp(record, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC))) {
+      throw std::runtime_error("Malformed journal record at offset " +
+                               std::to_string(pos));
+    }
+    size_t bounds[6];
+    for (size_t i = 0; i < 6; i++) {
+      bounds[i] = 0;
+      for (size_t byte = 0; byte < 4; byte++) {
+        bounds[i] |= static_cast<size_t>(
+                         static_cast<uint8_t>(record[4 + 4 * i + byte]))
+                     << (8 * byte);
+      }
+    }
+    records.push_back({{bounds[0], bounds[1], bounds[2], bounds[3], bounds[4],
+                        bounds[5]},
+                       0 != record[28]});
+  }
+  return records;
+}
+
+/**
+ * @brief Helper function. Applies \p records to \p encoding, in order
+ */
+static std::vector<bool>
+apply_journal(std::vector<bool> encoding,
+              const std::tuple<size_t, size_t, size_t> &resolution,
+              const std::vector<JournalRecord> &records) {
+  if (records.empty()) {
+    return encoding;
+  }
+  Octree tree(std::move(encoding), resolution);
+  for (const JournalRecord &record : records) {
+    tree.set_box(record.box, record.value);
+  }
+  return tree.encode();
+}
+
+struct JournaledVolume::Impl {
+  std::string filename, journal_path, lock_path;
+  JournalOptions options;
+  std::tuple<size_t, size_t, size_t> shape;
+  // compactions keep the checksum and the layout of the volume
+  bool checksum = false, anisotropic = false;
+
+  // guards the journal descriptor and \p error
+  std::mutex append_mutex;
+  int journal_fd = -1;
+  std::exception_ptr error;
+
+  std::mutex compact_mutex;
+  std::thread compactor;
+  std::atomic<bool> compacting{false};
+
+  bool journal_current() const;
+  void reopen_journal();
+  void append(const JournalRecord &record);
+  void compact();
+};
+
+/**
+ * @brief Returns true if the open journal is still the one at \p
+ * journal_path, which compactions replace
+ */
+bool JournaledVolume::Impl::journal_current() const {
+  struct stat open_st, path_st;
+  return journal_fd >= 0 && 0 == ::fstat(journal_fd, &open_st) &&
+         0 == ::stat(journal_path.c_str(), &path_st) &&
+         open_st.st_dev == path_st.st_dev && open_st.st_ino == path_st.st_ino;
+}
+
+/**
+ * @brief Opens the current journal, creating it if needed, and cuts off a
+ * record left partly written by a crash. Called under the exclusive lock.
+ */
+void JournaledVolume::Impl::reopen_journal() {
+  if (journal_fd >= 0) {
+    ::close(journal_fd);
+  }
+  journal_fd = ::open(journal_path.c_str(),
+                      O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  struct stat st;
+  if (journal_fd < 0 || ::fstat(journal_fd, &st)) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Could not open " + journal_path);
+  }
+  const off_t torn = st.st_size % JOURNAL_RECORD_SIZE;
+  if (torn && ::ftruncate(journal_fd, st.st_size - torn)) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Could not repair " + journal_path);
+  }
+}
+
+void JournaledVolume::Impl::append(const JournalRecord &record) {
+  std::lock_guard<std::mutex> guard(append_mutex);
+  if (error) {
+    std::exception_ptr failed = error;
+    error = nullptr;
+    std::rethrow_exception(failed);
+  }
+  char bytes[JOURNAL_RECORD_SIZE];
+  pack_record(record, bytes);
+
+  size_t records = 0;
+  for (bool written = false; !written;) {
+    {
+      // appends share the lock; a single small write with O_APPEND is atomic
+      FileLock shared(lock_path, LOCK_SH);
+      if (journal_current()) {
+        struct stat st;
+        if (static_cast<ssize_t>(JOURNAL_RECORD_SIZE) !=
+                ::write(journal_fd, bytes, JOURNAL_RECORD_SIZE) ||
+            ::fstat(journal_fd, &st)) {
+          throw std::system_error(errno, std::generic_category(),
+                                  "Could not append to " + journal_path);
+        }
+        records = st.st_size / JOURNAL_RECORD_SIZE;
+        written = true;
+        continue;
+      }
+    }
+    FileLock exclusive(lock_path, LOCK_EX);
+    if (!journal_current()) {
+      reopen_journal();
+    }
+  }
+
+  if (records < options.max_records || compacting.exchange(true)) {
+    return;
+  }
+  if (!options.background) {
+    try {
+      compact();
+    } catch (...) {
+      compacting = false;
+      throw;
+    }
+    compacting = false;
+    return;
+  }
+  // the previous compactor has finished, as \p compacting was clear
+  if (compactor.joinable()) {
+    compactor.join();
+  }
+  compactor = std::thread([this]() {
+    try {
+      compact();
+    } catch (...) {
+      std::lock_guard<std::mutex> guard(append_mutex);
+      error = std::current_exception();
+    }
+    compacting = false;
+  });
+}
+
+void JournaledVolume::Impl::compact() {
+  std::lock_guard<std::mutex> guard(compact_mutex);
+
+  // a consistent snapshot of the volume and its journal
+  std::vector<bool> encoding;
+  std::tuple<size_t, size_t, size_t> resolution;
+  FileStamp base_stamp, journal_stamp;
+  std::vector<JournalRecord> records;
+  {
+    FileLock shared(lock_path, LOCK_SH);
+    // corruption must not be sealed under a fresh checksum
+    encoding = otbv::load_encoding(filename, resolution, checksum);
+    base_stamp = stamp(filename);
+    journal_stamp = stamp(journal_path);
+    records = parse_journal(read_bytes(journal_path));
+  }
+  if (records.empty()) {
+    return;
+  }
+
+  // the slow part runs without holding the lock
+  encoding = apply_journal(std::move(encoding), resolution, records);
+  if (anisotropic) {
+    encoding = to_anisotropic(encoding, resolution);
+  }
+  std::ostringstream file_bytes;
+  stream_data_as_file_bytes(file_bytes, encoding, resolution,
+                            is_padded(resolution), checksum, anisotropic);
+  const std::string suffix = ".compact." + std::to_string(::getpid());
+  const std::string base_temp = filename + suffix,
+                    journal_temp = journal_path + suffix;
+  write_synced(base_temp, file_bytes.str());
+
+  FileLock exclusive(lock_path, LOCK_EX);
+  const FileStamp current = stamp(filename);
+  if (!current.same_file(base_stamp) || current.size != base_stamp.size ||
+      current.modified != base_stamp.modified ||
+      !stamp(journal_path).same_file(journal_stamp)) {
+    // another process compacted in the meantime
+    ::unlink(base_temp.c_str());
+    return;
+  }
+  // edits appended since the snapshot stay in the journal
+  const std::vector<char> journal = read_bytes(journal_path);
+  const size_t folded = records.size() * JOURNAL_RECORD_SIZE;
+  const size_t end =
+      journal.size() - (journal.size() - folded) % JOURNAL_RECORD_SIZE;
+  write_synced(journal_temp, std::string(journal.begin() + folded,
+                                         journal.begin() + end));
+  // replaying folded edits is harmless, so the volume goes first
+  if (::rename(base_temp.c_str(), filename.c_str()) ||
+      ::rename(journal_temp.c_str(), journal_path.c_str())) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Could not replace " + filename);
+  }
+}
+
+JournaledVolume::JournaledVolume(const std::string &filename,
+                                 const JournalOptions &options)
+    : impl(new Impl) {
+  impl->filename = filename;
+  impl->journal_path = filename + ".journal";
+  impl->lock_path = filename + ".lock";
+  impl->options = options;
+  std::ifstream file_in(filename, std::ios::binary | std::ios::ate);
+  if (!file_in) {
+    throw std::runtime_error("Could not open file for reading.");
+  }
+  const size_t file_size = static_cast<size_t>(file_in.tellg());
+  file_in.seekg(0);
+  char header_buffer[MAX_HEADER_SIZE] = {};
+  static_cast<void>(file_in.read(
+      header_buffer, std::min<size_t>(file_size, MAX_HEADER_SIZE)));
+  const Header header = parse_header(header_buffer, file_size);
+  require_single_channel(header);
+  impl->shape = {header.x_res, header.y_res, header.z_res};
+  impl->checksum = header.checksummed;
+  impl->anisotropic = header.anisotropic;
+}
+
+JournaledVolume::~JournaledVolume() {
+  if (impl->compactor.joinable()) {
+    impl->compactor.join();
+  }
+  if (impl->journal_fd >= 0) {
+    ::close(impl->journal_fd);
+  }
+}
+
+void JournaledVolume::set_box(const Box &box, bool value) {
+  const Box clipped = clip(box, std::get<0>(impl->shape),
+                           std::get<1>(impl->shape), std::get<2>(impl->shape));
+  if (volume(clipped)) {
+    impl->append({clipped, value});
+  }
+}
+
+void JournaledVolume::set_voxel(size_t x, size_t y, size_t z, bool value) {
+  if (x >= std::get<0>(impl->shape) || y >= std::get<1>(impl->shape) ||
+      z >= std::get<2>(impl->shape)) {
+    throw std::out_of_range("Voxel lies outside of the volume");
+  }
+  impl->append({{x, x + 1, y, y + 1, z, z + 1}, value});
+}
+
+std::vector<bool> JournaledVolume::load_encoding() const {
+  std::tuple<size_t, size_t, size_t> resolution;
+  return load_journaled(impl->filename, resolution);
+}
+
+void JournaledVolume::compact() { impl->compact(); }
+
+size_t JournaledVolume::pending() const {
+  return stamp(impl->journal_path).size / JOURNAL_RECORD_SIZE;
+}
+
+std::tuple<size_t, size_t, size_t> JournaledVolume::resolution() const {
+  return impl->shape;
+}
+
+std::vector<bool>
+load_journaled(const std::string &filename,
+               std::tuple<size_t, size_t, size_t> &resolution) {
+  const std::string journal_path = filename + ".journal";
+  if (!stamp(journal_path).exists) {
+    return load_encoding(filename, resolution);
+  }
+  std::vector<bool> encoding;
+  std::vector<char> journal;
+  {
+    FileLock shared(filename + ".lock", LOCK_SH);
+    encoding = load_encoding(filename, resolution);
+    journal = read_bytes(journal_path);
+  }
+  return apply_journal(std::move(encoding), resolution,
+                       parse_journal(journal));
+}
+
+} // namespace otbv
@@ -0,0 +1,427 @@
+#include "../include/otbv.h"
+#include "archive.h"
+#include "conversion.h"
+#include "io.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "strided.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+namespace fs = std::filesystem;
+
+static constexpr size_t NONE = static_cast<size_t>(-1);
+
+/**
+ * @brief Helper function. Mixes \p value into a well spread 64-bit seed
+ * (splitmix64), so that neighbouring samples draw unrelated crops and flips
+ */
+static uint64_t mix_seed(uint64_t value) {
+  value += 0x9e3779b97f4a7c15ull;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+  return value ^ (value >> 31);
+}
+
+struct DataLoaderState {
+  struct Slot {
+    enum { FREE, FILLING, READY, HELD } state = FREE;
+    std::unique_ptr<uint8_t[]> data;
+    // the batch being filled: its position in the stream of batches, and how
+    // many of its samples were handed out and are still being decoded
+    size_t sequence = 0, assigned = 0, remaining = 0;
+    std::vector<size_t> samples;
+  };
+
+  struct Task {
+    size_t slot, position, sample;
+    uint64_t seed;
+  };
+
+  DataLoaderOptions options;
+  std::vector<std::string> names;
+  // set when the samples are members of a single mapped archive
+  std::unique_ptr<MappedFile> archive;
+  std::vector<ArchiveMember> members;
+
+  size_t shape[3];
+  ptrdiff_t strides[3];
+  size_t sample_bytes = 0, per_epoch = 0;
+
+  std::mutex mutex;
+  std::condition_variable work, ready;
+  std::vector<Slot> slots;
+  // next batch to schedule and to hand to the caller, and the slot whose
+  // samples are being handed out to the workers
+  size_t scheduled = 0, delivered = 0, filling = NONE;
+  size_t consumer_epoch = 0, order_epoch = NONE;
+  std::vector<size_t> order;
+  std::exception_ptr error;
+  bool stopping = false;
+  std::vector<std::thread> workers;
+
+  void start();
+  template <typename Callback>
+  void with_source(size_t sample, const Callback &callback);
+  bool take_task(Task &task);
+  void decode_sample(const Task &task);
+  void work_loop();
+  void stop();
+  void release(size_t slot);
+};
+
+/**
+ * @brief Helper function. Calls \p callback(bytes, length) with the OTBV
+ * file of sample \p sample
+ */
+template <typename Callback>
+void DataLoaderState::with_source(size_t sample, const Callback &callback) {
+  if (archive) {
+    const ArchiveMember &member = members[sample];
+    callback(archive->data() + member.offset, member.size);
+    return;
+  }
+  const MappedFile file(names[sample]);
+  callback(file.data(), file.size());
+}
+
+void DataLoaderState::start() {
+  const size_t count = names.size();
+  if (0 == options.batch_size || 0 == options.prefetch) {
+    throw std::invalid_argument("Batch size and prefetch must be at least 1");
+  }
+  per_epoch = options.drop_last
+                  ? count / options.batch_size
+                  : (count + options.batch_size - 1) / options.batch_size;
+  if (0 == per_epoch) {
+    throw std::invalid_argument("Fewer samples than a batch holds");
+  }
+
+  std::tie(shape[0], shape[1], shape[2]) = options.sample_shape;
+  if (0 == shape[0] || 0 == shape[1] || 0 == shape[2]) {
+    with_source(0, [&](const char *bytes, size_t length) {
+      const Header header = parse_header(bytes, length);
+      const size_t first[3] = {header.x_res, header.y_res, header.z_res};
+      for (int a = 0; a < 3; a++) {
+        shape[a] = shape[a] ? shape[a] : first[a];
+      }
+    });
+  }
+  const size_t element_size =
+      BatchType::FLOAT32 == options.type ? sizeof(float) : sizeof(uint8_t);
+  contiguous_strides(shape, element_size, strides);
+  sample_bytes = shape[0] * static_cast<size_t>(strides[0]);
+
+  slots.resize(options.prefetch);
+  for (Slot &slot : slots) {
+    slot.data.reset(new uint8_t[options.batch_size * sample_bytes]);
+    slot.samples.reserve(options.batch_size);
+  }
+  const size_t threads = resolve_threads(options.threads);
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([this]() { work_loop(); });
+  }
+}
+
+/**
+ * @brief Hands out the next sample to decode, starting a new batch in a free
+ * slot when the current one is fully handed out. Called with the mutex held.
+ *
+ * @return false if there is nothing to do until a slot is released
+ */
+bool DataLoaderState::take_task(Task &task) {
+  if (NONE == filling) {
+    if (options.epochs && scheduled >= options.epochs * per_epoch) {
+      return false;
+    }
+    const auto free = std::find_if(slots.begin(), slots.end(), [](auto &slot) {
+      return Slot::FREE == slot.state;
+    });
+    if (slots.end() == free) {
+      return false;
+    }
+    const size_t epoch = scheduled / per_epoch,
+                 first = (scheduled % per_epoch) * options.batch_size;
+    if (epoch != order_epoch) {
+      order.resize(names.size());
+      std::iota(order.begin(), order.end(), size_t(0));
+      if (options.shuffle) {
+        std::mt19937_64 rng(mix_seed(options.seed ^ mix_seed(epoch)));
+        std::shuffle(order.begin(), order.end(), rng);
+      }
+      order_epoch = epoch;
+    }
+    const size_t count = std::min(options.batch_size, names.size() - first);
+    free->state = Slot::FILLING;
+    free->sequence = scheduled++;
+    free->assigned = 0;
+    free->remaining = count;
+    free->samples.assign(order.begin() + first, order.begin() + first + count);
+    filling = free - slots.begin();
+  }
+  Slot &slot = slots[filling];
+  const size_t position = slot.assigned++;
+  task = {filling, position, slot.samples[position],
+          mix_seed(options.seed ^ mix_seed(slot.sequence * options.batch_size +
+                                           position))};
+  if (slot.assigned == slot.samples.size()) {
+    filling = NONE;
+  }
+  return true;
+}
+
+/**
+ * @brief Decodes one sample into its place in the batch. Only occupied leaves
+ * within the crop are visited, and flips are negative strides.
+ */
+void DataLoaderState::decode_sample(const Task &task) {
+  uint8_t *out = slots[task.slot].data.get() + task.position * sample_bytes;
+  std::memset(out, 0, sample_bytes);
+  std::mt19937_64 rng(task.seed);
+
+  with_source(task.sample, [&](const char *bytes, size_t length) {
+    const Header header = parse_header(bytes, length);
+    require_single_channel(header);
+    const std::tuple<size_t, size_t, size_t> resolution = {
+        header.x_res, header.y_res, header.z_res};
+    const size_t res[3] = {header.x_res, header.y_res, header.z_res};
+
+    // volumes larger than the sample are cropped, smaller ones are placed at
+    // the origin and zero padded
+    size_t start[3], end[3];
+    ptrdiff_t sample_strides[3];
+    uint8_t *base = out;
+    for (int a = 0; a < 3; a++) {
+      start[a] = 0;
+      if (res[a] > shape[a]) {
+        const size_t slack = res[a] - shape[a];
+        start[a] = options.random_crop
+                       ? std::uniform_int_distribution<size_t>(0, slack)(rng)
+                       : slack / 2;
+      }
+      end[a] = start[a] + std::min(res[a], shape[a]);
+      sample_strides[a] = strides[a];
+      if (options.random_flip[a] && (rng() & 1)) {
+        base += (shape[a] - 1) * strides[a];
+        sample_strides[a] = -strides[a];
+      }
+    }
+
+    const PackedBits bits = data_bits(bytes + header.data_offset, header);
+    LeafCursor<PackedBits>(bits, root_node(resolution, header.anisotropic),
+                           {start[0], end[0], start[1], end[1], start[2],
+                            end[2]},
+                           LeafFilter::OCCUPIED)
+        .run([&](const Leaf &leaf) {
+          const Box box = {leaf.box.xs - start[0], leaf.box.xe - start[0],
+                           leaf.box.ys - start[1], leaf.box.ye - start[1],
+                           leaf.box.zs - start[2], leaf.box.ze - start[2]};
+          if (BatchType::FLOAT32 == options.type) {
+            fill_strided(base, sample_strides, box, 1.0f);
+          } else {
+            fill_strided(base, sample_strides, box, uint8_t(1));
+          }
+          return true;
+        });
+  });
+}
+
+void DataLoaderState::work_loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    Task task;
+    work.wait(lock, [&]() { return stopping || take_task(task); });
+    if (stopping) {
+      return;
+    }
+    lock.unlock();
+    try {
+      decode_sample(task);
+    } catch (...) {
+      lock.lock();
+      if (!error) {
+        error = std::current_exception();
+      }
+      ready.notify_all();
+      return;
+    }
+    lock.lock();
+    Slot &slot = slots[task.slot];
+    if (0 == --slot.remaining) {
+      slot.state = Slot::READY;
+      ready.notify_all();
+    }
+  }
+}
+
+void DataLoaderState::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  work.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  workers.clear();
+}
+
+void DataLoaderState::release(size_t slot) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    slots[slot].state = Slot::FREE;
+  }
+  work.notify_all();
+}
+
+Batch::Batch(Batch &&other) noexcept { *this = std::move(other); }
+
+Batch &Batch::operator=(Batch &&other) noexcept {
+  if (this != &other) {
+    release();
+    type = other.type;
+    shape = other.shape;
+    strides = other.strides;
+    epoch = other.epoch;
+    index = other.index;
+    samples = std::move(other.samples);
+    state = std::move(other.state);
+    slot = other.slot;
+    pointer = other.pointer;
+    other.pointer = nullptr;
+  }
+  return *this;
+}
+
+Batch::~Batch() { release(); }
+
+void Batch::release() {
+  if (state) {
+    state->release(slot);
+    state.reset();
+  }
+  pointer = nullptr;
+}
+
+DataLoader::DataLoader(const std::vector<std::string> &files,
+                       const DataLoaderOptions &options)
+    : state(std::make_shared<DataLoaderState>()) {
+  state->options = options;
+  state->names = files;
+  state->start();
+}
+
+DataLoader::DataLoader(const std::string &source,
+                       const DataLoaderOptions &options)
+    : state(std::make_shared<DataLoaderState>()) {
+  state->options = options;
+  const fs::path path(source);
+  if (fs::is_directory(path)) {
+    for (const auto &entry : fs::recursive_directory_iterator(path)) {
+      if (entry.is_regular_file() && ".otbv" == entry.path().extension()) {
+        state->names.push_back(entry.path().string());
+      }
+    }
+    std::sort(state->names.begin(), state->names.end());
+  } else if (".tar" == path.extension()) {
+    state->archive.reset(new MappedFile(source));
+    for (ArchiveMember &member :
+         list_tar_members(state->archive->data(), state->archive->size())) {
+      if (".otbv" == fs::path(member.name).extension()) {
+        state->names.push_back(member.name);
+        state->members.push_back(std::move(member));
+      }
+    }
+  } else {
+    std::ifstream list(source);
+    if (!list) {
+      throw std::runtime_error("Could not open " + source);
+    }
+    std::string line;
+    while (std::getline(list, line)) {
+      line.erase(line.find_last_not_of(" \t\r") + 1);
+      if (line.empty() || '#' == line[0]) {
+        continue;
+      }
+      const fs::path entry(line);
+      state->names.push_back(
+          (entry.is_absolute() ? entry : path.parent_path() / entry).string());
+    }
+  }
+  state->start();
+}
+
+DataLoader::~DataLoader() { state->stop(); }
+
+bool DataLoader::next(Batch &batch) {
+  // the previous batch goes back to the pool first, so that a single slot is
+  // enough to make progress
+  batch.release();
+  DataLoaderState &s = *state;
+  Batch fresh;
+  {
+    std::unique_lock<std::mutex> lock(s.mutex);
+    const size_t epoch = s.delivered / s.per_epoch;
+    if (s.options.epochs && epoch >= s.options.epochs) {
+      return false;
+    }
+    if (epoch != s.consumer_epoch) {
+      s.consumer_epoch = epoch;
+      return false;
+    }
+    const auto find_ready = [&]() {
+      return std::find_if(s.slots.begin(), s.slots.end(), [&](auto &slot) {
+        return DataLoaderState::Slot::READY == slot.state &&
+               s.delivered == slot.sequence;
+      });
+    };
+    auto slot = s.slots.end();
+    s.ready.wait(lock, [&]() {
+      return s.error || s.slots.end() != (slot = find_ready());
+    });
+    if (s.slots.end() == slot) {
+      std::rethrow_exception(s.error);
+    }
+    slot->state = DataLoaderState::Slot::HELD;
+    fresh.type = s.options.type;
+    fresh.shape = {slot->samples.size(), s.shape[0], s.shape[1], s.shape[2]};
+    fresh.strides = {static_cast<ptrdiff_t>(s.sample_bytes), s.strides[0],
+                     s.strides[1], s.strides[2]};
+    fresh.epoch = epoch;
+    fresh.index = s.delivered % s.per_epoch;
+    fresh.samples = slot->samples;
+    fresh.state = state;
+    fresh.slot = slot - s.slots.begin();
+    fresh.pointer = slot->data.get();
+    s.delivered++;
+  }
+  batch = std::move(fresh);
+  return true;
+}
+
+const std::vector<std::string> &DataLoader::sources() const {
+  return state->names;
+}
+
+size_t DataLoader::batches_per_epoch() const { return state->per_epoch; }
+
+} // namespace otbv
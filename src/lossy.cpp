@@ -0,0 +1,167 @@
+#include "../include/otbv.h"
+#include "conversion.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+namespace {
+/**
+ * @brief Occupied voxels of a split node, and the extent of its subtree
+ */
+struct SplitCount {
+  size_t occupied, inside, depth;
+  // index past the last token, and number of split nodes, itself included
+  size_t end, splits;
+
+  size_t minority() const { return std::min(occupied, inside - occupied); }
+};
+
+struct Simplifier {
+  const std::vector<bool> &encoding;
+  size_t x_res, y_res, z_res;
+  const LossyOptions &options;
+  // split nodes in file order, and whether they become leaves
+  std::vector<SplitCount> counts = {};
+  std::vector<bool> collapsed = {};
+  std::vector<bool> out = {};
+  size_t error = 0;
+
+  void count(size_t side);
+  void choose();
+  void simplify(size_t side);
+};
+} // namespace
+
+/**
+ * @brief Helper function. Records the split nodes of the tree of side \p
+ * side, with their occupied voxels
+ */
+void Simplifier::count(size_t side) {
+  // the split node open at every level, and the occupied voxels of its
+  // children so far
+  std::array<size_t, RECURSION_MAX_DEPTH + 1> open;
+  std::array<size_t, RECURSION_MAX_DEPTH + 2> occupied;
+  occupied[0] = 0;
+  size_t idx = 0;
+  NodeWalk(side).run(
+      [&](const NodeKey &key, const Box &node) {
+        if (idx + 1 >= encoding.size()) {
+          throw std::out_of_range("Unexpected end of the encoding");
+        }
+        const size_t inside = volume(clip(node, x_res, y_res, z_res));
+        if (!encoding[idx]) {
+          occupied[key.depth] += encoding[idx + 1] ? inside : 0;
+          idx += 2;
+          return Step::NEXT;
+        }
+        open[key.depth] = counts.size();
+        counts.push_back({0, inside, key.depth, 0, 0});
+        occupied[key.depth + 1] = 0;
+        idx++;
+        return Step::DESCEND;
+      },
+      [&](const NodeKey &key) {
+        SplitCount &counted = counts[open[key.depth]];
+        counted.occupied = occupied[key.depth + 1];
+        counted.end = idx;
+        counted.splits = counts.size() - open[key.depth];
+        occupied[key.depth] += counted.occupied;
+      });
+}
+
+/**
+ * @brief Helper function. Marks the split nodes that become leaves: those
+ * within the minority fraction, then those that fit in the error budget,
+ * larger nodes first
+ */
+void Simplifier::choose() {
+  collapsed.assign(counts.size(), false);
+  std::vector<size_t> candidates;
+  for (size_t split = 0; split < counts.size();) {
+    const SplitCount &counted = counts[split];
+    if (counted.minority() <= options.max_minority_fraction * counted.inside) {
+      collapsed[split] = true;
+      split += counted.splits;
+    } else {
+      candidates.push_back(split);
+      split++;
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [&](size_t a, size_t b) {
+                     return counts[a].depth < counts[b].depth;
+                   });
+  // ancestors come first, so a collapsed node hides its whole subtree
+  std::vector<bool> hidden(counts.size(), false);
+  size_t budget = options.error_budget;
+  for (const size_t split : candidates) {
+    const SplitCount &counted = counts[split];
+    if (hidden[split] || counted.minority() > budget) {
+      continue;
+    }
+    budget -= counted.minority();
+    collapsed[split] = true;
+    std::fill(hidden.begin() + split + 1,
+              hidden.begin() + split + counted.splits, true);
+  }
+}
+
+/**
+ * @brief Helper function. Appends the tree of side \p side to \p out, with
+ * the split nodes chosen to collapse turned into leaves
+ */
+void Simplifier::simplify(size_t side) {
+  size_t idx = 0, split = 0;
+  NodeWalk(side).run([&](const NodeKey &, const Box &) {
+    if (!encoding[idx]) {
+      out.push_back(0);
+      out.push_back(encoding[idx + 1]);
+      idx += 2;
+      return Step::NEXT;
+    }
+    const SplitCount &counted = counts[split];
+    if (collapsed[split]) {
+      error += counted.minority();
+      out.push_back(0);
+      out.push_back(counted.inside && 2 * counted.occupied > counted.inside);
+      idx = counted.end;
+      split += counted.splits;
+      return Step::NEXT;
+    }
+    out.push_back(1);
+    idx++;
+    split++;
+    return Step::DESCEND;
+  });
+}
+
+LossyEncoding simplify(const std::vector<bool> &encoding,
+                       const std::tuple<size_t, size_t, size_t> &resolution,
+                       const LossyOptions &options) {
+  check_resolution(resolution);
+  if (!(options.max_minority_fraction >= 0 &&
+        options.max_minority_fraction < 0.5)) {
+    throw std::invalid_argument(
+        "The minority fraction must lie in [0, 0.5)");
+  }
+  Simplifier simplifier{encoding,
+                        std::get<0>(resolution),
+                        std::get<1>(resolution),
+                        std::get<2>(resolution),
+                        options};
+  const size_t side = max_res_pow2_roof(resolution);
+  simplifier.count(side);
+  simplifier.choose();
+  simplifier.simplify(side);
+  // collapsed children may leave their parents uniform
+  return {canonicalize(simplifier.out, resolution), simplifier.error};
+}
+
+} // namespace otbv
@@ -0,0 +1,80 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace otbv {
+
+/**
+ * @brief Helper function. Closes \p fd and throws the current errno
+ */
+[[noreturn]] static void fail(int fd, const std::string &what) {
+  const int error = errno;
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  throw std::system_error(error, std::generic_category(), what);
+}
+
+MappedFile::MappedFile(const std::string &filename) {
+  const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    fail(fd, "Could not open " + filename);
+  }
+  struct stat st;
+  if (::fstat(fd, &st)) {
+    fail(fd, "Could not stat " + filename);
+  }
+  length = static_cast<size_t>(st.st_size);
+  if (length) {
+    void *mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == mapped) {
+      fail(fd, "Could not map " + filename);
+    }
+    bytes = static_cast<const char *>(mapped);
+  }
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (bytes) {
+    ::munmap(const_cast<char *>(bytes), length);
+  }
+}
+
+MappedOutput::MappedOutput(const std::string &filename, size_t size)
+    : length(size) {
+  const int fd =
+      ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    fail(fd, "Could not create " + filename);
+  }
+  if (::ftruncate(fd, static_cast<off_t>(length))) {
+    fail(fd, "Could not resize " + filename);
+  }
+  if (length) {
+    void *mapped =
+        ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == mapped) {
+      fail(fd, "Could not map " + filename);
+    }
+    bytes = static_cast<uint8_t *>(mapped);
+  }
+  ::close(fd);
+}
+
+MappedOutput::~MappedOutput() {
+  if (bytes) {
+    ::munmap(bytes, length);
+  }
+}
+
+} // namespace otbv
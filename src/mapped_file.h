@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace otbv {
+
+/**
+ * @brief Read-only memory mapping of a whole file
+ */
+class MappedFile {
+public:
+  /**
+   * @throws std::system_error If the file cannot be opened or mapped
+   */
+  explicit MappedFile(const std::string &filename);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data() const { return bytes; }
+  size_t size() const { return length; }
+
+private:
+  const char *bytes = nullptr;
+  size_t length = 0;
+};
+
+/**
+ * @brief Writable memory mapping of a file created, or truncated, to \p size
+ * zero bytes. Pages that are never written stay holes in the file.
+ */
+class MappedOutput {
+public:
+  /**
+   * @throws std::system_error If the file cannot be created or mapped
+   */
+  MappedOutput(const std::string &filename, size_t size);
+  ~MappedOutput();
+
+  MappedOutput(const MappedOutput &) = delete;
+  MappedOutput &operator=(const MappedOutput &) = delete;
+
+  uint8_t *data() { return bytes; }
+  size_t size() const { return length; }
+
+private:
+  uint8_t *bytes = nullptr;
+  size_t length = 0;
+};
+
+} // namespace otbv
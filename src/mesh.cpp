@@ -0,0 +1,308 @@
+#include "mesh.h"
+#include "conversion.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+// leaves hold up to this many triangles
+static constexpr size_t BVH_LEAF_SIZE = 4;
+static constexpr size_t BVH_STACK_SIZE = 64;
+// skewed so that rays from voxel centres do not graze axis-aligned edges
+static constexpr vec3 RAY_DIRECTION = {1.0, 0.0123456789, 0.00712345678};
+
+static vec3 sub(const vec3 &a, const vec3 &b) {
+  return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+}
+
+static vec3 cross(const vec3 &a, const vec3 &b) {
+  return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2],
+          a[0] * b[1] - a[1] * b[0]};
+}
+
+static double dot(const vec3 &a, const vec3 &b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static bool boxes_overlap(const vec3 &a_lo, const vec3 &a_hi,
+                          const vec3 &b_lo, const vec3 &b_hi) {
+  for (int i = 0; i < 3; i++) {
+    if (a_lo[i] > b_hi[i] || a_hi[i] < b_lo[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint32_t build_bvh_node(TriangleBvh &bvh,
+                               const std::vector<std::array<vec3, 3>> &tris,
+                               const std::vector<vec3> &centroids,
+                               std::vector<uint32_t> &order, size_t begin,
+                               size_t end) {
+  const uint32_t idx = static_cast<uint32_t>(bvh.nodes.size());
+  bvh.nodes.push_back({});
+  vec3 lo, hi, c_lo, c_hi;
+  lo.fill(std::numeric_limits<double>::max());
+  hi.fill(std::numeric_limits<double>::lowest());
+  c_lo = lo;
+  c_hi = hi;
+  for (size_t i = begin; i < end; i++) {
+    for (const vec3 &vertex : tris[order[i]]) {
+      for (int a = 0; a < 3; a++) {
+        lo[a] = std::min(lo[a], vertex[a]);
+        hi[a] = std::max(hi[a], vertex[a]);
+      }
+    }
+    for (int a = 0; a < 3; a++) {
+      c_lo[a] = std::min(c_lo[a], centroids[order[i]][a]);
+      c_hi[a] = std::max(c_hi[a], centroids[order[i]][a]);
+    }
+  }
+  bvh.nodes[idx].lo = lo;
+  bvh.nodes[idx].hi = hi;
+  if (end - begin <= BVH_LEAF_SIZE) {
+    bvh.nodes[idx].first = static_cast<uint32_t>(begin);
+    bvh.nodes[idx].count = static_cast<uint32_t>(end - begin);
+    return idx;
+  }
+
+  int axis = 0;
+  for (int a = 1; a < 3; a++) {
+    if (c_hi[a] - c_lo[a] > c_hi[axis] - c_lo[axis]) {
+      axis = a;
+    }
+  }
+  const size_t mid = (begin + end) / 2;
+  std::nth_element(order.begin() + begin, order.begin() + mid,
+                   order.begin() + end, [&](uint32_t a, uint32_t b) {
+                     return centroids[a][axis] < centroids[b][axis];
+                   });
+  build_bvh_node(bvh, tris, centroids, order, begin, mid);
+  const uint32_t right = build_bvh_node(bvh, tris, centroids, order, mid, end);
+  bvh.nodes[idx].first = right;
+  bvh.nodes[idx].count = 0;
+  return idx;
+}
+
+TriangleBvh build_bvh(const TriangleMesh &mesh) {
+  std::vector<std::array<vec3, 3>> tris;
+  std::vector<vec3> centroids;
+  tris.reserve(mesh.triangles.size());
+  centroids.reserve(mesh.triangles.size());
+  for (const auto &triangle : mesh.triangles) {
+    std::array<vec3, 3> tri;
+    for (int i = 0; i < 3; i++) {
+      if (triangle[i] >= mesh.vertices.size()) {
+        throw std::invalid_argument(
+            "Mesh triangle references a vertex that does not exist");
+      }
+      tri[i] = mesh.vertices[triangle[i]];
+    }
+    tris.push_back(tri);
+    centroids.push_back({(tri[0][0] + tri[1][0] + tri[2][0]) / 3,
+                         (tri[0][1] + tri[1][1] + tri[2][1]) / 3,
+                         (tri[0][2] + tri[1][2] + tri[2][2]) / 3});
+  }
+
+  TriangleBvh bvh;
+  if (tris.empty()) {
+    return bvh;
+  }
+  std::vector<uint32_t> order(tris.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = static_cast<uint32_t>(i);
+  }
+  bvh.nodes.reserve(2 * tris.size() / BVH_LEAF_SIZE + 1);
+  build_bvh_node(bvh, tris, centroids, order, 0, tris.size());
+  bvh.triangles.reserve(tris.size());
+  for (uint32_t i : order) {
+    bvh.triangles.push_back(tris[i]);
+  }
+  return bvh;
+}
+
+bool triangle_box_overlap(const std::array<vec3, 3> &triangle, const vec3 &lo,
+                          const vec3 &hi) {
+  vec3 centre, half;
+  for (int a = 0; a < 3; a++) {
+    centre[a] = (lo[a] + hi[a]) / 2;
+    half[a] = (hi[a] - lo[a]) / 2;
+  }
+  const std::array<vec3, 3> v = {sub(triangle[0], centre),
+                                 sub(triangle[1], centre),
+                                 sub(triangle[2], centre)};
+  const std::array<vec3, 3> edges = {sub(v[1], v[0]), sub(v[2], v[1]),
+                                     sub(v[0], v[2])};
+
+  // cross products of the box axes and the triangle edges
+  for (int a = 0; a < 3; a++) {
+    vec3 box_axis = {0, 0, 0};
+    box_axis[a] = 1;
+    for (const vec3 &edge : edges) {
+      const vec3 axis = cross(box_axis, edge);
+      const double p0 = dot(v[0], axis), p1 = dot(v[1], axis),
+                   p2 = dot(v[2], axis);
+      const double r = half[0] * std::abs(axis[0]) +
+                       half[1] * std::abs(axis[1]) +
+                       half[2] * std::abs(axis[2]);
+      if (std::min({p0, p1, p2}) > r || std::max({p0, p1, p2}) < -r) {
+        return false;
+      }
+    }
+  }
+  // box face normals
+  for (int a = 0; a < 3; a++) {
+    if (std::min({v[0][a], v[1][a], v[2][a]}) > half[a] ||
+        std::max({v[0][a], v[1][a], v[2][a]}) < -half[a]) {
+      return false;
+    }
+  }
+  // triangle plane
+  const vec3 normal = cross(edges[0], edges[1]);
+  const double r = half[0] * std::abs(normal[0]) +
+                   half[1] * std::abs(normal[1]) +
+                   half[2] * std::abs(normal[2]);
+  return std::abs(dot(normal, v[0])) <= r;
+}
+
+bool bvh_overlaps_box(const TriangleBvh &bvh, const vec3 &lo, const vec3 &hi) {
+  if (bvh.nodes.empty()) {
+    return false;
+  }
+  std::array<uint32_t, BVH_STACK_SIZE> stack;
+  size_t top = 0;
+  stack[top++] = 0;
+  while (top) {
+    const BvhNode &node = bvh.nodes[stack[--top]];
+    if (!boxes_overlap(node.lo, node.hi, lo, hi)) {
+      continue;
+    }
+    if (node.count) {
+      for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        if (triangle_box_overlap(bvh.triangles[i], lo, hi)) {
+          return true;
+        }
+      }
+      continue;
+    }
+    const uint32_t idx = static_cast<uint32_t>(&node - bvh.nodes.data());
+    stack[top++] = node.first;
+    stack[top++] = idx + 1;
+  }
+  return false;
+}
+
+static bool ray_hits_box(const vec3 &point, const vec3 &inverse,
+                         const vec3 &lo, const vec3 &hi) {
+  double t_min = 0, t_max = std::numeric_limits<double>::max();
+  for (int a = 0; a < 3; a++) {
+    double t1 = (lo[a] - point[a]) * inverse[a];
+    double t2 = (hi[a] - point[a]) * inverse[a];
+    t_min = std::max(t_min, std::min(t1, t2));
+    t_max = std::min(t_max, std::max(t1, t2));
+  }
+  return t_max >= t_min;
+}
+
+int bvh_ray_crossings(const TriangleBvh &bvh, const vec3 &point,
+                      const InsideRule rule) {
+  if (bvh.nodes.empty()) {
+    return 0;
+  }
+  const vec3 &dir = RAY_DIRECTION;
+  const vec3 inverse = {1 / dir[0], 1 / dir[1], 1 / dir[2]};
+  int crossings = 0;
+  std::array<uint32_t, BVH_STACK_SIZE> stack;
+  size_t top = 0;
+  stack[top++] = 0;
+  while (top) {
+    const uint32_t idx = stack[--top];
+    const BvhNode &node = bvh.nodes[idx];
+    if (!ray_hits_box(point, inverse, node.lo, node.hi)) {
+      continue;
+    }
+    if (!node.count) {
+      stack[top++] = node.first;
+      stack[top++] = idx + 1;
+      continue;
+    }
+    // Möller-Trumbore
+    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+      const auto &tri = bvh.triangles[i];
+      const vec3 e1 = sub(tri[1], tri[0]), e2 = sub(tri[2], tri[0]);
+      const vec3 p = cross(dir, e2);
+      const double det = dot(e1, p);
+      if (std::abs(det) < 1e-300) {
+        continue;
+      }
+      const vec3 t = sub(point, tri[0]);
+      const double u = dot(t, p) / det;
+      if (u < 0 || u > 1) {
+        continue;
+      }
+      const vec3 q = cross(t, e1);
+      const double v = dot(dir, q) / det;
+      if (v < 0 || u + v > 1 || dot(e2, q) / det <= 0) {
+        continue;
+      }
+      if (InsideRule::PARITY == rule) {
+        crossings++;
+      } else {
+        // a negative determinant means the ray leaves through the front face
+        crossings += det < 0 ? 1 : -1;
+      }
+    }
+  }
+  return crossings;
+}
+
+bool is_inside(const TriangleBvh &bvh, const vec3 &point,
+               const InsideRule rule) {
+  const int crossings = bvh_ray_crossings(bvh, point, rule);
+  return InsideRule::PARITY == rule ? crossings & 1 : crossings != 0;
+}
+
+std::vector<bool>
+voxelize_mesh(const TriangleMesh &mesh,
+              const std::tuple<size_t, size_t, size_t> &resolution,
+              const std::array<double, 3> &origin, double voxel_size,
+              InsideRule rule, size_t threads) {
+  if (!(voxel_size > 0)) {
+    throw std::invalid_argument("Voxel size must be positive");
+  }
+  const TriangleBvh bvh = build_bvh(mesh);
+  threads = resolve_threads(threads);
+
+  auto classify = [&](const Box &box) {
+    const vec3 lo = {origin[0] + box.xs * voxel_size,
+                     origin[1] + box.ys * voxel_size,
+                     origin[2] + box.zs * voxel_size};
+    const vec3 hi = {origin[0] + box.xe * voxel_size,
+                     origin[1] + box.ye * voxel_size,
+                     origin[2] + box.ze * voxel_size};
+    if (bvh.nodes.empty() ||
+        !boxes_overlap(bvh.nodes[0].lo, bvh.nodes[0].hi, lo, hi)) {
+      return Occupancy::EMPTY;
+    }
+    if (bvh_overlaps_box(bvh, lo, hi)) {
+      // surface voxels are occupied
+      return 1 == volume(box) ? Occupancy::FULL : Occupancy::MIXED;
+    }
+    // nothing crosses the box, so its centre decides for all of it
+    const vec3 centre = {(lo[0] + hi[0]) / 2, (lo[1] + hi[1]) / 2,
+                         (lo[2] + hi[2]) / 2};
+    return is_inside(bvh, centre, rule) ? Occupancy::FULL : Occupancy::EMPTY;
+  };
+  return encode_from_oracle(resolution, classify, nullptr, threads);
+}
+
+} // namespace otbv
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../include/otbv.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace otbv {
+
+using vec3 = std::array<double, 3>;
+
+/**
+ * @brief Node of a \ref TriangleBvh. Leaves have a non-zero \p count and
+ * reference triangles [first, first + count). Internal nodes have a \p count
+ * of 0, their left child directly follows them and \p first is the index of
+ * the right child.
+ */
+struct BvhNode {
+  vec3 lo, hi;
+  uint32_t first, count;
+};
+
+/**
+ * @brief Bounding volume hierarchy over the triangles of a mesh. Triangles are
+ * stored by value, in the order referenced by the leaves.
+ */
+struct TriangleBvh {
+  std::vector<BvhNode> nodes;
+  std::vector<std::array<vec3, 3>> triangles;
+};
+
+/**
+ * @brief Builds a \ref TriangleBvh over \p mesh, splitting nodes at the median
+ * centroid along their longest axis
+ *
+ * @throws std::invalid_argument If a triangle references a missing vertex
+ */
+TriangleBvh build_bvh(const TriangleMesh &mesh);
+
+/**
+ * @brief Checks if the triangle \p triangle overlaps the box [lo, hi], using
+ * the separating axis test by Akenine-Möller
+ */
+bool triangle_box_overlap(const std::array<vec3, 3> &triangle, const vec3 &lo,
+                          const vec3 &hi);
+
+/**
+ * @brief Checks if any triangle in \p bvh overlaps the box [lo, hi]
+ */
+bool bvh_overlaps_box(const TriangleBvh &bvh, const vec3 &lo, const vec3 &hi);
+
+/**
+ * @brief Casts a ray from \p point and returns the number of triangles it
+ * crosses for \p InsideRule::PARITY, or the sum of crossing orientations for
+ * \p InsideRule::WINDING
+ */
+int bvh_ray_crossings(const TriangleBvh &bvh, const vec3 &point,
+                      const InsideRule rule);
+
+/**
+ * @brief Checks if \p point is inside the mesh indexed by \p bvh
+ */
+bool is_inside(const TriangleBvh &bvh, const vec3 &point,
+               const InsideRule rule);
+
+} // namespace otbv
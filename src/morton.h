@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace otbv {
+
+/**
+ * @brief Spreads the lower 21 bits of \p v so that there are two zero bits
+ * between each of them
+ */
+inline uint64_t morton_spread(uint64_t v) {
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x001f00000000ffffull;
+  v = (v | v << 16) & 0x001f0000ff0000ffull;
+  v = (v | v << 8) & 0x100f00f00f00f00full;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+  v = (v | v << 2) & 0x1249249249249249ull;
+  return v;
+}
+
+/**
+ * @brief Inverse of \ref morton_spread
+ */
+inline uint64_t morton_compact(uint64_t v) {
+  v &= 0x1249249249249249ull;
+  v = (v ^ (v >> 2)) & 0x10c30c30c30c30c3ull;
+  v = (v ^ (v >> 4)) & 0x100f00f00f00f00full;
+  v = (v ^ (v >> 8)) & 0x001f0000ff0000ffull;
+  v = (v ^ (v >> 16)) & 0x001f00000000ffffull;
+  v = (v ^ (v >> 32)) & 0x1fffff;
+  return v;
+}
+
+/**
+ * @brief Interleaves \p x, \p y and \p z into a Morton code. x takes the most
+ * significant bit of every triple, so sorting codes yields the order in which
+ * the octree encoding visits voxels.
+ */
+inline uint64_t morton_encode(size_t x, size_t y, size_t z) {
+  return morton_spread(x) << 2 | morton_spread(y) << 1 | morton_spread(z);
+}
+
+/**
+ * @brief Splits the Morton code \p code back into \p x, \p y and \p z
+ */
+inline void morton_decode(uint64_t code, size_t &x, size_t &y, size_t &z) {
+  x = morton_compact(code >> 2);
+  y = morton_compact(code >> 1);
+  z = morton_compact(code);
+}
+
+} // namespace otbv
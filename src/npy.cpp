@@ -0,0 +1,435 @@
+#include "npy.h"
+#include "conversion.h"
+#include "sparse.h"
+#include "strided.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace otbv {
+
+static constexpr char NPY_MAGIC[] = "\x93NUMPY";
+
+/**
+ * @brief Helper function. Returns the index of the value of \p key in the
+ * header dictionary \p dict
+ */
+static size_t npy_value(const std::string &dict, const std::string &key) {
+  for (const char quote : {'\'', '"'}) {
+    const size_t found = dict.find(quote + key + quote);
+    if (std::string::npos == found) {
+      continue;
+    }
+    const size_t colon = dict.find(':', found + key.size() + 2);
+    const size_t value = dict.find_first_not_of(' ', colon + 1);
+    if (std::string::npos != colon && std::string::npos != value) {
+      return value;
+    }
+  }
+  throw std::runtime_error("Malformed .npy header: missing " + key + ".");
+}
+
+NpyHeader read_npy_header(std::istream &in) {
+  char preamble[8];
+  if (!in.read(preamble, sizeof(preamble)) ||
+      std::memcmp(preamble, NPY_MAGIC, 6)) {
+    throw std::runtime_error("Not a .npy file.");
+  }
+  size_t header_length = 0;
+  const uint8_t major = static_cast<uint8_t>(preamble[6]);
+  uint8_t length_bytes[4] = {};
+  const size_t length_size = 1 == major ? 2 : 4;
+  if (major < 1 || major > 3 ||
+      !in.read(reinterpret_cast<char *>(length_bytes), length_size)) {
+    throw std::runtime_error("Unsupported .npy version.");
+  }
+  for (size_t i = 0; i < length_size; i++) {
+    header_length |= static_cast<size_t>(length_bytes[i]) << (8 * i);
+  }
+  std::string dict(header_length, '\0');
+  if (!in.read(&dict[0], header_length)) {
+    throw std::runtime_error("The .npy header is truncated.");
+  }
+
+  NpyHeader header;
+  const size_t descr = npy_value(dict, "descr");
+  const size_t descr_end = dict.find(dict[descr], descr + 1);
+  if (std::string::npos == descr_end) {
+    throw std::runtime_error("Malformed .npy header: bad descr.");
+  }
+  header.descr = dict.substr(descr + 1, descr_end - descr - 1);
+
+  const size_t order = npy_value(dict, "fortran_order");
+  header.fortran_order = 0 == dict.compare(order, 4, "True");
+  if (!header.fortran_order && dict.compare(order, 5, "False")) {
+    throw std::runtime_error("Malformed .npy header: bad fortran_order.");
+  }
+
+  const size_t shape = npy_value(dict, "shape");
+  const size_t shape_end = dict.find(')', shape);
+  if ('(' != dict[shape] || std::string::npos == shape_end) {
+    throw std::runtime_error("Malformed .npy header: bad shape.");
+  }
+  size_t first = shape + 1;
+  while (first < shape_end) {
+    const size_t last = std::min(dict.find(',', first), shape_end);
+    const size_t digits = dict.find_first_not_of(' ', first);
+    if (digits < last) {
+      size_t dimension = 0, i = digits;
+      for (; i < last && dict[i] >= '0' && dict[i] <= '9'; i++) {
+        dimension = dimension * 10 + (dict[i] - '0');
+      }
+      if (i == digits || dict.find_first_not_of(' ', i) < last) {
+        throw std::runtime_error("Malformed .npy header: bad shape.");
+      }
+      header.shape.push_back(dimension);
+    }
+    first = last + 1;
+  }
+  return header;
+}
+
+void write_npy_header(std::ostream &out, const NpyHeader &header) {
+  std::string dict = "{'descr': '" + header.descr + "', 'fortran_order': " +
+                     (header.fortran_order ? "True" : "False") +
+                     ", 'shape': (";
+  for (size_t i = 0; i < header.shape.size(); i++) {
+    dict += (i ? ", " : "") + std::to_string(header.shape[i]);
+  }
+  dict += 1 == header.shape.size() ? ",), }" : "), }";
+  // the array starts on a 64 byte boundary
+  const size_t preamble = 10, unpadded = preamble + dict.size() + 1;
+  dict.append((64 - unpadded % 64) % 64, ' ');
+  dict += '\n';
+
+  const uint16_t length = static_cast<uint16_t>(dict.size());
+  const char version[2] = {1, 0};
+  const char length_bytes[2] = {static_cast<char>(length & 0xff),
+                                static_cast<char>(length >> 8)};
+  out.write(NPY_MAGIC, 6);
+  out.write(version, 2);
+  out.write(length_bytes, 2);
+  out.write(dict.data(), dict.size());
+}
+
+NpyRowReader::NpyRowReader(std::istream &in, size_t row_length, size_t rows,
+                           bool packed)
+    : in(in), row_length(row_length), rows_left(rows),
+      bytes_left(packed ? (row_length * rows + 7) / 8 : row_length * rows),
+      packed(packed) {
+  if (packed) {
+    buffer.resize(NPY_CHUNK_BYTES);
+    row.resize(row_length);
+  } else {
+    // whole rows only
+    buffer.resize(std::max<size_t>(1, NPY_CHUNK_BYTES / row_length) *
+                  row_length);
+  }
+}
+
+void NpyRowReader::refill() {
+  const size_t count = std::min(buffer.size(), bytes_left);
+  if (0 == count ||
+      !in.read(reinterpret_cast<char *>(buffer.data()), count)) {
+    throw std::runtime_error(
+        "The .npy file is shorter than its header declares.");
+  }
+  bytes_left -= count;
+  filled = count;
+  position = 0;
+}
+
+const uint8_t *NpyRowReader::next() {
+  if (0 == rows_left) {
+    throw std::out_of_range("Read past the last row of the .npy array");
+  }
+  rows_left--;
+  if (!packed) {
+    if (position == filled) {
+      refill();
+    }
+    const uint8_t *out = buffer.data() + position;
+    position += row_length;
+    return out;
+  }
+
+  for (size_t i = 0; i < row_length;) {
+    if (8 == bit) {
+      position++;
+      bit = 0;
+    }
+    if (position == filled) {
+      refill();
+    }
+    const uint8_t byte = buffer[position];
+    if (0 == bit && i + 8 <= row_length) {
+      for (int j = 0; j < 8; j++) {
+        row[i++] = (byte >> (7 - j)) & 1;
+      }
+      bit = 8;
+      continue;
+    }
+    row[i++] = (byte >> (7 - bit)) & 1;
+    bit++;
+  }
+  return row.data();
+}
+
+/**
+ * @brief Helper function. Encodes the rows of \p reader, a volume of shape \p
+ * resolution in C or Fortran order, merging its runs into boxes on the way
+ */
+static std::vector<bool>
+encode_npy_rows(NpyRowReader &reader,
+                const std::tuple<size_t, size_t, size_t> &resolution,
+                bool fortran_order) {
+  // rows run along the fastest axis, z in C order and x in Fortran order, so
+  // Fortran volumes are merged transposed
+  const size_t planes =
+      fortran_order ? std::get<2>(resolution) : std::get<0>(resolution);
+  const size_t row_length =
+      fortran_order ? std::get<0>(resolution) : std::get<2>(resolution);
+  const auto occupied = [](uint8_t value) { return 0 != value; };
+  BoxBuilder builder;
+  for (size_t p = 0; p < planes; p++) {
+    for (size_t y = 0; y < std::get<1>(resolution); y++) {
+      const uint8_t *row = reader.next(), *end = row + row_length;
+      const uint8_t *first = std::find_if(row, end, occupied);
+      while (first != end) {
+        const uint8_t *last = std::find(first, end, uint8_t(0));
+        builder.add_run(p, y, first - row, last - row);
+        first = std::find_if(last, end, occupied);
+      }
+    }
+  }
+  std::vector<Box> boxes = builder.finish();
+  if (fortran_order) {
+    for (Box &box : boxes) {
+      std::swap(box.xs, box.zs);
+      std::swap(box.xe, box.ze);
+    }
+  }
+  return encode_from_boxes(std::move(boxes), resolution);
+}
+
+std::vector<bool> encode_npy(const std::string &filename,
+                             std::tuple<size_t, size_t, size_t> &resolution) {
+  std::ifstream file_in(filename, std::ios::binary);
+  if (!file_in) {
+    throw std::runtime_error("Could not open file for reading.");
+  }
+  const NpyHeader header = read_npy_header(file_in);
+  if ("|b1" != header.descr && "|u1" != header.descr) {
+    throw std::runtime_error("Only bool and uint8 .npy arrays are supported.");
+  }
+  if (3 != header.shape.size()) {
+    throw std::runtime_error("The .npy array is not 3-dimensional.");
+  }
+  resolution = {header.shape[0], header.shape[1], header.shape[2]};
+  check_resolution(resolution);
+  const size_t row_length =
+      header.fortran_order ? header.shape[0] : header.shape[2];
+  NpyRowReader reader(file_in, row_length,
+                      header.shape[0] * header.shape[1] * header.shape[2] /
+                          row_length,
+                      false);
+  return encode_npy_rows(reader, resolution, header.fortran_order);
+}
+
+std::vector<bool>
+encode_npy_packbits(const std::string &filename,
+                    const std::tuple<size_t, size_t, size_t> &resolution,
+                    bool fortran_order) {
+  check_resolution(resolution);
+  std::ifstream file_in(filename, std::ios::binary);
+  if (!file_in) {
+    throw std::runtime_error("Could not open file for reading.");
+  }
+  const NpyHeader header = read_npy_header(file_in);
+  const size_t voxels = std::get<0>(resolution) * std::get<1>(resolution) *
+                        std::get<2>(resolution);
+  if ("|u1" != header.descr || 1 != header.shape.size() ||
+      (voxels + 7) / 8 != header.shape[0]) {
+    throw std::runtime_error(
+        "The .npy array does not hold a packed volume of this shape.");
+  }
+  const size_t row_length =
+      fortran_order ? std::get<0>(resolution) : std::get<2>(resolution);
+  NpyRowReader reader(file_in, row_length, voxels / row_length, true);
+  return encode_npy_rows(reader, resolution, fortran_order);
+}
+
+namespace {
+/**
+ * @brief Index past the end of a split node, and the number of indexed split
+ * nodes in its subtree, itself included
+ */
+struct SplitExtent {
+  size_t end, splits;
+};
+} // namespace
+
+/**
+ * @brief Helper function. Returns the extents of the split nodes above depth
+ * \p index_depth of \p encoding, a tree of side \p side, in file order
+ *
+ * @throws std::out_of_range If the encoding ends early
+ */
+static std::vector<SplitExtent> index_splits(const std::vector<bool> &encoding,
+                                             const size_t side,
+                                             const size_t index_depth) {
+  std::vector<SplitExtent> extents;
+  // the indexed split node open at every level
+  std::array<size_t, RECURSION_MAX_DEPTH + 1> open;
+  size_t idx = 0;
+  NodeWalk(side).run(
+      [&](const NodeKey &key, const Box &) {
+        if (idx >= encoding.size()) {
+          throw std::out_of_range("Unexpected end of the encoding");
+        }
+        if (!encoding[idx]) {
+          if (idx + 1 >= encoding.size()) {
+            throw std::out_of_range("Unexpected end of the encoding");
+          }
+          idx += 2;
+          return Step::NEXT;
+        }
+        if (key.depth >= index_depth) {
+          idx = skip_node(encoding, idx);
+          return Step::NEXT;
+        }
+        open[key.depth] = extents.size();
+        extents.push_back({0, 0});
+        idx++;
+        return Step::DESCEND;
+      },
+      [&](const NodeKey &key) {
+        SplitExtent &extent = extents[open[key.depth]];
+        extent.end = idx;
+        extent.splits = extents.size() - open[key.depth];
+      });
+  return extents;
+}
+
+void decode_to_npy(const std::string &filename,
+                   const std::vector<bool> &encoding,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   NpyLayout layout, bool fortran_order) {
+  check_resolution(resolution);
+  std::ofstream file_out(filename, std::ios::binary);
+  if (!file_out) {
+    throw std::runtime_error("Could not open file for writing.");
+  }
+  const size_t dims[3] = {std::get<0>(resolution), std::get<1>(resolution),
+                          std::get<2>(resolution)};
+  const size_t voxels = dims[0] * dims[1] * dims[2];
+  NpyHeader header;
+  header.descr = NpyLayout::BOOL == layout ? "|b1" : "|u1";
+  if (NpyLayout::PACKBITS == layout) {
+    header.fortran_order = false;
+    header.shape = {(voxels + 7) / 8};
+  } else {
+    header.fortran_order = fortran_order;
+    header.shape = {dims[0], dims[1], dims[2]};
+  }
+  write_npy_header(file_out, header);
+
+  // slabs are cut along the slowest axis, x in C order and z in Fortran order
+  const size_t slow = fortran_order ? 2 : 0;
+  const size_t plane = voxels / dims[slow];
+  const size_t thickness =
+      std::min(dims[slow], std::max<size_t>(1, NPY_CHUNK_BYTES / plane));
+  std::vector<uint8_t> slab(thickness * plane), packed;
+  const size_t side = max_res_pow2_roof(resolution);
+  // nodes no thicker than a slab overlap at most two, larger ones are jumped
+  // over through the index, so the tokens are read about twice in all
+  size_t index_depth = 0;
+  while ((side >> index_depth) > thickness) {
+    index_depth++;
+  }
+  const std::vector<SplitExtent> extents =
+      index_splits(encoding, side, index_depth);
+  uint8_t pending = 0;
+  size_t pending_bits = 0;
+  for (size_t first = 0; first < dims[slow]; first += thickness) {
+    const size_t last = std::min(first + thickness, dims[slow]);
+    size_t slab_dims[3] = {dims[0], dims[1], dims[2]};
+    slab_dims[slow] = last - first;
+    ptrdiff_t strides[3];
+    if (fortran_order) {
+      fortran_strides(slab_dims, 1, strides);
+    } else {
+      contiguous_strides(slab_dims, 1, strides);
+    }
+    Box bounds = {0, dims[0], 0, dims[1], 0, dims[2]};
+    size_t &bound_first = fortran_order ? bounds.zs : bounds.xs;
+    size_t &bound_last = fortran_order ? bounds.ze : bounds.xe;
+    bound_first = first;
+    bound_last = last;
+
+    const size_t count = (last - first) * plane;
+    std::fill_n(slab.begin(), count, 0);
+    size_t idx = 0, split = 0;
+    NodeWalk(side).run([&](const NodeKey &key, const Box &node) {
+      Box box = intersect(node, bounds);
+      if (0 == volume(box)) {
+        if (!encoding[idx]) {
+          idx += 2;
+        } else if (key.depth < index_depth) {
+          idx = extents[split].end;
+          split += extents[split].splits;
+        } else {
+          idx = skip_node(encoding, idx);
+        }
+        return Step::NEXT;
+      }
+      if (encoding[idx]) {
+        split += key.depth < index_depth;
+        idx++;
+        return Step::DESCEND;
+      }
+      if (encoding[idx + 1]) {
+        (fortran_order ? box.zs : box.xs) -= first;
+        (fortran_order ? box.ze : box.xe) -= first;
+        fill_strided(slab.data(), strides, box, uint8_t(1));
+      }
+      idx += 2;
+      return Step::NEXT;
+    });
+
+    if (NpyLayout::PACKBITS != layout) {
+      file_out.write(reinterpret_cast<const char *>(slab.data()), count);
+      continue;
+    }
+    packed.clear();
+    for (size_t i = 0; i < count; i++) {
+      pending = static_cast<uint8_t>(pending << 1 | slab[i]);
+      if (8 == ++pending_bits) {
+        packed.push_back(pending);
+        pending = 0;
+        pending_bits = 0;
+      }
+    }
+    file_out.write(reinterpret_cast<const char *>(packed.data()),
+                   packed.size());
+  }
+  if (pending_bits) {
+    pending = static_cast<uint8_t>(pending << (8 - pending_bits));
+    file_out.write(reinterpret_cast<const char *>(&pending), 1);
+  }
+  if (!file_out) {
+    throw std::runtime_error("Could not write " + filename);
+  }
+}
+
+} // namespace otbv
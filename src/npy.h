@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../include/otbv.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace otbv {
+
+// rows are read, and slabs written, through buffers of about this size
+static constexpr size_t NPY_CHUNK_BYTES = 1 << 22;
+
+/**
+ * @brief The array description at the start of a .npy file
+ */
+struct NpyHeader {
+  std::string descr;
+  bool fortran_order;
+  std::vector<size_t> shape;
+};
+
+/**
+ * @brief Reads the header at the start of \p in, leaving the stream at the
+ * first byte of the array
+ *
+ * @throws std::runtime_error If the header is malformed
+ */
+NpyHeader read_npy_header(std::istream &in);
+
+/**
+ * @brief Writes a version 1.0 header for \p header to \p out
+ */
+void write_npy_header(std::ostream &out, const NpyHeader &header);
+
+/**
+ * @brief Reads the voxels of a .npy array one row at a time, through a fixed
+ * size buffer
+ */
+class NpyRowReader {
+public:
+  /**
+   * @param packed The rows are packed 8 voxels per byte, most significant bit
+   * first, and may start mid-byte
+   */
+  NpyRowReader(std::istream &in, size_t row_length, size_t rows, bool packed);
+
+  /**
+   * @brief Returns the next row, one byte per voxel, nonzero if occupied
+   *
+   * @throws std::runtime_error If the file ends early
+   */
+  const uint8_t *next();
+
+private:
+  std::istream &in;
+  size_t row_length, rows_left, bytes_left;
+  bool packed;
+  std::vector<uint8_t> buffer, row;
+  size_t position = 0, filled = 0, bit = 0;
+
+  void refill();
+};
+
+} // namespace otbv
@@ -0,0 +1,231 @@
+#include "../include/otbv.h"
+#include "conversion.h"
+#include "io.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace otbv {
+
+Octree::Octree(std::vector<bool> encoding,
+               const std::tuple<size_t, size_t, size_t> &resolution)
+    : source(std::move(encoding)), shape(resolution) {
+  check_resolution(shape);
+  side = max_res_pow2_roof(shape);
+  build();
+}
+
+Octree::Octree(const std::string &filename) {
+  source = load_encoding(filename, shape);
+  check_resolution(shape);
+  side = max_res_pow2_roof(shape);
+  build();
+}
+
+/**
+ * @brief Helper function. Reads \p source into the pool of nodes
+ */
+void Octree::build() {
+  // the split node open at every level
+  std::array<uint32_t, RECURSION_MAX_DEPTH + 1> open;
+  const auto attach = [&](const NodeKey &key, const uint32_t ref) {
+    if (0 == key.depth) {
+      root = ref;
+    } else {
+      nodes[open[key.depth - 1]].children[key.prefix & 7] = ref;
+    }
+  };
+  size_t idx = 0;
+  NodeWalk(side).run(
+      [&](const NodeKey &key, const Box &) {
+        if (idx + 1 >= source.size()) {
+          throw std::out_of_range("Unexpected end of the encoding");
+        }
+        if (!source[idx]) {
+          attach(key, source[idx + 1] ? FULL : EMPTY);
+          idx += 2;
+          return Step::NEXT;
+        }
+        const uint32_t id = allocate();
+        nodes[id].start = idx++;
+        attach(key, id);
+        open[key.depth] = id;
+        return Step::DESCEND;
+      },
+      [&](const NodeKey &key) {
+        Node &split = nodes[open[key.depth]];
+        split.end = idx;
+        split.dirty = false;
+      });
+}
+
+/**
+ * @brief Helper function. Returns a dirty node from the free list, or a new
+ * one
+ */
+uint32_t Octree::allocate() {
+  uint32_t id;
+  if (!free_nodes.empty()) {
+    id = free_nodes.back();
+    free_nodes.pop_back();
+  } else {
+    if (nodes.size() >= EMPTY) {
+      throw std::length_error("Too many octree nodes");
+    }
+    id = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+  }
+  nodes[id].dirty = true;
+  return id;
+}
+
+/**
+ * @brief Helper function. Returns the subtree \p ref to the free list
+ */
+void Octree::release(uint32_t ref) {
+  if (EMPTY == ref || FULL == ref) {
+    return;
+  }
+  // the free list doubles as the queue of nodes whose children are released
+  size_t next = free_nodes.size();
+  free_nodes.push_back(ref);
+  for (; next < free_nodes.size(); next++) {
+    for (const uint32_t child : nodes[free_nodes[next]].children) {
+      if (EMPTY != child && FULL != child) {
+        free_nodes.push_back(child);
+      }
+    }
+  }
+}
+
+bool Octree::get(size_t x, size_t y, size_t z) const {
+  if (x >= std::get<0>(shape) || y >= std::get<1>(shape) ||
+      z >= std::get<2>(shape)) {
+    throw std::out_of_range("Voxel lies outside of the volume");
+  }
+  uint32_t ref = root;
+  size_t half = side >> 1;
+  while (EMPTY != ref && FULL != ref) {
+    const size_t i = (((x & half) != 0) << 2) | (((y & half) != 0) << 1) |
+                     ((z & half) != 0);
+    ref = nodes[ref].children[i];
+    half >>= 1;
+  }
+  return FULL == ref;
+}
+
+void Octree::set(size_t x, size_t y, size_t z, bool value) {
+  if (x >= std::get<0>(shape) || y >= std::get<1>(shape) ||
+      z >= std::get<2>(shape)) {
+    throw std::out_of_range("Voxel lies outside of the volume");
+  }
+  set_box({x, x + 1, y, y + 1, z, z + 1}, value);
+}
+
+void Octree::set_box(const Box &box, bool value) {
+  const size_t x_res = std::get<0>(shape), y_res = std::get<1>(shape),
+               z_res = std::get<2>(shape);
+  const Box target = clip(box, x_res, y_res, z_res);
+  if (0 == volume(target)) {
+    return;
+  }
+  const uint32_t leaf = value ? FULL : EMPTY;
+  // the split node open at every level
+  std::array<uint32_t, RECURSION_MAX_DEPTH + 1> open;
+  const auto slot = [&](const NodeKey &key) -> uint32_t & {
+    return 0 == key.depth ? root
+                          : nodes[open[key.depth - 1]].children[key.prefix & 7];
+  };
+  // leaves are split on the way down, and nodes whose children became uniform
+  // are collapsed on the way up
+  NodeWalk(side).run(
+      [&](const NodeKey &key, const Box &node) {
+        const Box clipped = clip(node, x_res, y_res, z_res);
+        const size_t covered = volume(intersect(target, clipped));
+        const uint32_t ref = slot(key);
+        if (0 == covered || leaf == ref) {
+          return Step::NEXT;
+        }
+        if (covered == volume(clipped)) {
+          release(ref);
+          slot(key) = leaf;
+          return Step::NEXT;
+        }
+        uint32_t id = ref;
+        if (EMPTY == ref || FULL == ref) {
+          id = allocate();
+          std::fill(nodes[id].children, nodes[id].children + 8, ref);
+          slot(key) = id;
+        }
+        nodes[id].dirty = true;
+        open[key.depth] = id;
+        return Step::DESCEND;
+      },
+      [&](const NodeKey &key) {
+        // padding children match any value
+        const Box node = node_box(key, side);
+        const uint32_t id = open[key.depth];
+        for (size_t i = 0; i < 8; i++) {
+          if (volume(clip(child_box(node, i), x_res, y_res, z_res)) &&
+              leaf != nodes[id].children[i]) {
+            return;
+          }
+        }
+        release(id);
+        slot(key) = leaf;
+      });
+}
+
+std::vector<bool> Octree::encode() const {
+  const size_t x_res = std::get<0>(shape), y_res = std::get<1>(shape),
+               z_res = std::get<2>(shape);
+  std::vector<bool> out;
+  // the split node open at every level
+  std::array<uint32_t, RECURSION_MAX_DEPTH + 1> open;
+  NodeWalk(side).run([&](const NodeKey &key, const Box &node) {
+    const uint32_t ref =
+        0 == key.depth ? root
+                       : nodes[open[key.depth - 1]].children[key.prefix & 7];
+    if (0 == volume(clip(node, x_res, y_res, z_res))) {
+      out.push_back(0);
+      out.push_back(0);
+      return Step::NEXT;
+    }
+    if (EMPTY == ref || FULL == ref) {
+      out.push_back(0);
+      out.push_back(FULL == ref);
+      return Step::NEXT;
+    }
+    const Node &split = nodes[ref];
+    if (!split.dirty) {
+      // untouched subtrees are copied from the source
+      out.insert(out.end(), source.begin() + split.start,
+                 source.begin() + split.end);
+      return Step::NEXT;
+    }
+    out.push_back(1);
+    open[key.depth] = ref;
+    return Step::DESCEND;
+  });
+  return out;
+}
+
+void Octree::save(const std::string &filename) const {
+  save_encoding(filename, encode(), shape);
+}
+
+std::tuple<size_t, size_t, size_t> Octree::resolution() const {
+  return shape;
+}
+
+size_t Octree::node_count() const { return nodes.size() - free_nodes.size(); }
+
+} // namespace otbv
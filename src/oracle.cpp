@@ -0,0 +1,109 @@
+#include "oracle.h"
+#include "canonical.h"
+#include "conversion.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+void encode_oracle_subtree(const BoxClassifier &classify,
+                           const VoxelClassifier &voxel,
+                           std::vector<bool> &encoding, const size_t side,
+                           const NodeKey &root, const size_t x_res,
+                           const size_t y_res, const size_t z_res) {
+  // start of the split node being encoded at every level
+  std::array<size_t, RECURSION_MAX_DEPTH + 1> starts;
+  NodeWalk(side, root).run(
+      [&](const NodeKey &key, const Box &node) {
+        // the padding is never decoded, so the oracle only sees the clipped
+        // box
+        const Box clipped = clip(node, x_res, y_res, z_res);
+        const size_t clipped_size = volume(clipped);
+        if (0 == clipped_size) {
+          encoding.push_back(0);
+          encoding.push_back(0);
+          return Step::NEXT;
+        }
+
+        Occupancy occupancy;
+        if (1 == clipped_size && voxel) {
+          occupancy = voxel(clipped.xs, clipped.ys, clipped.zs)
+                          ? Occupancy::FULL
+                          : Occupancy::EMPTY;
+        } else {
+          occupancy = classify(clipped);
+        }
+        if (Occupancy::MIXED != occupancy) {
+          // leaf
+          encoding.push_back(0);
+          encoding.push_back(Occupancy::FULL == occupancy);
+          return Step::NEXT;
+        }
+        if (1 == clipped_size) {
+          throw std::runtime_error(
+              "The classifier reported a single voxel as mixed.");
+        }
+        starts[key.depth] = encoding.size();
+        encoding.push_back(1);
+        return Step::DESCEND;
+      },
+      [&](const NodeKey &key) {
+        // a conservative oracle may call a box mixed when it is not
+        collapse_uniform_children(
+            encoding, starts[key.depth],
+            padding_children(node_box(key, side), x_res, y_res, z_res));
+      });
+}
+
+std::vector<bool>
+encode_from_oracle(const std::tuple<size_t, size_t, size_t> &resolution,
+                   const BoxClassifier &classify,
+                   const VoxelClassifier &voxel, size_t threads) {
+  const size_t x_res = std::get<0>(resolution), //
+      y_res = std::get<1>(resolution),          //
+      z_res = std::get<2>(resolution);
+  check_resolution(resolution);
+  if (!classify) {
+    throw std::invalid_argument("A box classifier is required");
+  }
+  std::vector<bool> out;
+  const size_t side = max_res_pow2_roof(resolution);
+  const Box root = {0, side, 0, side, 0, side};
+  if (threads < 2 || side < 2) {
+    encode_oracle_subtree(classify, voxel, out, side, {0, 0}, x_res, y_res,
+                          z_res);
+    return out;
+  }
+  const Occupancy occupancy = classify(clip(root, x_res, y_res, z_res));
+  if (Occupancy::MIXED != occupancy) {
+    // leaf
+    out.push_back(0);
+    out.push_back(Occupancy::FULL == occupancy);
+    return out;
+  }
+
+  // encode the top-level octants separately, then splice them in order
+  threads = std::min<size_t>(threads, 8);
+  std::array<std::vector<bool>, 8> octants;
+  run_workers(threads, [&](size_t worker) {
+    for (size_t i = worker; i < 8; i += threads) {
+      encode_oracle_subtree(classify, voxel, octants[i], side, {i, 1}, x_res,
+                            y_res, z_res);
+    }
+  });
+  out.push_back(1);
+  for (const auto &octant : octants) {
+    out.insert(out.end(), octant.begin(), octant.end());
+  }
+  collapse_uniform_children(out, 0,
+                            padding_children(root, x_res, y_res, z_res));
+  return out;
+}
+
+} // namespace otbv
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../include/otbv.h"
+#include "traversal.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace otbv {
+
+/**
+ * @brief Helper function. Classifies the nodes of the subtree of \p root, in
+ * an octree of side \p side, and appends its encoding to \p encoding,
+ * descending into mixed nodes
+ */
+void encode_oracle_subtree(const BoxClassifier &classify,
+                           const VoxelClassifier &voxel,
+                           std::vector<bool> &encoding, const size_t side,
+                           const NodeKey &root, const size_t x_res,
+                           const size_t y_res, const size_t z_res);
+
+} // namespace otbv
@@ -0,0 +1,260 @@
+#include "../include/otbv_c.h"
+#include "bits.h"
+#include "conversion.h"
+#include "io.h"
+#include "strided.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+thread_local std::string last_error;
+
+/**
+ * @brief Runs \p task, translating any exception into a status code
+ */
+template <typename Task> otbv_status guarded(const Task &task) {
+  last_error.clear();
+  try {
+    return task();
+  } catch (const std::bad_alloc &e) {
+    last_error = e.what();
+    return OTBV_ERROR_OUT_OF_MEMORY;
+  } catch (const std::invalid_argument &e) {
+    last_error = e.what();
+    return OTBV_ERROR_INVALID_ARGUMENT;
+  } catch (const std::out_of_range &e) {
+    last_error = e.what();
+    return OTBV_ERROR_FORMAT;
+  } catch (const std::runtime_error &e) {
+    last_error = e.what();
+    return OTBV_ERROR_FORMAT;
+  } catch (const std::exception &e) {
+    last_error = e.what();
+    return OTBV_ERROR_INTERNAL;
+  } catch (...) {
+    return OTBV_ERROR_INTERNAL;
+  }
+}
+
+otbv_status fail(otbv_status status, const char *message) {
+  last_error = message;
+  return status;
+}
+
+/**
+ * @brief Stream buffer writing into caller-owned memory
+ */
+struct ArrayBuffer : std::streambuf {
+  ArrayBuffer(char *data, size_t size) { setp(data, data + size); }
+};
+
+otbv_status read_file(const char *filename, std::vector<char> &bytes) {
+  std::ifstream file_in(filename, std::ios::binary);
+  if (!file_in) {
+    return fail(OTBV_ERROR_IO, "Could not open file for reading.");
+  }
+  bytes.assign(std::istreambuf_iterator<char>(file_in),
+               std::istreambuf_iterator<char>());
+  return OTBV_OK;
+}
+
+void resolve_strides(const size_t shape[3], const ptrdiff_t strides[3],
+                     ptrdiff_t out[3]) {
+  if (strides) {
+    out[0] = strides[0];
+    out[1] = strides[1];
+    out[2] = strides[2];
+  } else {
+    otbv::contiguous_strides(shape, 1, out);
+  }
+}
+
+/**
+ * @brief Copies what \p header tells about its file to \p info
+ */
+void fill_info(const otbv::Header &header, otbv_info *info) {
+  // the number of tokens follows from the header alone
+  const otbv::PackedBits bits = otbv::data_bits(nullptr, header);
+  info->shape[0] = header.x_res;
+  info->shape[1] = header.y_res;
+  info->shape[2] = header.z_res;
+  info->encoded_bits = bits.size();
+  info->file_size = header.data_offset + header.data_length;
+  info->channels = header.channels;
+  info->checksummed = header.checksummed;
+  info->anisotropic = header.anisotropic;
+}
+
+} // namespace
+
+extern "C" {
+
+int otbv_abi_version(void) { return OTBV_C_ABI_VERSION; }
+
+const char *otbv_status_string(otbv_status status) {
+  switch (status) {
+  case OTBV_OK:
+    return "ok";
+  case OTBV_ERROR_INVALID_ARGUMENT:
+    return "invalid argument";
+  case OTBV_ERROR_IO:
+    return "i/o error";
+  case OTBV_ERROR_FORMAT:
+    return "malformed OTBV data";
+  case OTBV_ERROR_BUFFER_TOO_SMALL:
+    return "buffer too small";
+  case OTBV_ERROR_OUT_OF_MEMORY:
+    return "out of memory";
+  case OTBV_ERROR_INTERNAL:
+    return "internal error";
+  }
+  return "unknown status";
+}
+
+const char *otbv_last_error(void) { return last_error.c_str(); }
+
+otbv_status otbv_info_buffer(const void *file_bytes, size_t length,
+                             otbv_info *info) {
+  if (!file_bytes || !info) {
+    return fail(OTBV_ERROR_INVALID_ARGUMENT, "Null argument");
+  }
+  return guarded([&]() {
+    fill_info(otbv::parse_header(static_cast<const char *>(file_bytes), length),
+              info);
+    return OTBV_OK;
+  });
+}
+
+otbv_status otbv_info_file(const char *filename, otbv_info *info) {
+  if (!filename || !info) {
+    return fail(OTBV_ERROR_INVALID_ARGUMENT, "Null argument");
+  }
+  return guarded([&]() {
+    // the header and the size of the file are enough
+    std::ifstream file_in(filename, std::ios::binary | std::ios::ate);
+    if (!file_in) {
+      return fail(OTBV_ERROR_IO, "Could not open file for reading.");
+    }
+    const size_t file_size = static_cast<size_t>(file_in.tellg());
+    file_in.seekg(0);
+    char header[otbv::MAX_HEADER_SIZE] = {};
+    if (!file_in.read(header,
+                      std::min<size_t>(file_size, otbv::MAX_HEADER_SIZE))) {
+      return fail(OTBV_ERROR_IO, "Could not read the header.");
+    }
+    fill_info(otbv::parse_header(header, file_size), info);
+    return OTBV_OK;
+  });
+}
+
+size_t otbv_encode_bound(const size_t shape[3]) {
+  if (!shape || 0 == shape[0] || 0 == shape[1] || 0 == shape[2]) {
+    return 0;
+  }
+  const size_t side = otbv::max_res_pow2_roof(shape[0], shape[1], shape[2]);
+  const size_t voxels = side * side * side;
+  // a complete tree: 2 tokens per voxel, 1 per split node
+  const size_t tokens = 2 * voxels + (voxels - 1) / 7;
+  return otbv::HEADER_SIZE + (tokens + 7) / 8;
+}
+
+otbv_status otbv_encode(const uint8_t *data, const size_t shape[3],
+                        const ptrdiff_t strides[3], void *out,
+                        size_t capacity, size_t *out_size) {
+  if (!data || !shape || !out_size) {
+    return fail(OTBV_ERROR_INVALID_ARGUMENT, "Null argument");
+  }
+  return guarded([&]() {
+    otbv::StridedVolume<uint8_t> view{data, {shape[0], shape[1], shape[2]},
+                                      {}, 0};
+    resolve_strides(shape, strides, view.strides);
+    const auto resolution = view.resolution();
+    const std::vector<bool> encoding = otbv::encode_view(view, resolution);
+
+    *out_size = otbv::HEADER_SIZE + (encoding.size() + 7) / 8;
+    if (!out || capacity < *out_size) {
+      return fail(OTBV_ERROR_BUFFER_TOO_SMALL,
+                  "The output buffer cannot hold the encoded volume");
+    }
+    ArrayBuffer buffer(static_cast<char *>(out), capacity);
+    std::ostream stream(&buffer);
+    otbv::stream_data_as_file_bytes(stream, encoding, resolution,
+                                    otbv::is_padded(resolution));
+    return OTBV_OK;
+  });
+}
+
+otbv_status otbv_save(const char *filename, const uint8_t *data,
+                      const size_t shape[3], const ptrdiff_t strides[3]) {
+  if (!filename || !data || !shape) {
+    return fail(OTBV_ERROR_INVALID_ARGUMENT, "Null argument");
+  }
+  return guarded([&]() {
+    otbv::StridedVolume<uint8_t> view{data, {shape[0], shape[1], shape[2]},
+                                      {}, 0};
+    resolve_strides(shape, strides, view.strides);
+    const auto resolution = view.resolution();
+    const std::vector<bool> encoding = otbv::encode_view(view, resolution);
+    std::ofstream file_out(filename, std::ofstream::binary);
+    if (!file_out) {
+      return fail(OTBV_ERROR_IO, "Could not open file for writing.");
+    }
+    otbv::stream_data_as_file_bytes(file_out, encoding, resolution,
+                                    otbv::is_padded(resolution));
+    file_out.close();
+    if (!file_out) {
+      return fail(OTBV_ERROR_IO, "Could not write the file.");
+    }
+    return OTBV_OK;
+  });
+}
+
+otbv_status otbv_decode(const void *file_bytes, size_t length, uint8_t *out,
+                        const ptrdiff_t strides[3]) {
+  if (!file_bytes || !out) {
+    return fail(OTBV_ERROR_INVALID_ARGUMENT, "Null argument");
+  }
+  return guarded([&]() {
+    const char *bytes = static_cast<const char *>(file_bytes);
+    const otbv::Header header = otbv::parse_header(bytes, length);
+    otbv::require_single_channel(header);
+    const size_t shape[3] = {header.x_res, header.y_res, header.z_res};
+    ptrdiff_t out_strides[3];
+    resolve_strides(shape, strides, out_strides);
+    otbv::decode_strided(
+        otbv::data_bits(bytes + header.data_offset, header),
+        std::make_tuple(shape[0], shape[1], shape[2]),
+        out, out_strides, uint8_t(1), uint8_t(0), header.anisotropic);
+    return OTBV_OK;
+  });
+}
+
+otbv_status otbv_load(const char *filename, uint8_t *out,
+                      const ptrdiff_t strides[3]) {
+  if (!filename || !out) {
+    return fail(OTBV_ERROR_INVALID_ARGUMENT, "Null argument");
+  }
+  return guarded([&]() {
+    std::vector<char> bytes;
+    const otbv_status status = read_file(filename, bytes);
+    if (OTBV_OK != status) {
+      return status;
+    }
+    return otbv_decode(bytes.data(), bytes.size(), out, strides);
+  });
+}
+
+} // extern "C"
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace otbv {
+
+/**
+ * @brief Returns \p threads, or the hardware concurrency if \p threads is 0
+ */
+inline size_t resolve_threads(size_t threads) {
+  if (0 == threads) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return threads;
+}
+
+/**
+ * @brief Runs \p task(worker) for every worker in [0, \p workers) on its own
+ * thread, and rethrows the first exception raised by any of them once all
+ * have finished. A single worker runs on the calling thread.
+ */
+template <typename Task> void run_workers(size_t workers, const Task &task) {
+  if (workers < 2) {
+    task(0);
+    return;
+  }
+  std::vector<std::exception_ptr> errors(workers);
+  std::vector<std::thread> threads;
+  threads.reserve(workers);
+  for (size_t worker = 0; worker < workers; worker++) {
+    threads.emplace_back([&, worker]() {
+      try {
+        task(worker);
+      } catch (...) {
+        errors[worker] = std::current_exception();
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (const auto &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+} // namespace otbv
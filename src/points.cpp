@@ -0,0 +1,150 @@
+#include "points.h"
+#include "conversion.h"
+#include "morton.h"
+#include "parallel.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+// below this, sorting on several threads costs more than it saves
+static constexpr size_t MIN_KEYS_PER_THREAD = 1 << 16;
+
+void sort_unique_keys(std::vector<uint64_t> &keys, size_t threads) {
+  threads = std::min(resolve_threads(threads),
+                     std::max<size_t>(1, keys.size() / MIN_KEYS_PER_THREAD));
+  std::vector<size_t> bounds(threads + 1);
+  for (size_t i = 0; i <= threads; i++) {
+    bounds[i] = keys.size() * i / threads;
+  }
+  run_workers(threads, [&](size_t worker) {
+    std::sort(keys.begin() + bounds[worker], keys.begin() + bounds[worker + 1]);
+  });
+  // merge neighbouring sorted chunks, doubling their width every round
+  for (size_t width = 1; width < threads; width *= 2) {
+    const size_t pairs = (threads + 2 * width - 1) / (2 * width);
+    run_workers(pairs, [&](size_t pair) {
+      const size_t first = pair * 2 * width;
+      if (first + width >= threads) {
+        return;
+      }
+      const size_t last = std::min(first + 2 * width, threads);
+      std::inplace_merge(keys.begin() + bounds[first],
+                         keys.begin() + bounds[first + width],
+                         keys.begin() + bounds[last]);
+    });
+  }
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+std::vector<bool>
+encode_sorted_keys(const std::vector<uint64_t> &keys,
+                   const std::tuple<size_t, size_t, size_t> &resolution) {
+  check_resolution(resolution);
+  const size_t x_res = std::get<0>(resolution), y_res = std::get<1>(resolution),
+               z_res = std::get<2>(resolution);
+  std::vector<bool> out;
+  // keys before the current node were consumed by the nodes before it
+  const uint64_t *next = keys.data();
+  // end of the keys of the split node open at every level
+  std::array<const uint64_t *, RECURSION_MAX_DEPTH + 1> ends;
+  NodeWalk(max_res_pow2_roof(resolution))
+      .run([&](const NodeKey &key, const Box &node) {
+        // the codes of a node are [prefix, prefix + 1) times its volume
+        const uint64_t node_side = node.xe - node.xs;
+        const uint64_t node_volume = node_side * node_side * node_side;
+        const uint64_t *end =
+            0 == key.depth
+                ? keys.data() + keys.size()
+                : std::lower_bound(next, ends[key.depth - 1],
+                                   (key.prefix + 1) * node_volume);
+        // padding never holds keys, so comparing against the clipped size
+        // suffices
+        const size_t count = end - next;
+        if (0 == count || volume(clip(node, x_res, y_res, z_res)) == count) {
+          // leaf
+          out.push_back(0);
+          out.push_back(0 != count);
+          next = end;
+          return Step::NEXT;
+        }
+        ends[key.depth] = end;
+        out.push_back(1);
+        return Step::DESCEND;
+      });
+  return out;
+}
+
+PointCloudEncoder::PointCloudEncoder(
+    const std::tuple<size_t, size_t, size_t> &resolution,
+    const std::array<double, 3> &origin, double voxel_size, size_t threads)
+    : resolution(resolution), origin(origin), voxel_size(voxel_size),
+      threads(resolve_threads(threads)) {
+  check_resolution(resolution);
+  if (!(voxel_size > 0)) {
+    throw std::invalid_argument("Voxel size must be positive");
+  }
+}
+
+void PointCloudEncoder::insert(
+    const std::vector<std::array<float, 3>> &points) {
+  const std::array<size_t, 3> res = {std::get<0>(resolution),
+                                     std::get<1>(resolution),
+                                     std::get<2>(resolution)};
+  std::vector<uint64_t> batch;
+  batch.reserve(points.size());
+  for (const auto &point : points) {
+    std::array<size_t, 3> idx;
+    bool inside = true;
+    for (int a = 0; a < 3; a++) {
+      const double v = std::floor((point[a] - origin[a]) / voxel_size);
+      // also rejects NaN
+      if (!(v >= 0 && v < static_cast<double>(res[a]))) {
+        inside = false;
+        break;
+      }
+      idx[a] = static_cast<size_t>(v);
+    }
+    if (inside) {
+      batch.push_back(morton_encode(idx[0], idx[1], idx[2]));
+    }
+  }
+  sort_unique_keys(batch, threads);
+
+  if (keys.empty()) {
+    keys.swap(batch);
+    return;
+  }
+  std::vector<uint64_t> merged;
+  merged.reserve(keys.size() + batch.size());
+  std::set_union(keys.begin(), keys.end(), batch.begin(), batch.end(),
+                 std::back_inserter(merged));
+  keys.swap(merged);
+}
+
+size_t PointCloudEncoder::size() const { return keys.size(); }
+
+std::vector<bool> PointCloudEncoder::encode() const {
+  return encode_sorted_keys(keys, resolution);
+}
+
+std::vector<bool>
+encode_from_points(const std::vector<std::array<float, 3>> &points,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   const std::array<double, 3> &origin, double voxel_size,
+                   size_t threads) {
+  PointCloudEncoder encoder(resolution, origin, voxel_size, threads);
+  encoder.insert(points);
+  return encoder.encode();
+}
+
+} // namespace otbv
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../include/otbv.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+/**
+ * @brief Sorts \p keys using \p threads threads and removes duplicates
+ */
+void sort_unique_keys(std::vector<uint64_t> &keys, size_t threads);
+
+/**
+ * @brief Encodes a volume of shape \p resolution from the sorted, unique
+ * Morton codes of its occupied voxels, in a single pass over \p keys
+ */
+std::vector<bool>
+encode_sorted_keys(const std::vector<uint64_t> &keys,
+                   const std::tuple<size_t, size_t, size_t> &resolution);
+
+} // namespace otbv
@@ -0,0 +1,320 @@
+#include "raw.h"
+#include "conversion.h"
+#include "mapped_file.h"
+#include "strided.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+namespace {
+struct NrrdType {
+  const char *name;
+  ScalarType type;
+};
+} // namespace
+
+// every spelling the NRRD specification allows, the preferred one first
+static const NrrdType NRRD_TYPES[] = {
+    {"uint8", ScalarType::UINT8},          {"uchar", ScalarType::UINT8},
+    {"unsigned char", ScalarType::UINT8},  {"uint8_t", ScalarType::UINT8},
+    {"int8", ScalarType::INT8},            {"signed char", ScalarType::INT8},
+    {"int8_t", ScalarType::INT8},          {"uint16", ScalarType::UINT16},
+    {"ushort", ScalarType::UINT16},        {"unsigned short", ScalarType::UINT16},
+    {"unsigned short int", ScalarType::UINT16},
+    {"uint16_t", ScalarType::UINT16},      {"int16", ScalarType::INT16},
+    {"short", ScalarType::INT16},          {"short int", ScalarType::INT16},
+    {"signed short", ScalarType::INT16},   {"signed short int", ScalarType::INT16},
+    {"int16_t", ScalarType::INT16},        {"uint32", ScalarType::UINT32},
+    {"uint", ScalarType::UINT32},          {"unsigned int", ScalarType::UINT32},
+    {"uint32_t", ScalarType::UINT32},      {"int32", ScalarType::INT32},
+    {"int", ScalarType::INT32},            {"signed int", ScalarType::INT32},
+    {"int32_t", ScalarType::INT32},        {"float", ScalarType::FLOAT32},
+    {"double", ScalarType::FLOAT64},
+};
+
+size_t scalar_size(ScalarType type) {
+  size_t size = 0;
+  with_scalar_type(type, [&](auto element) { size = sizeof(element); });
+  return size;
+}
+
+bool host_big_endian() {
+  const uint16_t probe = 1;
+  uint8_t first;
+  std::memcpy(&first, &probe, 1);
+  return 0 == first;
+}
+
+/**
+ * @brief Helper function. Returns the voxel count of \p layout, and checks
+ * that \p size bytes hold it
+ */
+static size_t checked_voxels(const RawLayout &layout, size_t size) {
+  check_resolution(layout.shape);
+  const size_t voxels = std::get<0>(layout.shape) * std::get<1>(layout.shape) *
+                        std::get<2>(layout.shape);
+  if (layout.offset > size ||
+      (size - layout.offset) / scalar_size(layout.type) < voxels) {
+    throw std::runtime_error("The file is shorter than its layout requires.");
+  }
+  return voxels;
+}
+
+/**
+ * @brief Helper function. Returns the byte strides of \p layout
+ */
+static void layout_strides(const RawLayout &layout, ptrdiff_t strides[3]) {
+  const size_t shape[3] = {std::get<0>(layout.shape),
+                           std::get<1>(layout.shape),
+                           std::get<2>(layout.shape)};
+  if (layout.fortran_order) {
+    fortran_strides(shape, scalar_size(layout.type), strides);
+  } else {
+    contiguous_strides(shape, scalar_size(layout.type), strides);
+  }
+}
+
+/**
+ * @brief Helper function. Encodes the volume laid out as \p layout in \p
+ * bytes, \p size bytes long
+ */
+static std::vector<bool> encode_mapped(const char *bytes, size_t size,
+                                       const RawLayout &layout,
+                                       double threshold) {
+  checked_voxels(layout, size);
+  std::vector<bool> out;
+  with_scalar_type(layout.type, [&](auto element) {
+    using T = decltype(element);
+    ThresholdedVolume<T> view{
+        reinterpret_cast<const uint8_t *>(bytes) + layout.offset,
+        {},
+        threshold,
+        sizeof(T) > 1 && layout.big_endian != host_big_endian()};
+    layout_strides(layout, view.strides);
+    out = encode_view(view, layout.shape);
+  });
+  return out;
+}
+
+/**
+ * @brief Helper function. Writes 1 to every occupied voxel of \p encoding
+ * into \p out, laid out as \p layout. Empty voxels are left untouched.
+ */
+static void fill_occupied(const std::vector<bool> &encoding,
+                          const RawLayout &layout, uint8_t *out) {
+  ptrdiff_t strides[3];
+  layout_strides(layout, strides);
+  with_scalar_type(layout.type, [&](auto element) {
+    using T = decltype(element);
+    T on = 1;
+    if (sizeof(T) > 1 && layout.big_endian != host_big_endian()) {
+      on = swap_bytes(on);
+    }
+    visit_leaves(encoding, layout.shape, LeafFilter::OCCUPIED,
+                 [&](const Leaf &leaf) {
+                   fill_strided(out + layout.offset, strides, leaf.box, on);
+                 });
+  });
+}
+
+std::vector<bool> encode_raw(const std::string &filename,
+                             const RawLayout &layout, double threshold) {
+  const MappedFile file(filename);
+  return encode_mapped(file.data(), file.size(), layout, threshold);
+}
+
+void decode_to_raw(const std::string &filename,
+                   const std::vector<bool> &encoding, const RawLayout &layout) {
+  check_resolution(layout.shape);
+  const size_t voxels = std::get<0>(layout.shape) * std::get<1>(layout.shape) *
+                        std::get<2>(layout.shape);
+  MappedOutput out(filename, layout.offset + voxels * scalar_size(layout.type));
+  fill_occupied(encoding, layout, out.data());
+}
+
+/**
+ * @brief Helper function. Returns \p text without surrounding whitespace
+ */
+static std::string trim(const std::string &text) {
+  const size_t first = text.find_first_not_of(" \t\r");
+  if (std::string::npos == first) {
+    return "";
+  }
+  return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+NrrdHeader parse_nrrd_header(const char *bytes, size_t size) {
+  if (size < 8 || std::memcmp(bytes, "NRRD000", 7)) {
+    throw std::runtime_error("Not a NRRD file.");
+  }
+  // lines are read in place, so that attached data is never copied
+  const auto line_end = [&](size_t from) -> size_t {
+    const void *newline = std::memchr(bytes + from, '\n', size - from);
+    return newline ? static_cast<const char *>(newline) - bytes : size;
+  };
+  NrrdHeader header;
+  bool has_type = false, has_sizes = false, has_dimension = false;
+  size_t position = line_end(0);
+  while (position < size) {
+    position++;
+    const size_t end = line_end(position);
+    const std::string line =
+        trim(std::string(bytes + position, end - position));
+    position = end;
+    if (line.empty()) {
+      if (end < size) {
+        position++;
+      }
+      break;
+    }
+    const size_t colon = line.find(": ");
+    if ('#' == line[0] || std::string::npos == colon) {
+      // comments, and key/value pairs written "key:=value"
+      continue;
+    }
+    std::string key = line.substr(0, colon);
+    std::transform(key.begin(), key.end(), key.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    const std::string value = trim(line.substr(colon + 2));
+
+    if ("type" == key) {
+      const auto found =
+          std::find_if(std::begin(NRRD_TYPES), std::end(NRRD_TYPES),
+                       [&](const NrrdType &type) { return value == type.name; });
+      if (std::end(NRRD_TYPES) == found) {
+        throw std::runtime_error("Unsupported NRRD type " + value + ".");
+      }
+      header.layout.type = found->type;
+      has_type = true;
+    } else if ("dimension" == key) {
+      if ("3" != value) {
+        throw std::runtime_error("Only 3-dimensional NRRD volumes are "
+                                 "supported.");
+      }
+      has_dimension = true;
+    } else if ("sizes" == key) {
+      size_t sizes[3];
+      const char *cursor = value.c_str();
+      for (size_t &axis : sizes) {
+        char *after;
+        axis = std::strtoull(cursor, &after, 10);
+        if (after == cursor) {
+          throw std::runtime_error("Malformed NRRD sizes.");
+        }
+        cursor = after;
+      }
+      header.layout.shape = {sizes[0], sizes[1], sizes[2]};
+      has_sizes = true;
+    } else if ("encoding" == key) {
+      if ("raw" != value) {
+        throw std::runtime_error("Only raw NRRD encoding is supported.");
+      }
+    } else if ("endian" == key) {
+      header.layout.big_endian = "big" == value;
+    } else if ("data file" == key || "datafile" == key) {
+      if (0 == value.compare(0, 4, "LIST") ||
+          std::string::npos != value.find(' ')) {
+        throw std::runtime_error("Multi-file NRRD data is not supported.");
+      }
+      header.data_file = value;
+    } else if ("line skip" == key || "lineskip" == key) {
+      header.line_skip = std::strtoull(value.c_str(), nullptr, 10);
+    } else if ("byte skip" == key || "byteskip" == key) {
+      header.byte_skip = std::strtoll(value.c_str(), nullptr, 10);
+    }
+  }
+  if (!has_type || !has_sizes || !has_dimension) {
+    throw std::runtime_error("The NRRD header lacks type, dimension or sizes.");
+  }
+  // NRRD lists the fastest axis first
+  header.layout.fortran_order = true;
+  header.header_size = std::min(position, size);
+  return header;
+}
+
+/**
+ * @brief Helper function. Applies the line and byte skips of \p header to the
+ * data in \p bytes, \p size bytes long, starting at \p start
+ */
+static size_t nrrd_data_offset(const NrrdHeader &header, const char *bytes,
+                               size_t size, size_t start) {
+  for (size_t line = 0; line < header.line_skip; line++) {
+    const void *newline = std::memchr(bytes + start, '\n', size - start);
+    if (!newline) {
+      throw std::runtime_error("The NRRD data is shorter than its line skip.");
+    }
+    start = static_cast<const char *>(newline) - bytes + 1;
+  }
+  if (header.byte_skip >= 0) {
+    return start + header.byte_skip;
+  }
+  const size_t data = std::get<0>(header.layout.shape) *
+                      std::get<1>(header.layout.shape) *
+                      std::get<2>(header.layout.shape) *
+                      scalar_size(header.layout.type);
+  if (data > size) {
+    throw std::runtime_error("The file is shorter than its layout requires.");
+  }
+  return size - data;
+}
+
+std::vector<bool> encode_nrrd(const std::string &filename,
+                              std::tuple<size_t, size_t, size_t> &resolution,
+                              double threshold) {
+  const MappedFile file(filename);
+  NrrdHeader header = parse_nrrd_header(file.data(), file.size());
+  resolution = header.layout.shape;
+  if (header.data_file.empty()) {
+    header.layout.offset = nrrd_data_offset(header, file.data(), file.size(),
+                                            header.header_size);
+    return encode_mapped(file.data(), file.size(), header.layout, threshold);
+  }
+  // detached data lives next to the header
+  std::string data_path = header.data_file;
+  const size_t slash = filename.rfind('/');
+  if ('/' != data_path[0] && std::string::npos != slash) {
+    data_path = filename.substr(0, slash + 1) + data_path;
+  }
+  const MappedFile data(data_path);
+  header.layout.offset = nrrd_data_offset(header, data.data(), data.size(), 0);
+  return encode_mapped(data.data(), data.size(), header.layout, threshold);
+}
+
+void decode_to_nrrd(const std::string &filename,
+                    const std::vector<bool> &encoding,
+                    const std::tuple<size_t, size_t, size_t> &resolution,
+                    ScalarType type) {
+  check_resolution(resolution);
+  const auto found = std::find_if(
+      std::begin(NRRD_TYPES), std::end(NRRD_TYPES),
+      [&](const NrrdType &candidate) { return type == candidate.type; });
+  std::string text = "NRRD0004\n# Written by libotbv\ntype: ";
+  text += found->name;
+  text += "\ndimension: 3\nsizes: " + std::to_string(std::get<0>(resolution)) +
+          " " + std::to_string(std::get<1>(resolution)) + " " +
+          std::to_string(std::get<2>(resolution)) + "\nencoding: raw\n";
+  if (scalar_size(type) > 1) {
+    text += host_big_endian() ? "endian: big\n" : "endian: little\n";
+  }
+  text += "\n";
+
+  const RawLayout layout = {resolution, type, true, host_big_endian(),
+                            text.size()};
+  const size_t voxels = std::get<0>(resolution) * std::get<1>(resolution) *
+                        std::get<2>(resolution);
+  MappedOutput out(filename, text.size() + voxels * scalar_size(type));
+  std::memcpy(out.data(), text.data(), text.size());
+  fill_occupied(encoding, layout, out.data());
+}
+
+} // namespace otbv
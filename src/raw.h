@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../include/otbv.h"
+#include "strided.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace otbv {
+
+/**
+ * @brief Returns the size in bytes of an element of type \p type
+ */
+size_t scalar_size(ScalarType type);
+
+/**
+ * @brief Returns true if the host stores multi-byte values big endian
+ */
+bool host_big_endian();
+
+/**
+ * @brief Calls \p task with a value of the C++ type matching \p type
+ */
+template <typename Task> void with_scalar_type(ScalarType type, Task &&task) {
+  switch (type) {
+  case ScalarType::UINT8:
+    return task(uint8_t{});
+  case ScalarType::INT8:
+    return task(int8_t{});
+  case ScalarType::UINT16:
+    return task(uint16_t{});
+  case ScalarType::INT16:
+    return task(int16_t{});
+  case ScalarType::UINT32:
+    return task(uint32_t{});
+  case ScalarType::INT32:
+    return task(int32_t{});
+  case ScalarType::FLOAT32:
+    return task(float{});
+  case ScalarType::FLOAT64:
+    return task(double{});
+  }
+  throw std::invalid_argument("Unknown scalar type");
+}
+
+/**
+ * @brief Returns \p value with its bytes reversed
+ */
+template <typename T> T swap_bytes(T value) {
+  uint8_t bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  std::reverse(bytes, bytes + sizeof(T));
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+/**
+ * @brief Read-only view of a strided volume of \p T elements, possibly of the
+ * other byte order. A voxel is occupied if its value is above \p threshold.
+ */
+template <typename T> struct ThresholdedVolume {
+  const uint8_t *data;
+  ptrdiff_t strides[3];
+  double threshold;
+  bool swap;
+
+  bool operator()(size_t x, size_t y, size_t z) const {
+    T value;
+    std::memcpy(&value, data + offset(strides, x, y, z), sizeof(T));
+    if (swap) {
+      value = swap_bytes(value);
+    }
+    return static_cast<double>(value) > threshold;
+  }
+};
+
+/**
+ * @brief The fields of a NRRD header that locate and describe the data
+ */
+struct NrrdHeader {
+  // offset is relative to the start of the data, before any skips
+  RawLayout layout;
+  // empty if the data is attached to the header
+  std::string data_file;
+  size_t line_skip = 0;
+  // -1 if the data ends the file
+  long long byte_skip = 0;
+  // bytes up to and including the blank line ending the header
+  size_t header_size = 0;
+};
+
+/**
+ * @brief Parses the NRRD header at the start of \p bytes, \p size bytes long
+ *
+ * @throws std::runtime_error If the header is malformed or unsupported
+ */
+NrrdHeader parse_nrrd_header(const char *bytes, size_t size);
+
+} // namespace otbv
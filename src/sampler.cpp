@@ -0,0 +1,238 @@
+#include "../include/otbv.h"
+#include "conversion.h"
+#include "io.h"
+#include "strided.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace otbv {
+
+/**
+ * @brief Helper function. Returns the voxel at position \p rank of \p box,
+ * counted in C order
+ */
+static Coord voxel_at(const Box &box, uint64_t rank) {
+  const uint64_t z_len = box.ze - box.zs, y_len = box.ye - box.ys;
+  const uint32_t z = static_cast<uint32_t>(box.zs + rank % z_len);
+  rank /= z_len;
+  const uint32_t y = static_cast<uint32_t>(box.ys + rank % y_len);
+  rank /= y_len;
+  return {static_cast<uint32_t>(box.xs + rank), y, z};
+}
+
+/**
+ * @brief Helper function. Returns the occupied voxels of the node \p root, of
+ * a tree of side \p side for a volume of shape \p shape, whose token is at
+ * \p idx in \p encoding, and moves \p idx past it
+ */
+static uint64_t count_subtree(const std::vector<bool> &encoding, size_t &idx,
+                              const size_t side, const NodeKey &root,
+                              const std::tuple<size_t, size_t, size_t> &shape) {
+  uint64_t occupied = 0;
+  NodeWalk(side, root).run([&](const NodeKey &, const Box &node) {
+    if (idx >= encoding.size()) {
+      throw std::out_of_range("Unexpected end of the encoding");
+    }
+    if (encoding[idx]) {
+      idx++;
+      return Step::DESCEND;
+    }
+    if (idx + 1 >= encoding.size()) {
+      throw std::out_of_range("Unexpected end of the encoding");
+    }
+    if (encoding[idx + 1]) {
+      occupied += volume(clip(node, std::get<0>(shape), std::get<1>(shape),
+                              std::get<2>(shape)));
+    }
+    idx += 2;
+    return Step::NEXT;
+  });
+  return occupied;
+}
+
+PatchSampler::PatchSampler(std::vector<bool> encoding,
+                           const std::tuple<size_t, size_t, size_t> &resolution,
+                           size_t cell)
+    : encoding(std::move(encoding)), shape(resolution) {
+  build(cell);
+}
+
+PatchSampler::PatchSampler(const std::string &filename, size_t cell) {
+  encoding = load_encoding(filename, shape);
+  build(cell);
+}
+
+/**
+ * @brief Helper function. Indexes the tree down to nodes of side \p
+ * requested, rounded up to a power of 2
+ */
+void PatchSampler::build(size_t requested) {
+  check_resolution(shape);
+  const size_t side = max_res_pow2_roof(shape);
+  size_t index_depth = 0;
+  cell = side;
+  while (cell > 1 && cell / 2 >= std::max<size_t>(requested, 1)) {
+    cell /= 2;
+    index_depth++;
+  }
+  const size_t res[3] = {std::get<0>(shape), std::get<1>(shape),
+                         std::get<2>(shape)};
+  for (int a = 0; a < 3; a++) {
+    grid[a] = (res[a] + cell - 1) / cell;
+  }
+  cells.assign(grid[0] * grid[1] * grid[2], 0);
+  // split nodes above the index depth are descended into, deeper subtrees
+  // are only counted
+  size_t idx = 0;
+  NodeWalk(side).run([&](const NodeKey &key, const Box &node) {
+    if (idx >= encoding.size()) {
+      throw std::out_of_range("Unexpected end of the encoding");
+    }
+    if (encoding[idx] && key.depth < index_depth) {
+      idx++;
+      return Step::DESCEND;
+    }
+    const size_t start = idx;
+    const uint64_t occupied = count_subtree(encoding, idx, side, key, shape);
+    const Box clipped = clip(node, std::get<0>(shape), std::get<1>(shape),
+                             std::get<2>(shape));
+    if (0 == volume(clipped)) {
+      return Step::NEXT;
+    }
+    const uint32_t id = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({node, clipped, start, key.depth, occupied});
+    for (size_t gx = clipped.xs / cell; gx * cell < clipped.xe; gx++) {
+      for (size_t gy = clipped.ys / cell; gy * cell < clipped.ye; gy++) {
+        for (size_t gz = clipped.zs / cell; gz * cell < clipped.ze; gz++) {
+          cells[(gx * grid[1] + gy) * grid[2] + gz] = id;
+        }
+      }
+    }
+    return Step::NEXT;
+  });
+
+  prefix.assign(1, 0);
+  for (const Node &node : nodes) {
+    prefix.push_back(prefix.back() + node.occupied);
+  }
+}
+
+uint64_t PatchSampler::occupied() const { return prefix.back(); }
+
+std::tuple<size_t, size_t, size_t> PatchSampler::resolution() const {
+  return shape;
+}
+
+Coord PatchSampler::sample_voxel(std::mt19937_64 &rng,
+                                 double foreground) const {
+  const Box whole = {0, std::get<0>(shape), 0, std::get<1>(shape), 0,
+                     std::get<2>(shape)};
+  const uint64_t total = prefix.back();
+  if (0 == total ||
+      std::uniform_real_distribution<double>(0, 1)(rng) >= foreground) {
+    return voxel_at(whole, std::uniform_int_distribution<uint64_t>(
+                               0, volume(whole) - 1)(rng));
+  }
+  uint64_t rank = std::uniform_int_distribution<uint64_t>(0, total - 1)(rng);
+  const size_t id =
+      std::upper_bound(prefix.begin(), prefix.end(), rank) - prefix.begin() - 1;
+  const Node &node = nodes[id];
+  rank -= prefix[id];
+  if (!encoding[node.start]) {
+    return voxel_at(node.clipped, rank);
+  }
+  LeafCursor<std::vector<bool>> cursor(
+      encoding, root_node(shape, false), node.clipped, LeafFilter::OCCUPIED,
+      node_key(node.node, node.depth), node.start);
+  Leaf leaf;
+  while (cursor.next(leaf)) {
+    const uint64_t size = volume(leaf.box);
+    if (rank < size) {
+      return voxel_at(leaf.box, rank);
+    }
+    rank -= size;
+  }
+  throw std::runtime_error("Occupancy index does not match the encoding");
+}
+
+Coord PatchSampler::sample_patch(
+    const std::tuple<size_t, size_t, size_t> &patch_shape, uint8_t *out,
+    std::mt19937_64 &rng, double foreground) const {
+  const Coord centre = sample_voxel(rng, foreground);
+  const size_t res[3] = {std::get<0>(shape), std::get<1>(shape),
+                         std::get<2>(shape)};
+  const size_t patch[3] = {std::get<0>(patch_shape), std::get<1>(patch_shape),
+                           std::get<2>(patch_shape)};
+  Coord start;
+  for (int a = 0; a < 3; a++) {
+    const size_t first = centre[a] > patch[a] / 2 ? centre[a] - patch[a] / 2 : 0;
+    start[a] = static_cast<uint32_t>(
+        res[a] > patch[a] ? std::min(first, res[a] - patch[a]) : 0);
+  }
+  decode_region({start[0], start[0] + patch[0], start[1], start[1] + patch[1],
+                 start[2], start[2] + patch[2]},
+                out);
+  return start;
+}
+
+void PatchSampler::decode_region(const Box &region, uint8_t *out) const {
+  const size_t region_shape[3] = {region.xe - region.xs, region.ye - region.ys,
+                                  region.ze - region.zs};
+  ptrdiff_t strides[3];
+  contiguous_strides(region_shape, sizeof(uint8_t), strides);
+  std::memset(out, 0, volume(region));
+  const Box inside = clip(region, std::get<0>(shape), std::get<1>(shape),
+                          std::get<2>(shape));
+  if (0 == volume(inside)) {
+    return;
+  }
+
+  // nodes larger than a cell cover several, so the ids are deduplicated
+  std::vector<uint32_t> ids;
+  for (size_t gx = inside.xs / cell; gx * cell < inside.xe; gx++) {
+    for (size_t gy = inside.ys / cell; gy * cell < inside.ye; gy++) {
+      for (size_t gz = inside.zs / cell; gz * cell < inside.ze; gz++) {
+        ids.push_back(cells[(gx * grid[1] + gy) * grid[2] + gz]);
+      }
+    }
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+  const auto fill = [&](const Box &box) {
+    fill_strided(out, strides,
+                 {box.xs - region.xs, box.xe - region.xs, box.ys - region.ys,
+                  box.ye - region.ys, box.zs - region.zs, box.ze - region.zs},
+                 uint8_t(1));
+  };
+  for (const uint32_t id : ids) {
+    const Node &node = nodes[id];
+    const Box part = intersect(node.clipped, inside);
+    if (0 == node.occupied || 0 == volume(part)) {
+      continue;
+    }
+    if (!encoding[node.start]) {
+      fill(part);
+      continue;
+    }
+    LeafCursor<std::vector<bool>>(encoding, root_node(shape, false), part,
+                                  LeafFilter::OCCUPIED,
+                                  node_key(node.node, node.depth), node.start)
+        .run([&](const Leaf &leaf) {
+          fill(leaf.box);
+          return true;
+        });
+  }
+}
+
+} // namespace otbv
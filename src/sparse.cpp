@@ -0,0 +1,247 @@
+#include "sparse.h"
+#include "conversion.h"
+#include "morton.h"
+#include "points.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace otbv {
+
+std::vector<bool>
+encode_from_boxes(std::vector<Box> boxes,
+                  const std::tuple<size_t, size_t, size_t> &resolution) {
+  check_resolution(resolution);
+  const size_t x_res = std::get<0>(resolution), y_res = std::get<1>(resolution),
+               z_res = std::get<2>(resolution);
+  std::vector<bool> out;
+  // pieces of the boxes within the node open at every level, reused across
+  // siblings
+  std::vector<std::vector<Box>> pieces(RECURSION_MAX_DEPTH + 1);
+  pieces[0] = std::move(boxes);
+  NodeWalk(max_res_pow2_roof(resolution))
+      .run([&](const NodeKey &key, const Box &node) {
+        std::vector<Box> &inside = pieces[key.depth];
+        if (key.depth) {
+          inside.clear();
+          for (const Box &box : pieces[key.depth - 1]) {
+            const Box piece = intersect(box, node);
+            if (volume(piece)) {
+              inside.push_back(piece);
+            }
+          }
+        }
+        size_t covered = 0;
+        for (const Box &box : inside) {
+          covered += volume(box);
+        }
+        if (0 == covered ||
+            volume(clip(node, x_res, y_res, z_res)) == covered) {
+          // leaf
+          out.push_back(0);
+          out.push_back(0 != covered);
+          return Step::NEXT;
+        }
+        out.push_back(1);
+        return Step::DESCEND;
+      });
+  return out;
+}
+
+void BoxBuilder::add_run(size_t x, size_t y, size_t zs, size_t ze) {
+  if (has_row && (x != row_x || y != row_y)) {
+    end_row();
+    if (x != row_x) {
+      end_plane();
+    }
+  }
+  row_x = x;
+  row_y = y;
+  has_row = true;
+  row.push_back({x, x + 1, y, y + 1, zs, ze});
+}
+
+void BoxBuilder::end_row() {
+  // both lists are sorted by zs, so matching runs are found in one pass
+  std::vector<Box> next;
+  next.reserve(row.size());
+  size_t i = 0;
+  for (const Box &run : row) {
+    while (i < plane_open.size() && plane_open[i].zs < run.zs) {
+      plane_closed.push_back(plane_open[i++]);
+    }
+    if (i < plane_open.size() && plane_open[i].zs == run.zs &&
+        plane_open[i].ze == run.ze && plane_open[i].ye == run.ys) {
+      Box grown = plane_open[i++];
+      grown.ye = run.ye;
+      next.push_back(grown);
+    } else {
+      next.push_back(run);
+    }
+  }
+  plane_closed.insert(plane_closed.end(), plane_open.begin() + i,
+                      plane_open.end());
+  plane_open.swap(next);
+  row.clear();
+}
+
+void BoxBuilder::end_plane() {
+  plane_closed.insert(plane_closed.end(), plane_open.begin(),
+                      plane_open.end());
+  plane_open.clear();
+  const auto key = [](const Box &box) {
+    return std::tie(box.ys, box.zs, box.ye, box.ze);
+  };
+  std::sort(
+      plane_closed.begin(), plane_closed.end(),
+      [&](const Box &a, const Box &b) { return key(a) < key(b); });
+
+  std::vector<Box> next;
+  next.reserve(plane_closed.size());
+  size_t i = 0, j = 0;
+  while (i < volume_open.size() || j < plane_closed.size()) {
+    if (j == plane_closed.size() ||
+        (i < volume_open.size() && key(volume_open[i]) < key(plane_closed[j]))) {
+      boxes.push_back(volume_open[i++]);
+    } else if (i == volume_open.size() ||
+               key(plane_closed[j]) < key(volume_open[i])) {
+      next.push_back(plane_closed[j++]);
+    } else if (volume_open[i].xe == plane_closed[j].xs) {
+      Box grown = volume_open[i++];
+      grown.xe = plane_closed[j++].xe;
+      next.push_back(grown);
+    } else {
+      boxes.push_back(volume_open[i++]);
+      next.push_back(plane_closed[j++]);
+    }
+  }
+  volume_open.swap(next);
+  plane_closed.clear();
+}
+
+std::vector<Box> BoxBuilder::finish() {
+  if (has_row) {
+    end_row();
+    end_plane();
+  }
+  boxes.insert(boxes.end(), volume_open.begin(), volume_open.end());
+  std::vector<Box> out;
+  out.swap(boxes);
+  volume_open.clear();
+  has_row = false;
+  return out;
+}
+
+std::vector<bool>
+encode_from_coords(const std::vector<Coord> &coords,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   size_t threads) {
+  check_resolution(resolution);
+  std::vector<uint64_t> keys;
+  keys.reserve(coords.size());
+  for (const Coord &coord : coords) {
+    if (coord[0] >= std::get<0>(resolution) ||
+        coord[1] >= std::get<1>(resolution) ||
+        coord[2] >= std::get<2>(resolution)) {
+      throw std::invalid_argument(
+          "Provided coordinates lie outside of the volume");
+    }
+    keys.push_back(morton_encode(coord[0], coord[1], coord[2]));
+  }
+  sort_unique_keys(keys, threads);
+  return encode_sorted_keys(keys, resolution);
+}
+
+std::vector<bool>
+encode_from_runs(const std::vector<Run> &runs,
+                 const std::tuple<size_t, size_t, size_t> &resolution) {
+  check_resolution(resolution);
+  std::vector<Run> sorted;
+  sorted.reserve(runs.size());
+  for (const Run &run : runs) {
+    if (run.x >= std::get<0>(resolution) || run.y >= std::get<1>(resolution) ||
+        run.z_end > std::get<2>(resolution) || run.z_start > run.z_end) {
+      throw std::invalid_argument("Provided run lies outside of the volume");
+    }
+    if (run.z_start < run.z_end) {
+      sorted.push_back(run);
+    }
+  }
+  std::sort(sorted.begin(), sorted.end(), [](const Run &a, const Run &b) {
+    return std::tie(a.x, a.y, a.z_start) < std::tie(b.x, b.y, b.z_start);
+  });
+
+  // merge overlapping runs, so that the boxes are disjoint
+  std::vector<Box> boxes;
+  boxes.reserve(sorted.size());
+  for (const Run &run : sorted) {
+    if (!boxes.empty() && boxes.back().xs == run.x &&
+        boxes.back().ys == run.y && boxes.back().ze >= run.z_start) {
+      boxes.back().ze = std::max<size_t>(boxes.back().ze, run.z_end);
+      continue;
+    }
+    boxes.push_back(
+        {run.x, run.x + 1u, run.y, run.y + 1u, run.z_start, run.z_end});
+  }
+  return encode_from_boxes(std::move(boxes), resolution);
+}
+
+std::vector<Coord>
+decode_to_coords(const std::vector<bool> &encoding,
+                 const std::tuple<size_t, size_t, size_t> &resolution) {
+  std::vector<Coord> out;
+  visit_leaves(
+      encoding, resolution, LeafFilter::OCCUPIED, [&](const Leaf &leaf) {
+        const Box &box = leaf.box;
+        for (size_t x = box.xs; x < box.xe; x++) {
+          for (size_t y = box.ys; y < box.ye; y++) {
+            for (size_t z = box.zs; z < box.ze; z++) {
+              out.push_back({static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+                             static_cast<uint32_t>(z)});
+            }
+          }
+        }
+      });
+  return out;
+}
+
+std::vector<Run>
+decode_to_runs(const std::vector<bool> &encoding,
+               const std::tuple<size_t, size_t, size_t> &resolution) {
+  std::vector<Run> pieces;
+  visit_leaves(
+      encoding, resolution, LeafFilter::OCCUPIED, [&](const Leaf &leaf) {
+        const Box &box = leaf.box;
+        for (size_t x = box.xs; x < box.xe; x++) {
+          for (size_t y = box.ys; y < box.ye; y++) {
+            pieces.push_back(
+                {static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+                 static_cast<uint32_t>(box.zs), static_cast<uint32_t>(box.ze)});
+          }
+        }
+      });
+  std::sort(pieces.begin(), pieces.end(), [](const Run &a, const Run &b) {
+    return std::tie(a.x, a.y, a.z_start) < std::tie(b.x, b.y, b.z_start);
+  });
+
+  // leaves are disjoint, so only touching pieces need joining
+  std::vector<Run> out;
+  for (const Run &piece : pieces) {
+    if (!out.empty() && out.back().x == piece.x && out.back().y == piece.y &&
+        out.back().z_end == piece.z_start) {
+      out.back().z_end = piece.z_end;
+      continue;
+    }
+    out.push_back(piece);
+  }
+  return out;
+}
+
+} // namespace otbv
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../include/otbv.h"
+
+#include <cstddef>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+/**
+ * @brief Encodes a volume of shape \p resolution from disjoint boxes of
+ * occupied voxels
+ */
+std::vector<bool>
+encode_from_boxes(std::vector<Box> boxes,
+                  const std::tuple<size_t, size_t, size_t> &resolution);
+
+/**
+ * @brief Merges runs of occupied voxels, streamed in C order, into few
+ * disjoint boxes. Runs repeated on consecutive rows grow into rectangles, and
+ * rectangles repeated on consecutive planes grow into boxes, so memory scales
+ * with the surface of the volume rather than with its size.
+ */
+class BoxBuilder {
+public:
+  /**
+   * @brief Adds the run [\p zs, \p ze) of row \p x, \p y. Runs must come
+   * ordered by x, then y, then zs, and must not overlap.
+   */
+  void add_run(size_t x, size_t y, size_t zs, size_t ze);
+
+  /**
+   * @brief Returns disjoint boxes covering every run added so far, and resets
+   * the builder
+   */
+  std::vector<Box> finish();
+
+private:
+  void end_row();
+  void end_plane();
+
+  size_t row_x = 0, row_y = 0;
+  bool has_row = false;
+  // runs of the current row
+  std::vector<Box> row;
+  // rectangles of the current plane that may still grow along y, by zs
+  std::vector<Box> plane_open;
+  std::vector<Box> plane_closed;
+  // boxes that may still grow along x, by ys, zs, ye, ze
+  std::vector<Box> volume_open;
+  std::vector<Box> boxes;
+};
+
+} // namespace otbv
@@ -0,0 +1,276 @@
+#pragma once
+
+#include "../include/otbv.h"
+#include "bits.h"
+#include "canonical.h"
+#include "conversion.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+/**
+ * @brief Returns the byte offset of voxel x, y, z given byte strides \p
+ * strides, which may be negative
+ */
+inline ptrdiff_t offset(const ptrdiff_t strides[3], size_t x, size_t y,
+                        size_t z) {
+  return static_cast<ptrdiff_t>(x) * strides[0] +
+         static_cast<ptrdiff_t>(y) * strides[1] +
+         static_cast<ptrdiff_t>(z) * strides[2];
+}
+
+/**
+ * @brief Read-only view of a volume of \p T elements laid out with arbitrary
+ * byte strides. A voxel is occupied if its element is above \p threshold.
+ */
+template <typename T> struct StridedVolume {
+  const uint8_t *data;
+  size_t shape[3];
+  ptrdiff_t strides[3];
+  T threshold;
+
+  bool operator()(size_t x, size_t y, size_t z) const {
+    T value;
+    std::memcpy(&value, data + offset(strides, x, y, z), sizeof(T));
+    return value > threshold;
+  }
+
+  std::tuple<size_t, size_t, size_t> resolution() const {
+    return {shape[0], shape[1], shape[2]};
+  }
+};
+
+/**
+ * @brief Returns C-order byte strides for a volume of \p shape and elements of
+ * \p element_size bytes
+ */
+inline void contiguous_strides(const size_t shape[3], size_t element_size,
+                               ptrdiff_t strides[3]) {
+  strides[2] = element_size;
+  strides[1] = shape[2] * strides[2];
+  strides[0] = shape[1] * strides[1];
+}
+
+/**
+ * @brief Returns Fortran-order byte strides, x fastest, for a volume of \p
+ * shape and elements of \p element_size bytes
+ */
+inline void fortran_strides(const size_t shape[3], size_t element_size,
+                            ptrdiff_t strides[3]) {
+  strides[0] = element_size;
+  strides[1] = shape[0] * strides[0];
+  strides[2] = shape[1] * strides[1];
+}
+
+/**
+ * @brief Encodes \p volume_view, any callable returning the value of voxel x,
+ * y, z, of shape \p resolution, bottom-up. Nothing is copied or padded, and
+ * every voxel is read exactly once.
+ */
+template <typename Volume>
+std::vector<bool>
+encode_view(const Volume &volume_view,
+            const std::tuple<size_t, size_t, size_t> &resolution) {
+  check_resolution(resolution);
+  const size_t x_res = std::get<0>(resolution), y_res = std::get<1>(resolution),
+               z_res = std::get<2>(resolution);
+  std::vector<bool> out;
+  // start and padding children of the split node open at every level
+  std::array<size_t, RECURSION_MAX_DEPTH + 1> starts;
+  std::array<uint8_t, RECURSION_MAX_DEPTH + 1> paddings;
+  NodeWalk(max_res_pow2_roof(resolution))
+      .run(
+          [&](const NodeKey &key, const Box &node) {
+            if (0 == volume(clip(node, x_res, y_res, z_res))) {
+              out.push_back(0);
+              out.push_back(0);
+              return Step::NEXT;
+            }
+            if (1 == node.xe - node.xs) {
+              // leaf
+              out.push_back(0);
+              out.push_back(volume_view(node.xs, node.ys, node.zs));
+              return Step::NEXT;
+            }
+            starts[key.depth] = out.size();
+            paddings[key.depth] = padding_children(node, x_res, y_res, z_res);
+            out.push_back(1);
+            return Step::DESCEND;
+          },
+          [&](const NodeKey &key) {
+            // children are encoded first, and collapsed if they are uniform
+            collapse_uniform_children(out, starts[key.depth],
+                                      paddings[key.depth]);
+          });
+  return out;
+}
+
+/**
+ * @brief Sets every element of \p box in \p out, laid out with byte strides
+ * \p strides from the byte \p base on, to \p value. Contiguous rows are
+ * filled in one go.
+ */
+template <typename T>
+void fill_strided(uint8_t *out, const ptrdiff_t strides[3], const Box &box,
+                  const T value, const ptrdiff_t base = 0) {
+  const size_t row = box.ze - box.zs;
+  for (size_t x = box.xs; x < box.xe; x++) {
+    for (size_t y = box.ys; y < box.ye; y++) {
+      uint8_t *first = out + (base + offset(strides, x, y, box.zs));
+      if (static_cast<ptrdiff_t>(sizeof(T)) == strides[2] &&
+          0 == reinterpret_cast<uintptr_t>(first) % alignof(T)) {
+        std::fill_n(reinterpret_cast<T *>(first), row, value);
+        continue;
+      }
+      for (size_t z = 0; z < row; z++) {
+        std::memcpy(first + z * strides[2], &value, sizeof(T));
+      }
+    }
+  }
+}
+
+/**
+ * @brief Destination of \p decode_strided. Voxel x, y, z of the tree, if it
+ * lies within \p bounds, goes to the byte \p base + offset(\p strides, x, y,
+ * z) of \p out. \p blend selects the leaves that are written.
+ */
+struct DecodeTarget {
+  uint8_t *out;
+  ptrdiff_t base;
+  ptrdiff_t strides[3];
+  Box bounds;
+  Blend blend;
+};
+
+/**
+ * @brief Returns whether a leaf of value \p value is written with \p blend
+ */
+inline bool blend_writes(const Blend blend, const bool value) {
+  return Blend::OVERWRITE == blend || (Blend::OR == blend) == value;
+}
+
+/**
+ * @brief Helper function. Writes the 8 single voxels of the bottom-level node
+ * \p node to \p target. \p tokens holds their 8 leaves, the first in the most
+ * significant place.
+ */
+template <typename T>
+void fill_bottom_node(const DecodeTarget &target, const Box &node,
+                      const uint32_t tokens, const T on_value,
+                      const T off_value) {
+  const T values[2] = {off_value, on_value};
+  const Box &bounds = target.bounds;
+  const bool inside = node.xs >= bounds.xs && node.xe <= bounds.xe &&
+                      node.ys >= bounds.ys && node.ye <= bounds.ye &&
+                      node.zs >= bounds.zs && node.ze <= bounds.ze;
+  for (size_t i = 0; i < 8; i++) {
+    const bool value = (tokens >> (14 - 2 * i)) & 1;
+    const size_t x = node.xs + (i >> 2), y = node.ys + ((i >> 1) & 1),
+                 z = node.zs + (i & 1);
+    if (blend_writes(target.blend, value) &&
+        (inside || (x >= bounds.xs && x < bounds.xe && y >= bounds.ys &&
+                    y < bounds.ye && z >= bounds.zs && z < bounds.ze))) {
+      std::memcpy(target.out +
+                      (target.base + offset(target.strides, x, y, z)),
+                  &values[value], sizeof(T));
+    }
+  }
+}
+
+/**
+ * @brief Decodes the leaves of \p bits, a volume of shape \p resolution, that
+ * overlap the bounds of \p target straight into it, writing \p on_value or \p
+ * off_value. \p anisotropic selects the layout of the tree.
+ *
+ * Trees of both layouts are walked with a \ref NodeWalk, skipping subtrees
+ * outside of the bounds, such as the padding. Nodes of 2x2x2 voxels, where
+ * most leaves of detailed volumes lie, are read as one window of 17 tokens
+ * and written without visiting their leaves one by one.
+ *
+ * @throws std::out_of_range If the encoding ends early
+ * @throws std::runtime_error If the tree is malformed or too deep
+ */
+template <typename Bits, typename T>
+void decode_strided(const Bits &bits,
+                    const std::tuple<size_t, size_t, size_t> &resolution,
+                    const DecodeTarget &target, const T on_value,
+                    const T off_value, bool anisotropic = false) {
+  const Box &bounds = target.bounds;
+  const auto write_leaf = [&](const Box &box, const bool value) {
+    if (blend_writes(target.blend, value)) {
+      fill_strided(target.out, target.strides, box,
+                   value ? on_value : off_value, target.base);
+    }
+  };
+  size_t idx = 0;
+  NodeWalk(root_node(resolution, anisotropic))
+      .run([&](const NodeKey &, const Box &node) {
+        if (idx + 1 >= bits.size()) {
+          throw std::out_of_range("Unexpected end of the encoding");
+        }
+        const size_t side = node.xe - node.xs;
+        if (!bits[idx]) {
+          const Box clipped = intersect(node, bounds);
+          if (volume(clipped)) {
+            write_leaf(clipped, bits[idx + 1]);
+          }
+          idx += 2;
+          return Step::NEXT;
+        }
+        if (volume(node) < 2) {
+          throw std::runtime_error("A node is split below the size of a "
+                                   "voxel. The data is likely malformed.");
+        }
+        if (0 == volume(intersect(node, bounds))) {
+          idx = skip_node(bits, idx);
+          return Step::NEXT;
+        }
+        // anisotropic nodes of 2x2x2 voxels split into 8 as well
+        if (2 == side && 2 == node.ye - node.ys && 2 == node.ze - node.zs) {
+          if (idx + 17 > bits.size()) {
+            throw std::out_of_range("Unexpected end of the encoding");
+          }
+          const uint32_t tokens =
+              static_cast<uint32_t>(bit_window(bits, idx + 1, 16));
+          if (tokens & 0xaaaa) {
+            throw std::runtime_error("A node is split below the size of a "
+                                     "voxel. The data is likely malformed.");
+          }
+          fill_bottom_node(target, node, tokens, on_value, off_value);
+          idx += 17;
+          return Step::NEXT;
+        }
+        idx++;
+        return Step::DESCEND;
+      });
+}
+
+/**
+ * @brief Overload of \p decode_strided writing every voxel of the volume to \p
+ * out, laid out with byte strides \p strides
+ */
+template <typename Bits, typename T>
+void decode_strided(const Bits &bits,
+                    const std::tuple<size_t, size_t, size_t> &resolution,
+                    uint8_t *out, const ptrdiff_t strides[3], const T on_value,
+                    const T off_value, bool anisotropic = false) {
+  const DecodeTarget target = {out,
+                               0,
+                               {strides[0], strides[1], strides[2]},
+                               {0, std::get<0>(resolution), 0,
+                                std::get<1>(resolution), 0,
+                                std::get<2>(resolution)},
+                               Blend::OVERWRITE};
+  decode_strided(bits, resolution, target, on_value, off_value, anisotropic);
+}
+
+} // namespace otbv
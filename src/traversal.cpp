@@ -0,0 +1,140 @@
+#include "traversal.h"
+#include "bits.h"
+#include "conversion.h"
+#include "io.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+namespace otbv {
+
+// subtrees at this depth are the unit of work of the parallel traversal
+static constexpr size_t PARALLEL_TASK_DEPTH = 2;
+
+struct LeafIterator::Impl {
+  std::tuple<size_t, size_t, size_t> resolution;
+  // declared before the cursor, which points to it
+  PackedBits bits;
+  std::variant<LeafCursor<std::vector<bool>>, LeafCursor<PackedBits>> cursor;
+
+  Impl(const std::vector<bool> &encoding,
+       const std::tuple<size_t, size_t, size_t> &resolution, LeafFilter filter)
+      : resolution(resolution), bits{},
+        cursor(make_leaf_cursor(encoding, resolution, filter)) {}
+
+  Impl(const PackedBits &packed,
+       const std::tuple<size_t, size_t, size_t> &resolution, LeafFilter filter,
+       bool anisotropic)
+      : resolution(resolution), bits(packed),
+        cursor(make_leaf_cursor(bits, resolution, filter, anisotropic)) {}
+};
+
+LeafIterator::LeafIterator(const std::vector<bool> &encoding,
+                           const std::tuple<size_t, size_t, size_t> &resolution,
+                           LeafFilter filter)
+    : impl(new Impl(encoding, resolution, filter)) {}
+
+LeafIterator::LeafIterator(const char *file_bytes, size_t length,
+                           LeafFilter filter) {
+  const Header header = parse_header(file_bytes, length);
+  require_single_channel(header);
+  impl.reset(new Impl(data_bits(file_bytes + header.data_offset, header),
+                      {header.x_res, header.y_res, header.z_res}, filter,
+                      header.anisotropic));
+}
+
+LeafIterator::LeafIterator(LeafIterator &&) noexcept = default;
+LeafIterator &LeafIterator::operator=(LeafIterator &&) noexcept = default;
+LeafIterator::~LeafIterator() = default;
+
+bool LeafIterator::next(Leaf &leaf) {
+  return std::visit([&](auto &cursor) { return cursor.next(leaf); },
+                    impl->cursor);
+}
+
+std::tuple<size_t, size_t, size_t> LeafIterator::resolution() const {
+  return impl->resolution;
+}
+
+void for_each_leaf(const std::vector<bool> &encoding,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   const LeafVisitor &visitor, LeafFilter filter) {
+  visit_leaves(encoding, resolution, filter, visitor);
+}
+
+void for_each_leaf(const char *file_bytes, size_t length,
+                   const LeafVisitor &visitor, LeafFilter filter) {
+  const Header header = parse_header(file_bytes, length);
+  require_single_channel(header);
+  visit_leaves(data_bits(file_bytes + header.data_offset, header),
+               {header.x_res, header.y_res, header.z_res}, filter, visitor,
+               header.anisotropic);
+}
+
+namespace {
+struct SubtreeTask {
+  size_t start;
+  Box node;
+  NodeKey key;
+};
+} // namespace
+
+/**
+ * @brief Helper function. Splits \p encoding, a tree of side \p side, into
+ * subtrees of depth \p PARALLEL_TASK_DEPTH, or shallower leaves
+ */
+static std::vector<SubtreeTask>
+collect_subtrees(const std::vector<bool> &encoding, const size_t side) {
+  std::vector<SubtreeTask> tasks;
+  size_t idx = 0;
+  NodeWalk(side).run([&](const NodeKey &key, const Box &node) {
+    if (idx >= encoding.size()) {
+      throw std::out_of_range("Unexpected end of the encoding");
+    }
+    if (PARALLEL_TASK_DEPTH == key.depth || !encoding[idx]) {
+      tasks.push_back({idx, node, key});
+      idx = skip_node(encoding, idx);
+      return Step::NEXT;
+    }
+    idx++;
+    return Step::DESCEND;
+  });
+  return tasks;
+}
+
+void for_each_leaf_parallel(
+    const std::vector<bool> &encoding,
+    const std::tuple<size_t, size_t, size_t> &resolution,
+    const LeafVisitor &visitor, LeafFilter filter, size_t threads) {
+  const size_t side = max_res_pow2_roof(resolution);
+  const Box tree = {0, side, 0, side, 0, side};
+  const Box bounds = {0, std::get<0>(resolution), 0, std::get<1>(resolution),
+                      0, std::get<2>(resolution)};
+  const std::vector<SubtreeTask> tasks = collect_subtrees(encoding, side);
+
+  std::atomic<size_t> next_task{0};
+  run_workers(std::min(resolve_threads(threads), tasks.size()),
+              [&](size_t) {
+                for (size_t t = next_task++; t < tasks.size();
+                     t = next_task++) {
+                  const SubtreeTask &task = tasks[t];
+                  if (0 == volume(intersect(task.node, bounds))) {
+                    continue;
+                  }
+                  LeafCursor<std::vector<bool>>(encoding, tree, bounds, filter,
+                                                task.key, task.start)
+                      .run([&](const Leaf &leaf) {
+                        visitor(leaf);
+                        return true;
+                      });
+                }
+              });
+}
+
+} // namespace otbv
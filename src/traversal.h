@@ -0,0 +1,471 @@
+#pragma once
+
+#include "../include/otbv.h"
+#include "conversion.h"
+#include "morton.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+/**
+ * @brief Returns the \p i-th child of the cubic node \p node, in encoding
+ * order (x, then y, then z)
+ */
+inline Box child_box(const Box &node, const size_t i) {
+  const size_t half = (node.xe - node.xs) >> 1;
+  const size_t x = node.xs + ((i >> 2) & 1) * half,
+               y = node.ys + ((i >> 1) & 1) * half, z = node.zs + (i & 1) * half;
+  return {x, x + half, y, y + half, z, z + half};
+}
+
+/**
+ * @brief Returns the axes \p node is split along, as a mask of 4 (x), 2 (y)
+ * and 1 (z): its longest axes. Cubes are split along all three, and so are
+ * single voxels, which a well formed tree never splits.
+ */
+inline uint8_t split_axes(const Box &node) {
+  const size_t x = node.xe - node.xs, y = node.ye - node.ys,
+               z = node.ze - node.zs;
+  const size_t longest = std::max(x, std::max(y, z));
+  if (longest < 2) {
+    return 7;
+  }
+  return (x == longest) << 2 | (y == longest) << 1 | (z == longest);
+}
+
+/**
+ * @brief Returns the number of children of a node split along \p axes
+ */
+inline size_t split_children(const uint8_t axes) {
+  return size_t(1) << ((axes & 1) + ((axes >> 1) & 1) + ((axes >> 2) & 1));
+}
+
+/**
+ * @brief Returns the \p i-th child of \p node split along \p axes, in
+ * encoding order (x, then y, then z). Matches \p child_box for cubes.
+ */
+inline Box split_child(const Box &node, const uint8_t axes, size_t i) {
+  Box child = node;
+  if (axes & 1) {
+    const size_t half = (node.ze - node.zs) >> 1;
+    (i & 1 ? child.zs : child.ze) = node.zs + half;
+    i >>= 1;
+  }
+  if (axes & 2) {
+    const size_t half = (node.ye - node.ys) >> 1;
+    (i & 1 ? child.ys : child.ye) = node.ys + half;
+    i >>= 1;
+  }
+  if (axes & 4) {
+    const size_t half = (node.xe - node.xs) >> 1;
+    (i & 1 ? child.xs : child.xe) = node.xs + half;
+  }
+  return child;
+}
+
+/**
+ * @brief Returns the root node of a tree for a volume of shape \p resolution.
+ * Isotropic trees pad the volume to a cube whose side is a power of two.
+ * Anisotropic trees pad every axis to a power of two of its own, and their
+ * nodes split along their longest axes only, into 2, 4 or 8 children.
+ */
+inline Box root_node(const std::tuple<size_t, size_t, size_t> &resolution,
+                     const bool anisotropic) {
+  if (!anisotropic) {
+    const size_t side = max_res_pow2_roof(resolution);
+    return {0, side, 0, side, 0, side};
+  }
+  return {0, pow2_roof(std::get<0>(resolution)), 0,
+          pow2_roof(std::get<1>(resolution)), 0,
+          pow2_roof(std::get<2>(resolution))};
+}
+
+/**
+ * @brief Node of an octree: the Morton code of its corner in units of its own
+ * side, which is also the path of child indices leading to it, and its depth.
+ * The root is {0, 0}.
+ */
+struct NodeKey {
+  uint64_t prefix;
+  size_t depth;
+};
+
+/**
+ * @brief Returns the box of the node \p key in an octree of side \p side
+ */
+inline Box node_box(const NodeKey &key, const size_t side) {
+  const size_t node_side = side >> key.depth;
+  size_t x, y, z;
+  morton_decode(key.prefix, x, y, z);
+  x *= node_side;
+  y *= node_side;
+  z *= node_side;
+  return {x, x + node_side, y, y + node_side, z, z + node_side};
+}
+
+/**
+ * @brief Returns the key of the cubic node \p node at depth \p depth of an
+ * octree, the inverse of \p node_box
+ */
+inline NodeKey node_key(const Box &node, const size_t depth) {
+  const size_t side = node.xe - node.xs;
+  return {morton_encode(node.xs / side, node.ys / side, node.zs / side),
+          depth};
+}
+
+/**
+ * @brief What a \ref NodeWalk does after visiting a node
+ */
+enum class Step {
+  // visit the children of the node next
+  DESCEND,
+  // move past the node and its children
+  NEXT,
+  // end the walk, to be resumed at the same node
+  STOP
+};
+
+/**
+ * @brief Stackless walk over the nodes of a tree in file order. The whole
+ * state is the key of the current node: its children are found by extending
+ * the prefix, and the next node by incrementing it, after dropping the levels
+ * that are done. A walk can stop at any node and resume later, and the
+ * subtrees of a tree can be walked separately, for example on several
+ * threads. Encoders, decoders and queries of both layouts build on it.
+ *
+ * Every level of the prefix is the 3-bit digit of a child, x, y and z from
+ * the highest bit, as in a Morton code. All the nodes of a level have the
+ * same shape, so the axes they are split along are kept in a table per
+ * depth: anisotropic nodes split into 2 or 4 children only use the digits of
+ * their split axes, and siblings follow each other as the submasks of those
+ * axes. Isotropic keys are plain Morton codes, see \p node_box.
+ */
+class NodeWalk {
+public:
+  /**
+   * @param tree Root node of the whole tree, see \p root_node
+   * @param root Node whose subtree is walked
+   */
+  explicit NodeWalk(const Box &tree, const NodeKey &root = {0, 0})
+      : tree(tree), root(root), key(root) {
+    Box node = tree;
+    Level level = {0, {0, 0, 0}};
+    for (size_t depth = 0; depth <= RECURSION_MAX_DEPTH; depth++) {
+      level.axes = split_axes(node);
+      levels[depth] = level;
+      node = split_child(node, level.axes, 0);
+      level.shifts[0] += (level.axes >> 2) & 1;
+      level.shifts[1] += (level.axes >> 1) & 1;
+      level.shifts[2] += level.axes & 1;
+    }
+    at = box(root);
+  }
+
+  /**
+   * @param side Side of the root of a whole isotropic tree, a power of 2
+   * @param root Node whose subtree is walked
+   */
+  explicit NodeWalk(const size_t side, const NodeKey &root = {0, 0})
+      : NodeWalk(Box{0, side, 0, side, 0, side}, root) {}
+
+  /**
+   * @brief Walk of the subtree \p root of the tree \p tree walks, reusing
+   * its tables, for walks started often
+   */
+  NodeWalk(const NodeWalk &tree, const NodeKey &root)
+      : tree(tree.tree), root(root), key(root), levels(tree.levels) {
+    at = box(root);
+  }
+
+  /**
+   * @brief Calls \p visit with the key and box of every node, until it
+   * returns \p Step::STOP or the subtree is done. \p leave is called with
+   * the key of every split node once its children are done, for encoders
+   * that finish nodes bottom-up.
+   *
+   * @return Whether the subtree is done
+   * @throws std::runtime_error If the walk descends too deep
+   */
+  template <typename Visit, typename Leave>
+  bool run(Visit &&visit, Leave &&leave) {
+    if (done) {
+      return true;
+    }
+    // the box follows the key, so that it is never rebuilt from the prefix
+    NodeKey current = key;
+    Box node = at;
+    for (;;) {
+      const Step step = visit(static_cast<const NodeKey &>(current),
+                              static_cast<const Box &>(node));
+      if (Step::STOP == step) {
+        key = current;
+        at = node;
+        return false;
+      }
+      if (Step::DESCEND == step) {
+        if (current.depth >= RECURSION_MAX_DEPTH) {
+          throw std::runtime_error(
+              "Reached maximum recursion depth while walking the tree. The "
+              "data is likely too large or malformed.");
+        }
+        current = {current.prefix << 3, current.depth + 1};
+        const Extent size = extent(current.depth);
+        node = {node.xs, node.xs + size[0], node.ys, node.ys + size[1],
+                node.zs, node.zs + size[2]};
+        continue;
+      }
+      // the last child of a node, all of its split axes set, finishes it
+      while (current.depth > root.depth &&
+             levels[current.depth - 1].axes == (current.prefix & 7)) {
+        const uint64_t child = current.prefix & 7;
+        const Extent size = extent(current.depth);
+        current = {current.prefix >> 3, current.depth - 1};
+        node.xs -= ((child >> 2) & 1) * size[0];
+        node.ys -= ((child >> 1) & 1) * size[1];
+        node.zs -= (child & 1) * size[2];
+        const Extent parent = extent(current.depth);
+        node.xe = node.xs + parent[0];
+        node.ye = node.ys + parent[1];
+        node.ze = node.zs + parent[2];
+        leave(static_cast<const NodeKey &>(current));
+      }
+      if (current.depth == root.depth) {
+        break;
+      }
+      // the next sibling is the next submask of the split axes, and differs
+      // in the axes whose bit changes
+      const uint64_t split = levels[current.depth - 1].axes,
+                     child = current.prefix & 7,
+                     next = (child - split) & split;
+      current.prefix += next - child;
+      const Extent size = extent(current.depth);
+      node.xs += (((next >> 2) & 1) - ((child >> 2) & 1)) * size[0];
+      node.ys += (((next >> 1) & 1) - ((child >> 1) & 1)) * size[1];
+      node.zs += ((next & 1) - (child & 1)) * size[2];
+      node.xe = node.xs + size[0];
+      node.ye = node.ys + size[1];
+      node.ze = node.zs + size[2];
+    }
+    key = current;
+    at = node;
+    done = true;
+    return true;
+  }
+
+  /**
+   * @brief Overload of \p run for walks that need nothing when leaving nodes
+   */
+  template <typename Visit> bool run(Visit &&visit) {
+    return run(visit, [](const NodeKey &) {});
+  }
+
+  /**
+   * @brief Returns the node the walk is at, where a stopped walk resumes
+   */
+  const NodeKey &position() const { return key; }
+
+  /**
+   * @brief Returns the box of the node \p node of the tree
+   */
+  Box box(const NodeKey &node) const {
+    const Extent size = extent(node.depth);
+    size_t x = tree.xs, y = tree.ys, z = tree.zs;
+    for (size_t depth = 1; depth <= node.depth; depth++) {
+      const uint64_t digit = node.prefix >> 3 * (node.depth - depth);
+      const Extent child = extent(depth);
+      x += ((digit >> 2) & 1) * child[0];
+      y += ((digit >> 1) & 1) * child[1];
+      z += (digit & 1) * child[2];
+    }
+    return {x, x + size[0], y, y + size[1], z, z + size[2]};
+  }
+
+private:
+  using Extent = std::array<size_t, 3>;
+
+  // the axes the nodes of a depth are split along, and how many times the
+  // root was halved along each axis to reach them
+  struct Level {
+    uint8_t axes;
+    uint8_t shifts[3];
+  };
+
+  Extent extent(const size_t depth) const {
+    const Level &level = levels[depth];
+    return {(tree.xe - tree.xs) >> level.shifts[0],
+            (tree.ye - tree.ys) >> level.shifts[1],
+            (tree.ze - tree.zs) >> level.shifts[2]};
+  }
+
+  Box tree;
+  NodeKey root, key;
+  // box of the current node
+  Box at;
+  std::array<Level, RECURSION_MAX_DEPTH + 1> levels;
+  bool done = false;
+};
+
+/**
+ * @brief Returns the index past the end of the node starting at \p idx,
+ * without visiting its leaves
+ *
+ * @throws std::out_of_range If the encoding ends early
+ */
+template <typename Bits> size_t skip_node(const Bits &bits, size_t idx) {
+  // number of nodes still to be read
+  size_t pending = 1;
+  while (pending) {
+    if (idx >= bits.size()) {
+      throw std::out_of_range("Unexpected end of the encoding");
+    }
+    if (bits[idx]) {
+      pending += 7;
+      idx++;
+    } else {
+      pending--;
+      idx += 2;
+    }
+  }
+  if (idx > bits.size()) {
+    throw std::out_of_range("Unexpected end of the encoding");
+  }
+  return idx;
+}
+
+/**
+ * @brief Pull-style walk over the leaves of an encoding, in file order, on
+ * top of a \ref NodeWalk. Subtrees outside of the bounds are skipped without
+ * visiting their nodes.
+ *
+ * @tparam Bits std::vector<bool>, \ref PackedBits, or anything else indexable
+ * with a \p size()
+ */
+template <typename Bits> class LeafCursor {
+public:
+  /**
+   * @param tree Root node of the whole tree, see \p root_node
+   * @param bounds Leaves are clipped to \p bounds, and skipped when they lie
+   * outside of it
+   * @param root Node whose subtree is walked, described by the token at \p
+   * start
+   */
+  LeafCursor(const Bits &bits, const Box &tree, const Box &bounds,
+             LeafFilter filter, const NodeKey &root = {0, 0},
+             size_t start = 0)
+      : bits(&bits), bounds(bounds), filter(filter), idx(start),
+        walk(tree, root) {}
+
+  /**
+   * @brief Advances to the next leaf that passes the filter
+   *
+   * @return false once the node has been fully walked
+   * @throws std::out_of_range If the encoding ends early
+   */
+  bool next(Leaf &leaf) {
+    bool found = false;
+    run([&](const Leaf &next) {
+      leaf = next;
+      found = true;
+      return false;
+    });
+    return found;
+  }
+
+  /**
+   * @brief Calls \p visit with every remaining leaf that passes the filter,
+   * until it returns false
+   *
+   * @throws std::out_of_range If the encoding ends early
+   */
+  template <typename Visit> void run(Visit &&visit) {
+    walk.run([&](const NodeKey &key, const Box &node) {
+      // a stopped walk resumes at the leaf it stopped at
+      if (stopped) {
+        stopped = false;
+        return Step::NEXT;
+      }
+      if (idx >= bits->size()) {
+        throw std::out_of_range("Unexpected end of the encoding");
+      }
+      if ((*bits)[idx]) {
+        if (0 == volume(intersect(node, bounds))) {
+          idx = skip_node(*bits, idx);
+          return Step::NEXT;
+        }
+        idx++;
+        return Step::DESCEND;
+      }
+      if (idx + 1 >= bits->size()) {
+        throw std::out_of_range("Unexpected end of the encoding");
+      }
+      const bool value = (*bits)[idx + 1];
+      idx += 2;
+      if (!value && LeafFilter::OCCUPIED == filter) {
+        return Step::NEXT;
+      }
+      const Box clipped = intersect(node, bounds);
+      if (0 == volume(clipped) || visit(Leaf{clipped, value, key.depth})) {
+        return Step::NEXT;
+      }
+      stopped = true;
+      return Step::STOP;
+    });
+  }
+
+  /**
+   * @brief Returns the index of the next unread token
+   */
+  size_t position() const { return idx; }
+
+private:
+  const Bits *bits;
+  Box bounds;
+  LeafFilter filter;
+  size_t idx;
+  NodeWalk walk;
+  bool stopped = false;
+};
+
+/**
+ * @brief Returns a \ref LeafCursor over the whole tree in \p bits, with leaves
+ * clipped to \p resolution
+ *
+ * @param anisotropic Whether the tree has the anisotropic layout, see \p
+ * root_node
+ */
+template <typename Bits>
+LeafCursor<Bits>
+make_leaf_cursor(const Bits &bits,
+                 const std::tuple<size_t, size_t, size_t> &resolution,
+                 LeafFilter filter, bool anisotropic = false) {
+  return LeafCursor<Bits>(bits, root_node(resolution, anisotropic),
+                          {0, std::get<0>(resolution), 0,
+                           std::get<1>(resolution), 0,
+                           std::get<2>(resolution)},
+                          filter);
+}
+
+/**
+ * @brief Calls \p visitor with every leaf of \p bits that passes \p filter,
+ * clipped to \p resolution, in file order
+ */
+template <typename Bits, typename Visitor>
+void visit_leaves(const Bits &bits,
+                  const std::tuple<size_t, size_t, size_t> &resolution,
+                  LeafFilter filter, Visitor &&visitor,
+                  bool anisotropic = false) {
+  make_leaf_cursor(bits, resolution, filter, anisotropic)
+      .run([&](const Leaf &leaf) {
+        visitor(leaf);
+        return true;
+      });
+}
+
+} // namespace otbv
@@ -0,0 +1,62 @@
+#include "validate.h"
+#include "../include/otbv.h"
+#include "io.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace otbv {
+
+// metadata bits not assigned to any field
+static constexpr uint8_t RESERVED_META_BITS = 0x08;
+
+void validate(const std::vector<bool> &encoding,
+              const std::tuple<size_t, size_t, size_t> &resolution) {
+  validate_bits(encoding, resolution);
+}
+
+void validate(const char *file_bytes, size_t length) {
+  const Header header = parse_header(file_bytes, length);
+  const std::tuple<size_t, size_t, size_t> resolution = {
+      header.x_res, header.y_res, header.z_res};
+  if (0 == header.x_res || 0 == header.y_res || 0 == header.z_res) {
+    throw std::runtime_error("The header declares an empty volume.");
+  }
+  const uint8_t meta = static_cast<uint8_t>(file_bytes[5]);
+  if (meta & RESERVED_META_BITS) {
+    throw std::runtime_error("The header sets reserved metadata bits.");
+  }
+  if (header.anisotropic && header.channels > 1) {
+    throw std::runtime_error(
+        "Multi-channel trees do not support the anisotropic layout.");
+  }
+  if (header.padded != is_padded(resolution)) {
+    throw std::runtime_error(
+        "The padded flag of the header does not match its resolution.");
+  }
+  if (!header.padded) {
+    for (size_t i = 10; i < 18; i++) {
+      if (file_bytes[i]) {
+        throw std::runtime_error(
+            "The header stores resolutions of an unpadded volume.");
+      }
+    }
+  }
+  if (header.data_offset + header.data_length != length) {
+    throw std::runtime_error("Trailing bytes after the end of the data.");
+  }
+  const char *data = file_bytes + header.data_offset;
+  check_checksum(data, header);
+  const PackedBits bits = data_bits(data, header);
+  if (header.padding_length &&
+      static_cast<uint8_t>(data[0]) >>
+          (8 - header.padding_length)) {
+    throw std::runtime_error("The padding bits are not zero.");
+  }
+  validate_bits(bits, resolution, header.anisotropic, header.channels);
+}
+
+} // namespace otbv
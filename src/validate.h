@@ -0,0 +1,99 @@
+#pragma once
+
+#include "bits.h"
+#include "channels.h"
+#include "conversion.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+
+namespace otbv {
+
+/**
+ * @brief Returns the number of whole leaves in a row starting at \p idx.
+ * Generic version, counting up to the 8 children of a node.
+ */
+template <typename Bits> size_t leaf_run(const Bits &bits, size_t idx) {
+  size_t run = 0;
+  for (; run < 8 && idx + 1 < bits.size() && !bits[idx]; idx += 2) {
+    run++;
+  }
+  return run;
+}
+
+/**
+ * @brief Overload of \p leaf_run reading 64 bits at once. Leaf tokens start
+ * on even offsets from \p idx, so the run ends at the first set even bit.
+ */
+inline size_t leaf_run(const PackedBits &bits, const size_t idx) {
+  const size_t available = bits.count - idx;
+  const size_t count = std::min<size_t>(64, available);
+  // bits past the end read as empty leaves, so they are cut off below
+  const uint64_t window = bit_window(bits, idx, count) << (64 - count);
+  const uint64_t splits = window & 0xaaaaaaaaaaaaaaaaULL;
+  const size_t run = splits ? __builtin_clzll(splits) / 2 : 32;
+  return std::min(run, available / 2);
+}
+
+/**
+ * @brief Checks that \p bits holds exactly one well formed tree for a volume
+ * of shape \p resolution, without decoding it: every split has all its
+ * children, no split goes below single voxels, and nothing follows the tree.
+ * Walks the tree with a \ref NodeWalk, reading splits whose children are all
+ * leaves at once.
+ *
+ * @tparam Bits std::vector<bool>, \ref PackedBits, or anything else indexable
+ * with a \p size()
+ * @param anisotropic Whether the tree has the anisotropic layout, see \p
+ * root_node
+ * @param channels Number of channels of the tree, see \p walk_channels.
+ * Multi-channel trees are walked node by node, with the usual layout.
+ * @throws std::out_of_range If the encoding ends early
+ * @throws std::runtime_error If the tree is too deep or followed by data
+ */
+template <typename Bits>
+void validate_bits(const Bits &bits,
+                   const std::tuple<size_t, size_t, size_t> &resolution,
+                   bool anisotropic = false, size_t channels = 1) {
+  if (channels > 1) {
+    walk_channels(bits, resolution, channels,
+                  [](const Box &, const int8_t *, const int8_t *, bool) {});
+    return;
+  }
+  check_resolution(resolution);
+  size_t idx = 0;
+  NodeWalk(root_node(resolution, anisotropic))
+      .run([&](const NodeKey &, const Box &node) {
+        if (idx >= bits.size()) {
+          throw std::out_of_range("Unexpected end of the encoding");
+        }
+        if (!bits[idx]) {
+          if (idx + 1 >= bits.size()) {
+            throw std::out_of_range("Unexpected end of the encoding");
+          }
+          idx += 2;
+          return Step::NEXT;
+        }
+        if (volume(node) < 2) {
+          throw std::runtime_error(
+              "A node is split below the size of a voxel. The data is likely "
+              "malformed.");
+        }
+        idx++;
+        const size_t children = split_children(split_axes(node));
+        if (idx < bits.size() && leaf_run(bits, idx) >= children) {
+          idx += 2 * children;
+          return Step::NEXT;
+        }
+        return Step::DESCEND;
+      });
+  if (idx != bits.size()) {
+    throw std::runtime_error("Trailing data after the end of the tree.");
+  }
+}
+
+} // namespace otbv
@@ -0,0 +1,125 @@
+#include "../include/otbv.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+static std::vector<char> read_bytes(const std::string &filename) {
+  std::ifstream file_in(filename, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file_in),
+          std::istreambuf_iterator<char>()};
+}
+
+int tests_anisotropic(int argc, char **argv) {
+  const std::string filename = "test_anisotropic.otbv";
+  std::mt19937 rng(6);
+  const std::tuple<size_t, size_t, size_t> shapes[] = {
+      {70, 61, 5}, {3, 90, 6}, {16, 16, 16}, {1, 1, 1}, {9, 2, 33}};
+  for (const auto &resolution : shapes) {
+    const size_t x_res = std::get<0>(resolution),
+                 y_res = std::get<1>(resolution),
+                 z_res = std::get<2>(resolution);
+    std::vector<uint8_t> voxels(x_res * y_res * z_res);
+    std::vector<otbv::Coord> coords;
+    for (uint32_t x = 0; x < x_res; x++) {
+      for (uint32_t y = 0; y < y_res; y++) {
+        for (uint32_t z = 0; z < z_res; z++) {
+          if ((x < x_res / 2 && y > y_res / 3) || 0 == rng() % 11) {
+            voxels[(x * y_res + y) * z_res + z] = 1;
+            coords.push_back({x, y, z});
+          }
+        }
+      }
+    }
+    const std::vector<bool> encoding =
+        otbv::encode_from_coords(coords, resolution);
+    const std::vector<bool> anisotropic =
+        otbv::to_anisotropic(encoding, resolution);
+    assert(encoding == otbv::to_isotropic(anisotropic, resolution));
+    if (x_res == y_res && y_res == z_res) {
+      // cubes have the same tree in both layouts
+      assert(encoding == anisotropic);
+    }
+
+    otbv::save_anisotropic(filename, encoding, resolution, true);
+    const std::vector<char> bytes = read_bytes(filename);
+    otbv::validate(bytes.data(), bytes.size());
+    std::vector<uint8_t> decoded(voxels.size());
+    otbv::for_each_leaf(
+        bytes.data(), bytes.size(),
+        [&](const otbv::Leaf &leaf) {
+          for (size_t x = leaf.box.xs; x < leaf.box.xe; x++) {
+            for (size_t y = leaf.box.ys; y < leaf.box.ye; y++) {
+              for (size_t z = leaf.box.zs; z < leaf.box.ze; z++) {
+                decoded[(x * y_res + y) * z_res + z]++;
+              }
+            }
+          }
+        },
+        otbv::LeafFilter::OCCUPIED);
+    assert(voxels == decoded);
+    // the iterator stops and resumes its walk at every leaf
+    std::vector<uint8_t> iterated(voxels.size());
+    otbv::LeafIterator leaves(bytes.data(), bytes.size(),
+                              otbv::LeafFilter::OCCUPIED);
+    otbv::Leaf leaf;
+    while (leaves.next(leaf)) {
+      for (size_t x = leaf.box.xs; x < leaf.box.xe; x++) {
+        for (size_t y = leaf.box.ys; y < leaf.box.ye; y++) {
+          for (size_t z = leaf.box.zs; z < leaf.box.ze; z++) {
+            iterated[(x * y_res + y) * z_res + z]++;
+          }
+        }
+      }
+    }
+    assert(voxels == iterated);
+    std::fill(decoded.begin(), decoded.end(), uint8_t(7));
+    otbv::decode_into(bytes.data(), bytes.size(), decoded.data());
+    assert(voxels == decoded);
+
+    std::tuple<size_t, size_t, size_t> read_resolution;
+    assert(encoding == otbv::load_encoding(filename, read_resolution, true));
+    assert(resolution == read_resolution);
+    const auto volume = otbv::load(filename);
+    for (size_t x = 0; x < x_res; x++) {
+      for (size_t y = 0; y < y_res; y++) {
+        for (size_t z = 0; z < z_res; z++) {
+          assert(voxels[(x * y_res + y) * z_res + z] == volume[x][y][z]);
+        }
+      }
+    }
+  }
+
+  // a thin slab spends no tokens on the padding above it
+  std::vector<otbv::Coord> coords;
+  for (uint32_t x = 0; x < 256; x++) {
+    for (uint32_t y = 0; y < 256; y++) {
+      for (uint32_t z = 0; z < 4; z++) {
+        if ((x / 7 + y / 5 + z) % 3 == 0) {
+          coords.push_back({x, y, z});
+        }
+      }
+    }
+  }
+  const std::tuple<size_t, size_t, size_t> slab = {256, 256, 4};
+  const std::vector<bool> encoding = otbv::encode_from_coords(coords, slab);
+  assert(otbv::to_anisotropic(encoding, slab).size() < encoding.size());
+
+  bool thrown = false;
+  try {
+    otbv::to_isotropic({1, 0, 1, 0}, {4, 4, 2});
+  } catch (const std::out_of_range &) {
+    thrown = true;
+  }
+  assert(thrown);
+  std::remove(filename.c_str());
+  return 0;
+}
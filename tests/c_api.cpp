@@ -0,0 +1,81 @@
+#include "../include/otbv.h"
+#include "../include/otbv_c.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+int tests_c_api(int argc, char **argv) {
+  const std::string filename = "test_c_api.otbv";
+  const size_t shape[3] = {6, 11, 5};
+  std::tuple<size_t, size_t, size_t> resolution;
+
+  // Fortran order: x is the fastest moving index
+  std::vector<uint8_t> fortran(shape[0] * shape[1] * shape[2]);
+  const ptrdiff_t f_strides[3] = {1, static_cast<ptrdiff_t>(shape[0]),
+                                  static_cast<ptrdiff_t>(shape[0] * shape[1])};
+  for (size_t x = 0; x < shape[0]; x++)
+    for (size_t y = 0; y < shape[1]; y++)
+      for (size_t z = 0; z < shape[2]; z++)
+        fortran[x * f_strides[0] + y * f_strides[1] + z * f_strides[2]] =
+            (x + y > 6 && z < 4) ? 255 : 0;
+
+  size_t size = 0;
+  assert(OTBV_ERROR_BUFFER_TOO_SMALL ==
+         otbv_encode(fortran.data(), shape, f_strides, nullptr, 0, &size));
+  assert(size > 0 && size <= otbv_encode_bound(shape));
+  std::vector<uint8_t> file(size);
+  assert(OTBV_OK == otbv_encode(fortran.data(), shape, f_strides, file.data(),
+                                file.size(), &size));
+  assert(size == file.size());
+
+  otbv_info info;
+  assert(OTBV_OK == otbv_info_buffer(file.data(), file.size(), &info));
+  assert(info.shape[0] == 6 && info.shape[1] == 11 && info.shape[2] == 5);
+  assert(info.file_size == file.size());
+  assert(1 == info.channels && !info.checksummed && !info.anisotropic);
+
+  // decode in C order and compare
+  std::vector<uint8_t> decoded(shape[0] * shape[1] * shape[2], 7);
+  assert(OTBV_OK ==
+         otbv_decode(file.data(), file.size(), decoded.data(), nullptr));
+  for (size_t x = 0; x < shape[0]; x++)
+    for (size_t y = 0; y < shape[1]; y++)
+      for (size_t z = 0; z < shape[2]; z++)
+        assert(decoded[(x * shape[1] + y) * shape[2] + z] ==
+               (fortran[x * f_strides[0] + y * f_strides[1] +
+                        z * f_strides[2]] != 0));
+
+  // files written through the C API are readable by the C++ API and back
+  assert(OTBV_OK == otbv_save(filename.c_str(), fortran.data(), shape,
+                              f_strides));
+  auto loaded = otbv::load(filename);
+  std::vector<uint8_t> reloaded(decoded.size());
+  assert(OTBV_OK == otbv_load(filename.c_str(), reloaded.data(), nullptr));
+  assert(reloaded == decoded);
+  for (size_t x = 0; x < shape[0]; x++)
+    for (size_t y = 0; y < shape[1]; y++)
+      for (size_t z = 0; z < shape[2]; z++)
+        assert(loaded[x][y][z] == decoded[(x * shape[1] + y) * shape[2] + z]);
+
+  // header flags, so that bindings can reject what they cannot decode
+  const std::vector<bool> encoding = otbv::load_encoding(filename, resolution);
+  otbv::save_channels(filename, otbv::merge_channels({encoding, encoding},
+                                                     resolution),
+                      resolution, 2, true);
+  assert(OTBV_OK == otbv_info_file(filename.c_str(), &info));
+  assert(2 == info.channels && info.checksummed && !info.anisotropic);
+  assert(OTBV_ERROR_FORMAT == otbv_load(filename.c_str(), reloaded.data(),
+                                        nullptr));
+  otbv::save_anisotropic(filename, encoding, resolution);
+  assert(OTBV_OK == otbv_info_file(filename.c_str(), &info));
+  assert(1 == info.channels && !info.checksummed && info.anisotropic);
+
+  assert(OTBV_ERROR_IO == otbv_info_file("does_not_exist.otbv", &info));
+  // truncated header
+  assert(OTBV_ERROR_FORMAT == otbv_info_buffer(file.data(), 10, &info));
+  assert(std::string(otbv_last_error()).size() > 0);
+  return 0;
+}
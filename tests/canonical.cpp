@@ -0,0 +1,94 @@
+#include "../include/otbv.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+// copies the node at idx, splitting every leaf larger than a voxel into 8
+// copies of itself
+static void expand(const std::vector<bool> &in, size_t &idx, size_t side,
+                   std::vector<bool> &out) {
+  if (in[idx]) {
+    out.push_back(1);
+    idx++;
+    for (int i = 0; i < 8; i++) {
+      expand(in, idx, side / 2, out);
+    }
+    return;
+  }
+  const bool value = in[idx + 1];
+  idx += 2;
+  if (side > 1) {
+    out.push_back(1);
+    for (int i = 0; i < 8; i++) {
+      out.push_back(0);
+      out.push_back(value);
+    }
+  } else {
+    out.push_back(0);
+    out.push_back(value);
+  }
+}
+
+int tests_canonical(int argc, char **argv) {
+  const std::tuple<size_t, size_t, size_t> resolution = {19, 12, 27};
+  std::mt19937 rng(8);
+  std::vector<otbv::Coord> coords;
+  for (uint32_t x = 0; x < 19; x++) {
+    for (uint32_t y = 0; y < 12; y++) {
+      for (uint32_t z = 0; z < 27; z++) {
+        if ((x < 16 && y < 8 && z < 16) || 0 == rng() % 9) {
+          coords.push_back({x, y, z});
+        }
+      }
+    }
+  }
+  const std::vector<bool> canonical =
+      otbv::encode_from_coords(coords, resolution);
+  assert(otbv::canonicalize(canonical, resolution) == canonical);
+
+  // redundant splits collapse back, and trailing tokens are dropped
+  size_t idx = 0;
+  std::vector<bool> redundant;
+  expand(canonical, idx, 32, redundant);
+  assert(redundant.size() > canonical.size());
+  redundant.push_back(1);
+  assert(otbv::canonicalize(redundant, resolution) == canonical);
+
+  // padding holds no information: 2 x 2 x 3 voxels in a cube of side 4, where
+  // only children 0 and 1 overlap the volume
+  const std::tuple<size_t, size_t, size_t> small = {2, 2, 3};
+  std::vector<bool> full = {1, 0, 1, 0, 1};
+  std::vector<bool> empty = {1, 0, 0, 0, 0};
+  for (int i = 2; i < 8; i++) {
+    full.insert(full.end(), {0, i % 2 == 0});
+    empty.insert(empty.end(), {0, 1});
+  }
+  assert((std::vector<bool>{0, 1}) == otbv::canonicalize(full, small));
+  assert((std::vector<bool>{0, 0}) == otbv::canonicalize(empty, small));
+  // a split node lying entirely in the padding becomes an empty leaf
+  std::vector<bool> mixed = {1, 0, 1, 0, 0, 1};
+  for (int i = 0; i < 8; i++) {
+    mixed.insert(mixed.end(), {0, 1});
+  }
+  for (int i = 3; i < 8; i++) {
+    mixed.insert(mixed.end(), {0, 0});
+  }
+  std::vector<bool> expected = {1, 0, 1, 0, 0};
+  for (int i = 2; i < 8; i++) {
+    expected.insert(expected.end(), {0, 0});
+  }
+  assert(expected == otbv::canonicalize(mixed, small));
+
+  bool thrown = false;
+  try {
+    otbv::canonicalize({1, 0, 1}, resolution);
+  } catch (const std::out_of_range &) {
+    thrown = true;
+  }
+  assert(thrown);
+  return 0;
+}
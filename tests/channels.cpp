@@ -0,0 +1,106 @@
+#include "../include/otbv.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+int tests_channels(int argc, char **argv) {
+  const std::string filename = "test_channels.otbv";
+  const size_t x_res = 37, y_res = 20, z_res = 45, channels = 3;
+  const std::tuple<size_t, size_t, size_t> resolution = {x_res, y_res, z_res};
+
+  // shapes sharing one centre and most of their boundaries
+  std::vector<uint8_t> voxels(x_res * y_res * z_res * channels);
+  std::vector<std::vector<otbv::Coord>> coords(channels);
+  for (uint32_t x = 0; x < x_res; x++) {
+    for (uint32_t y = 0; y < y_res; y++) {
+      for (uint32_t z = 0; z < z_res; z++) {
+        const int dx = x - 18, dy = y - 10, dz = z - 22;
+        const int distance = dx * dx + dy * dy + dz * dz;
+        const bool values[channels] = {distance < 100, distance < 36,
+                                       distance < 100 && x < 16};
+        for (size_t c = 0; c < channels; c++) {
+          if (values[c]) {
+            voxels[((x * y_res + y) * z_res + z) * channels + c] = 1;
+            coords[c].push_back({x, y, z});
+          }
+        }
+      }
+    }
+  }
+  std::vector<std::vector<bool>> encodings;
+  size_t separate = 0;
+  for (size_t c = 0; c < channels; c++) {
+    encodings.push_back(otbv::encode_from_coords(coords[c], resolution));
+    separate += encodings.back().size();
+  }
+
+  const std::vector<bool> merged = otbv::merge_channels(encodings, resolution);
+  assert(merged.size() < separate);
+  for (size_t c = 0; c < channels; c++) {
+    assert(otbv::canonicalize(encodings[c], resolution) ==
+           otbv::extract_channel(merged, resolution, channels, c));
+  }
+  // identical masks share their structure
+  assert(otbv::merge_channels({encodings[0], encodings[0]}, resolution).size() <
+         2 * encodings[0].size());
+  // a single channel is the usual encoding
+  assert(encodings[0] == otbv::merge_channels({encodings[0]}, resolution));
+
+  std::vector<uint8_t> decoded(voxels.size(), 7);
+  otbv::decode_channels(merged, resolution, channels, decoded.data());
+  assert(voxels == decoded);
+  std::vector<uint8_t> channel(x_res * y_res * z_res);
+  for (size_t c = 0; c < channels; c++) {
+    otbv::decode_channel(merged, resolution, channels, c, channel.data());
+    for (size_t i = 0; i < channel.size(); i++) {
+      assert(voxels[i * channels + c] == channel[i]);
+    }
+  }
+
+  // files
+  otbv::save_channels(filename, merged, resolution, channels, true);
+  std::tuple<size_t, size_t, size_t> read_resolution;
+  size_t read_channels = 0;
+  assert(merged ==
+         otbv::load_channels(filename, read_resolution, read_channels, true));
+  assert(resolution == read_resolution && channels == read_channels);
+  {
+    std::ifstream file_in(filename, std::ios::binary);
+    const std::vector<char> bytes{std::istreambuf_iterator<char>(file_in),
+                                  std::istreambuf_iterator<char>()};
+    otbv::validate(bytes.data(), bytes.size());
+  }
+  bool threw = false;
+  try {
+    otbv::load_encoding(filename, read_resolution);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  assert(threw);
+  otbv::save_encoding(filename, encodings[1], resolution);
+  assert(encodings[1] ==
+         otbv::load_channels(filename, read_resolution, read_channels));
+  assert(1 == read_channels);
+
+  threw = false;
+  try {
+    otbv::extract_channel(merged, resolution, channels, channels);
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  assert(threw);
+  threw = false;
+  try {
+    otbv::merge_channels({}, resolution);
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  assert(threw);
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include "../include/otbv.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+static std::vector<char> read_bytes(const std::string &filename) {
+  std::ifstream file_in(filename, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file_in),
+          std::istreambuf_iterator<char>()};
+}
+
+static void write_bytes(const std::string &filename,
+                        const std::vector<char> &bytes) {
+  std::ofstream file_out(filename, std::ios::binary);
+  file_out.write(bytes.data(), bytes.size());
+}
+
+int tests_checksum(int argc, char **argv) {
+  const std::string filename = "test_checksum.otbv";
+
+  // the standard check value, with "123456789" as the data
+  std::vector<bool> check;
+  for (const char c : std::string("123456789")) {
+    for (int bit = 7; bit >= 0; bit--) {
+      check.push_back((c >> bit) & 1);
+    }
+  }
+  otbv::save_encoding(filename, check, {4, 4, 4}, true);
+  std::vector<char> bytes = read_bytes(filename);
+  assert(1 == (bytes[5] & 1));
+  assert(22 + 4 + 9 == bytes.size());
+  const uint32_t stored = static_cast<uint8_t>(bytes[22]) |
+                          static_cast<uint8_t>(bytes[23]) << 8 |
+                          static_cast<uint8_t>(bytes[24]) << 16 |
+                          static_cast<uint32_t>(static_cast<uint8_t>(bytes[25]))
+                              << 24;
+  assert(0xe3069283 == stored);
+
+  const std::tuple<size_t, size_t, size_t> resolution = {37, 14, 25};
+  std::mt19937 rng(5);
+  std::vector<otbv::Coord> coords;
+  for (uint32_t x = 0; x < 37; x++) {
+    for (uint32_t y = 0; y < 14; y++) {
+      for (uint32_t z = 0; z < 25; z++) {
+        if (x * x + z * z < 400 || 0 == rng() % 7) {
+          coords.push_back({x, y, z});
+        }
+      }
+    }
+  }
+  const std::vector<bool> encoding =
+      otbv::encode_from_coords(coords, resolution);
+  otbv::save_encoding(filename, encoding, resolution, true);
+  bytes = read_bytes(filename);
+  assert(otbv::verify_checksum(bytes.data(), bytes.size()));
+  otbv::validate(bytes.data(), bytes.size());
+  std::tuple<size_t, size_t, size_t> read_resolution;
+  assert(encoding == otbv::load_encoding(filename, read_resolution, true));
+  assert(resolution == read_resolution);
+  const auto volume = otbv::load(filename, true);
+  assert(37 == volume.size() && 14 == volume[0].size());
+  size_t leaves = 0;
+  otbv::for_each_leaf(bytes.data(), bytes.size(),
+                      [&](const otbv::Leaf &) { leaves++; });
+  assert(leaves > 0);
+
+  // every flipped data bit is caught
+  const auto rejected = [](const std::vector<char> &file) {
+    try {
+      otbv::verify_checksum(file.data(), file.size());
+    } catch (const std::runtime_error &) {
+      return true;
+    }
+    return false;
+  };
+  for (size_t i = 0; i < 200; i++) {
+    std::vector<char> corrupted = bytes;
+    const size_t bit = rng() % ((corrupted.size() - 26) * 8);
+    corrupted[26 + bit / 8] ^= 1 << (bit % 8);
+    assert(rejected(corrupted));
+  }
+  std::vector<char> corrupted = bytes;
+  corrupted.back() ^= 1;
+  write_bytes(filename, corrupted);
+  bool thrown = false;
+  try {
+    otbv::load_encoding(filename, read_resolution, true);
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // files without a checksum pass
+  otbv::save_encoding(filename, encoding, resolution);
+  bytes = read_bytes(filename);
+  assert(!otbv::verify_checksum(bytes.data(), bytes.size()));
+  assert(encoding == otbv::load_encoding(filename, read_resolution, true));
+  return 0;
+}
@@ -0,0 +1,138 @@
+#include "../include/otbv.h"
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+int tests_decode(int argc, char **argv) {
+  const std::string filename = "test_decode.otbv";
+  std::mt19937 rng(4);
+  const std::tuple<size_t, size_t, size_t> shapes[] = {
+      {33, 17, 50}, {16, 16, 16}, {1, 1, 1}, {2, 5, 3}};
+  for (const auto &resolution : shapes) {
+    const size_t x_res = std::get<0>(resolution),
+                 y_res = std::get<1>(resolution),
+                 z_res = std::get<2>(resolution);
+    const size_t voxel_count = x_res * y_res * z_res;
+    // solid blocks with noise, so leaves of every size
+    std::vector<uint8_t> voxels(voxel_count);
+    std::vector<otbv::Coord> coords;
+    for (uint32_t x = 0; x < x_res; x++) {
+      for (uint32_t y = 0; y < y_res; y++) {
+        for (uint32_t z = 0; z < z_res; z++) {
+          if ((x < x_res / 2 && z > z_res / 3) || 0 == rng() % 7) {
+            voxels[(x * y_res + y) * z_res + z] = 1;
+            coords.push_back({x, y, z});
+          }
+        }
+      }
+    }
+    const std::vector<bool> encoding =
+        otbv::encode_from_coords(coords, resolution);
+
+    // C order, 0/255
+    std::vector<uint8_t> bytes(voxel_count, 7);
+    otbv::decode_into<uint8_t>(encoding, resolution, bytes.data(), nullptr,
+                               255, 0);
+    for (size_t i = 0; i < voxel_count; i++) {
+      assert(bytes[i] == (voxels[i] ? 255 : 0));
+    }
+
+    // Fortran order with z reversed, 1.0/0.0
+    std::vector<float> floats(voxel_count, -1.0f);
+    const ptrdiff_t strides[3] = {
+        static_cast<ptrdiff_t>(sizeof(float)),
+        static_cast<ptrdiff_t>(x_res * sizeof(float)),
+        -static_cast<ptrdiff_t>(x_res * y_res * sizeof(float))};
+    float *last_plane = floats.data() + x_res * y_res * (z_res - 1);
+    otbv::decode_into<float>(encoding, resolution, last_plane, strides, 1.0f,
+                             0.0f);
+    for (size_t x = 0; x < x_res; x++) {
+      for (size_t y = 0; y < y_res; y++) {
+        for (size_t z = 0; z < z_res; z++) {
+          const float value =
+              floats[((z_res - 1 - z) * y_res + y) * x_res + x];
+          assert(value == (voxels[(x * y_res + y) * z_res + z] ? 1.0f : 0.0f));
+        }
+      }
+    }
+
+    // files, in both layouts
+    for (bool anisotropic : {false, true}) {
+      if (anisotropic) {
+        otbv::save_anisotropic(filename, encoding, resolution);
+      } else {
+        otbv::save_encoding(filename, encoding, resolution);
+      }
+      std::ifstream file_in(filename, std::ios::binary);
+      const std::vector<char> file{std::istreambuf_iterator<char>(file_in),
+                                   std::istreambuf_iterator<char>()};
+      std::vector<int16_t> shorts(voxel_count);
+      otbv::decode_into<int16_t>(file.data(), file.size(), shorts.data(),
+                                 nullptr, -3, 12);
+      for (size_t i = 0; i < voxel_count; i++) {
+        assert(shorts[i] == (voxels[i] ? -3 : 12));
+      }
+    }
+  }
+
+  // objects placed into a larger world, partly outside of it
+  const std::tuple<size_t, size_t, size_t> world_shape = {40, 30, 20};
+  std::vector<uint8_t> world(40 * 30 * 20, 0), expected(world.size(), 0);
+  struct Placement {
+    std::array<ptrdiff_t, 3> origin;
+    otbv::Blend blend;
+  };
+  const Placement placements[] = {{{5, 3, 2}, otbv::Blend::OVERWRITE},
+                                  {{-4, 20, 9}, otbv::Blend::OR},
+                                  {{30, -2, -5}, otbv::Blend::OR},
+                                  {{12, 8, 4}, otbv::Blend::AND}};
+  const std::tuple<size_t, size_t, size_t> object_shape = {13, 11, 17};
+  for (const Placement &placement : placements) {
+    std::vector<uint8_t> object(13 * 11 * 17);
+    std::vector<otbv::Coord> coords;
+    for (uint32_t x = 0; x < 13; x++) {
+      for (uint32_t y = 0; y < 11; y++) {
+        for (uint32_t z = 0; z < 17; z++) {
+          if (x + z < 15 || 0 == rng() % 4) {
+            object[(x * 11 + y) * 17 + z] = 1;
+            coords.push_back({x, y, z});
+          }
+        }
+      }
+    }
+    otbv::decode_into_region<uint8_t>(
+        otbv::encode_from_coords(coords, object_shape), object_shape,
+        world.data(), world_shape, placement.origin, placement.blend);
+    for (ptrdiff_t x = 0; x < 13; x++) {
+      for (ptrdiff_t y = 0; y < 11; y++) {
+        for (ptrdiff_t z = 0; z < 17; z++) {
+          const ptrdiff_t wx = x + placement.origin[0],
+                          wy = y + placement.origin[1],
+                          wz = z + placement.origin[2];
+          if (wx < 0 || wy < 0 || wz < 0 || wx >= 40 || wy >= 30 ||
+              wz >= 20) {
+            continue;
+          }
+          uint8_t &voxel = expected[(wx * 30 + wy) * 20 + wz];
+          const uint8_t value = object[(x * 11 + y) * 17 + z];
+          if (otbv::Blend::OVERWRITE == placement.blend) {
+            voxel = value;
+          } else if (otbv::Blend::OR == placement.blend) {
+            voxel |= value;
+          } else {
+            voxel &= value;
+          }
+        }
+      }
+    }
+    assert(expected == world);
+  }
+  return 0;
+}
@@ -0,0 +1,61 @@
+#include "../include/otbv.h"
+#include "helpers.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+int tests_edit(int argc, char **argv) {
+  const size_t x_res = 23, y_res = 17, z_res = 30;
+  const std::tuple<size_t, size_t, size_t> resolution = {x_res, y_res, z_res};
+  std::vector<uint8_t> voxels(x_res * y_res * z_res);
+
+  // edits keep the encoding canonical, so it matches a fresh encoding
+  std::mt19937 rng(9);
+  std::vector<bool> encoding = encode_grid(voxels, resolution);
+  for (size_t i = 0; i < 300; i++) {
+    const bool value = rng() % 2;
+    otbv::Box box;
+    if (i % 3) {
+      const size_t x = rng() % x_res, y = rng() % y_res, z = rng() % z_res;
+      box = {x, x + 1, y, y + 1, z, z + 1};
+      otbv::set_voxel(encoding, resolution, x, y, z, value);
+    } else {
+      // boxes may stick out of the volume
+      const size_t xs = rng() % 32, ys = rng() % 32, zs = rng() % 32;
+      box = {xs, xs + 1 + rng() % 12, ys, ys + 1 + rng() % 12, zs,
+             zs + 1 + rng() % 12};
+      otbv::set_box(encoding, resolution, box, value);
+    }
+    for (size_t x = box.xs; x < std::min(box.xe, x_res); x++) {
+      for (size_t y = box.ys; y < std::min(box.ye, y_res); y++) {
+        for (size_t z = box.zs; z < std::min(box.ze, z_res); z++) {
+          voxels[(x * y_res + y) * z_res + z] = value;
+        }
+      }
+    }
+    assert(encode_grid(voxels, resolution) == encoding);
+  }
+
+  // filling everything collapses to a single leaf, and so does clearing it
+  otbv::set_box(encoding, resolution, {0, 64, 0, 64, 0, 64}, true);
+  assert((std::vector<bool>{0, 1}) == encoding);
+  otbv::set_voxel(encoding, resolution, 3, 4, 5, false);
+  otbv::set_voxel(encoding, resolution, 3, 4, 5, true);
+  assert((std::vector<bool>{0, 1}) == encoding);
+  otbv::set_box(encoding, resolution, {0, x_res, 0, y_res, 0, z_res}, false);
+  assert((std::vector<bool>{0, 0}) == encoding);
+
+  bool thrown = false;
+  try {
+    otbv::set_voxel(encoding, resolution, x_res, 0, 0, true);
+  } catch (const std::out_of_range &) {
+    thrown = true;
+  }
+  assert(thrown);
+  return 0;
+}
@@ -1,8 +1,12 @@
 #include "../include/otbv.h"
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <fstream>
+#include <stdexcept>
 #include <string>
+#include <tuple>
 #include <vector>
 
 int tests_endtoend(int argc, char** argv) {
@@ -25,5 +29,44 @@ int tests_endtoend(int argc, char** argv) {
       }
     }
   }
+
+  // a long and thin volume pads to a cube of 2048^3 voxels, which decoding
+  // must not allocate
+  const std::tuple<size_t, size_t, size_t> thin = {1025, 3, 2};
+  std::vector<otbv::Coord> coords;
+  for (uint32_t x = 0; x < 1025; x += 7) {
+    coords.push_back({x, x % 3, x % 2});
+  }
+  otbv::save_encoding(filename, otbv::encode_from_coords(coords, thin), thin);
+  loaded_data = otbv::load(filename);
+  assert(1025 == loaded_data.size() && 3 == loaded_data[0].size() &&
+         2 == loaded_data[0][0].size());
+  size_t occupied = 0;
+  for (size_t x = 0; x < 1025; x++) {
+    for (size_t y = 0; y < 3; y++) {
+      for (size_t z = 0; z < 2; z++) {
+        occupied += loaded_data[x][y][z];
+        assert(loaded_data[x][y][z] ==
+               (0 == x % 7 && y == x % 3 && z == x % 2));
+      }
+    }
+  }
+  assert(coords.size() == occupied);
+
+  // a header declaring an empty dimension is refused, whatever the direction
+  {
+    std::fstream file(filename,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    // y resolution of a padded file
+    file.seekp(10);
+    file.write("\0\0\0\0", 4);
+  }
+  bool thrown = false;
+  try {
+    otbv::load(filename);
+  } catch (const std::invalid_argument &e) {
+    thrown = std::string(e.what()).find("encode") == std::string::npos;
+  }
+  assert(thrown);
   return 0;
 }
\ No newline at end of file
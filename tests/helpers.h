@@ -0,0 +1,30 @@
+#pragma once
+
+#include "../include/otbv.h"
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+/**
+ * @brief Encodes \p voxels, a C-order grid of shape \p resolution where
+ * non-zero voxels are occupied, through the public API. Tests compare the
+ * encodings they build up against it.
+ */
+inline std::vector<bool>
+encode_grid(const std::vector<uint8_t> &voxels,
+            const std::tuple<size_t, size_t, size_t> &resolution) {
+  const size_t x_res = std::get<0>(resolution), y_res = std::get<1>(resolution),
+               z_res = std::get<2>(resolution);
+  std::vector<otbv::Coord> coords;
+  for (uint32_t x = 0; x < x_res; x++) {
+    for (uint32_t y = 0; y < y_res; y++) {
+      for (uint32_t z = 0; z < z_res; z++) {
+        if (voxels[(x * y_res + y) * z_res + z]) {
+          coords.push_back({x, y, z});
+        }
+      }
+    }
+  }
+  return otbv::encode_from_coords(coords, resolution);
+}
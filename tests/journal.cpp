@@ -0,0 +1,101 @@
+#include "../include/otbv.h"
+#include "helpers.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+int tests_journal(int argc, char **argv) {
+  const std::string filename = "test_journal.otbv";
+  const size_t x_res = 21, y_res = 14, z_res = 33;
+  const std::tuple<size_t, size_t, size_t> resolution = {x_res, y_res, z_res};
+  std::vector<uint8_t> voxels(x_res * y_res * z_res);
+  std::mt19937 rng(2);
+  const auto random_edit = [&](otbv::JournaledVolume &volume) {
+    const size_t xs = rng() % x_res, ys = rng() % y_res, zs = rng() % z_res;
+    const otbv::Box box = {xs, xs + 1 + rng() % 6, ys, ys + 1 + rng() % 6, zs,
+                           zs + 1 + rng() % 6};
+    const bool value = rng() % 2;
+    volume.set_box(box, value);
+    for (size_t x = box.xs; x < std::min(box.xe, x_res); x++) {
+      for (size_t y = box.ys; y < std::min(box.ye, y_res); y++) {
+        for (size_t z = box.zs; z < std::min(box.ze, z_res); z++) {
+          voxels[(x * y_res + y) * z_res + z] = value;
+        }
+      }
+    }
+  };
+
+  std::remove((filename + ".journal").c_str());
+  otbv::save_encoding(filename, encode_grid(voxels, resolution), resolution);
+
+  // compaction on the editing thread
+  {
+    otbv::JournalOptions options;
+    options.max_records = 40;
+    options.background = false;
+    otbv::JournaledVolume volume(filename, options);
+    for (size_t i = 0; i < 100; i++) {
+      random_edit(volume);
+      assert(volume.pending() < 40);
+      if (0 == i % 10) {
+        assert(encode_grid(voxels, resolution) == volume.load_encoding());
+      }
+    }
+    // the volume file alone lags behind until the journal is folded in
+    std::tuple<size_t, size_t, size_t> read_resolution;
+    assert(encode_grid(voxels, resolution) ==
+           otbv::load_journaled(filename, read_resolution));
+    assert(resolution == read_resolution);
+    volume.compact();
+    assert(0 == volume.pending());
+    assert(encode_grid(voxels, resolution) ==
+           otbv::load_encoding(filename, read_resolution));
+  }
+
+  // a record cut short by a crash is ignored
+  {
+    std::ofstream journal(filename + ".journal",
+                          std::ios::binary | std::ios::app);
+    journal.write("OTBJ\1\0", 6);
+  }
+  {
+    otbv::JournaledVolume volume(filename);
+    assert(encode_grid(voxels, resolution) == volume.load_encoding());
+    random_edit(volume);
+    assert(1 == volume.pending());
+    assert(encode_grid(voxels, resolution) == volume.load_encoding());
+  }
+
+  // background compaction while another thread keeps reading
+  {
+    otbv::JournalOptions options;
+    options.max_records = 16;
+    otbv::JournaledVolume volume(filename, options);
+    std::atomic<bool> done{false};
+    std::thread reader([&]() {
+      while (!done) {
+        std::tuple<size_t, size_t, size_t> read_resolution;
+        otbv::load_journaled(filename, read_resolution);
+      }
+    });
+    for (size_t i = 0; i < 300; i++) {
+      random_edit(volume);
+    }
+    done = true;
+    reader.join();
+    assert(encode_grid(voxels, resolution) == volume.load_encoding());
+  }
+  std::tuple<size_t, size_t, size_t> read_resolution;
+  assert(encode_grid(voxels, resolution) ==
+         otbv::load_journaled(filename, read_resolution));
+  return 0;
+}
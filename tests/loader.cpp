@@ -0,0 +1,210 @@
+#include "../include/otbv.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+static std::vector<char> read_bytes(const std::string &filename) {
+  std::ifstream file_in(filename, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file_in),
+          std::istreambuf_iterator<char>()};
+}
+
+// writes a ustar archive of \p files, stored under their own names
+static void write_tar(const std::string &filename,
+                      const std::vector<std::string> &files) {
+  std::ofstream out(filename, std::ios::binary);
+  for (const std::string &file : files) {
+    const std::vector<char> data = read_bytes(file);
+    char header[512] = {};
+    std::snprintf(header, 100, "%s", file.c_str());
+    std::snprintf(header + 100, 8, "%07o", 0644);
+    std::snprintf(header + 124, 12, "%011zo", data.size());
+    std::memset(header + 148, ' ', 8);
+    header[156] = '0';
+    std::memcpy(header + 257, "ustar", 6);
+    std::memcpy(header + 263, "00", 2);
+    unsigned sum = 0;
+    for (const char byte : header) {
+      sum += static_cast<uint8_t>(byte);
+    }
+    std::snprintf(header + 148, 8, "%06o", sum);
+    out.write(header, sizeof(header));
+    out.write(data.data(), data.size());
+    const std::vector<char> padding((512 - data.size() % 512) % 512);
+    out.write(padding.data(), padding.size());
+  }
+  const std::vector<char> end(1024);
+  out.write(end.data(), end.size());
+}
+
+int tests_loader(int argc, char **argv) {
+  const size_t x_res = 8, y_res = 6, z_res = 5, count = 5;
+  const std::tuple<size_t, size_t, size_t> resolution = {x_res, y_res, z_res};
+  const auto index = [](size_t x, size_t y, size_t z, size_t ys, size_t zs) {
+    return (x * ys + y) * zs + z;
+  };
+
+  std::mt19937 rng(11);
+  std::vector<std::string> files;
+  std::vector<std::vector<uint8_t>> volumes;
+  for (size_t i = 0; i < count; i++) {
+    std::vector<otbv::Coord> coords;
+    std::vector<uint8_t> volume(x_res * y_res * z_res);
+    for (uint32_t x = 0; x < x_res; x++) {
+      for (uint32_t y = 0; y < y_res; y++) {
+        for (uint32_t z = 0; z < z_res; z++) {
+          if (0 == rng() % 3) {
+            coords.push_back({x, y, z});
+            volume[index(x, y, z, y_res, z_res)] = 1;
+          }
+        }
+      }
+    }
+    files.push_back("test_loader_" + std::to_string(i) + ".otbv");
+    otbv::save_encoding(files.back(),
+                        otbv::encode_from_coords(coords, resolution),
+                        resolution);
+    volumes.push_back(volume);
+  }
+
+  // whole volumes, two epochs, the short last batch kept
+  otbv::DataLoaderOptions options;
+  options.batch_size = 2;
+  options.drop_last = false;
+  options.epochs = 2;
+  options.threads = 3;
+  options.prefetch = 2;
+  options.seed = 7;
+  {
+    otbv::DataLoader loader(files, options);
+    assert(3 == loader.batches_per_epoch());
+    std::vector<std::vector<size_t>> orders;
+    for (size_t epoch = 0; epoch < 2; epoch++) {
+      otbv::Batch batch;
+      std::vector<size_t> order;
+      while (loader.next(batch)) {
+        assert(epoch == batch.epoch);
+        assert(order.size() / 2 == batch.index);
+        assert(batch.shape[0] == batch.samples.size());
+        assert(x_res == batch.shape[1] && y_res == batch.shape[2] &&
+               z_res == batch.shape[3]);
+        assert(1 == batch.strides[3] &&
+               static_cast<ptrdiff_t>(x_res * y_res * z_res) ==
+                   batch.strides[0]);
+        const uint8_t *data = static_cast<const uint8_t *>(batch.data());
+        for (size_t s = 0; s < batch.shape[0]; s++) {
+          const std::vector<uint8_t> &volume = volumes[batch.samples[s]];
+          assert(std::equal(volume.begin(), volume.end(),
+                            data + s * batch.strides[0]));
+          order.push_back(batch.samples[s]);
+        }
+      }
+      assert(count == order.size());
+      assert(count == std::set<size_t>(order.begin(), order.end()).size());
+      orders.push_back(order);
+    }
+    // shuffled anew every epoch
+    assert(orders[0] != orders[1]);
+    otbv::Batch batch;
+    assert(!loader.next(batch));
+    assert(!loader.next(batch));
+  }
+
+  // centre crops and random flips, as floats
+  options = {};
+  options.batch_size = 1;
+  options.sample_shape = {4, 4, 5};
+  options.type = otbv::BatchType::FLOAT32;
+  options.shuffle = false;
+  options.random_flip = {true, true, true};
+  options.threads = 2;
+  {
+    otbv::DataLoader loader(files, options);
+    otbv::Batch batch;
+    std::set<size_t> flips;
+    for (size_t i = 0; i < count; i++) {
+      assert(loader.next(batch));
+      assert(i == batch.samples[0]);
+      assert(static_cast<ptrdiff_t>(sizeof(float)) == batch.strides[3]);
+      const float *data = static_cast<const float *>(batch.data());
+      // exactly one combination of flips matches, as the volume is random
+      size_t matches = 0;
+      for (size_t flip = 0; flip < 8; flip++) {
+        bool equal = true;
+        for (size_t x = 0; x < 4; x++) {
+          for (size_t y = 0; y < 4; y++) {
+            for (size_t z = 0; z < 5; z++) {
+              const size_t fx = flip & 4 ? 3 - x : x, fy = flip & 2 ? 3 - y : y,
+                           fz = flip & 1 ? 4 - z : z;
+              const float expected =
+                  volumes[i][index(fx + 2, fy + 1, fz, y_res, z_res)];
+              equal = equal && expected == data[index(x, y, z, 4, 5)];
+            }
+          }
+        }
+        if (equal) {
+          matches++;
+          flips.insert(flip);
+        }
+      }
+      assert(1 == matches);
+    }
+    assert(flips.size() > 1);
+    assert(!loader.next(batch));
+  }
+
+  // a list of files, and a tar archive of them, padded into larger samples
+  options = {};
+  options.batch_size = 5;
+  options.sample_shape = {9, 6, 5};
+  options.shuffle = false;
+  {
+    std::ofstream list("test_loader.txt");
+    for (const std::string &file : files) {
+      list << file << "\n";
+    }
+  }
+  write_tar("test_loader.tar", files);
+  for (const std::string source : {"test_loader.txt", "test_loader.tar"}) {
+    otbv::DataLoader loader(source, options);
+    assert(count == loader.sources().size());
+    otbv::Batch batch;
+    assert(loader.next(batch));
+    const uint8_t *data = static_cast<const uint8_t *>(batch.data());
+    for (size_t s = 0; s < count; s++) {
+      for (size_t x = 0; x < 9; x++) {
+        for (size_t y = 0; y < y_res; y++) {
+          for (size_t z = 0; z < z_res; z++) {
+            const uint8_t expected =
+                x < x_res ? volumes[s][index(x, y, z, y_res, z_res)] : 0;
+            assert(expected ==
+                   data[s * batch.strides[0] + index(x, y, z, y_res, z_res)]);
+          }
+        }
+      }
+    }
+  }
+
+  // too few samples for a batch
+  bool thrown = false;
+  try {
+    options.drop_last = true;
+    options.batch_size = count + 1;
+    otbv::DataLoader loader(files, options);
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  assert(thrown);
+  return 0;
+}
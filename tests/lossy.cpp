@@ -0,0 +1,91 @@
+#include "../include/otbv.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+int tests_lossy(int argc, char **argv) {
+  const size_t x_res = 45, y_res = 38, z_res = 29;
+  const std::tuple<size_t, size_t, size_t> resolution = {x_res, y_res, z_res};
+  std::mt19937 rng(3);
+  std::vector<otbv::Coord> coords;
+  for (uint32_t x = 0; x < x_res; x++) {
+    for (uint32_t y = 0; y < y_res; y++) {
+      for (uint32_t z = 0; z < z_res; z++) {
+        const bool blob = (x - 20) * (x - 20) + (y - 18) * (y - 18) +
+                              (z - 14) * (z - 14) <
+                          150;
+        // sparse noise, flipping about 2% of the voxels
+        if (blob != (0 == rng() % 50)) {
+          coords.push_back({x, y, z});
+        }
+      }
+    }
+  }
+  const std::vector<bool> encoding =
+      otbv::encode_from_coords(coords, resolution);
+  const auto mismatches = [&](const std::vector<bool> &other) {
+    std::vector<uint8_t> voxels(x_res * y_res * z_res);
+    for (const auto &coord : otbv::decode_to_coords(encoding, resolution)) {
+      voxels[(coord[0] * y_res + coord[1]) * z_res + coord[2]] ^= 1;
+    }
+    for (const auto &coord : otbv::decode_to_coords(other, resolution)) {
+      voxels[(coord[0] * y_res + coord[1]) * z_res + coord[2]] ^= 1;
+    }
+    size_t count = 0;
+    for (const uint8_t voxel : voxels) {
+      count += voxel;
+    }
+    return count;
+  };
+
+  // lossless by default
+  otbv::LossyEncoding lossless = otbv::simplify(encoding, resolution, {});
+  assert(encoding == lossless.encoding);
+  assert(0 == lossless.error_voxels);
+
+  // every collapsed node stays within the fraction, so the volume does too
+  otbv::LossyOptions options;
+  options.max_minority_fraction = 0.05;
+  const otbv::LossyEncoding fraction =
+      otbv::simplify(encoding, resolution, options);
+  assert(fraction.encoding.size() < encoding.size() / 2);
+  assert(mismatches(fraction.encoding) == fraction.error_voxels);
+  assert(fraction.error_voxels <= 0.05 * x_res * y_res * z_res);
+  otbv::validate(fraction.encoding, resolution);
+
+  // the budget bounds the error of the whole volume
+  for (const size_t budget : {1, 40, 400, 4000}) {
+    otbv::LossyOptions budgeted;
+    budgeted.error_budget = budget;
+    const otbv::LossyEncoding lossy =
+        otbv::simplify(encoding, resolution, budgeted);
+    assert(lossy.error_voxels <= budget);
+    assert(lossy.encoding.size() < encoding.size());
+    assert(mismatches(lossy.encoding) == lossy.error_voxels);
+  }
+
+  // the budget goes to the larger of two nodes it could collapse
+  const std::tuple<size_t, size_t, size_t> cube = {8, 8, 8};
+  otbv::LossyOptions one_voxel;
+  one_voxel.error_budget = 1;
+  const otbv::LossyEncoding largest = otbv::simplify(
+      otbv::encode_from_coords({{0, 0, 0}, {2, 2, 2}, {0, 0, 4}}, cube), cube,
+      one_voxel);
+  assert(1 == largest.error_voxels);
+  assert(otbv::encode_from_coords({{0, 0, 0}, {2, 2, 2}}, cube) ==
+         largest.encoding);
+
+  bool thrown = false;
+  try {
+    options.max_minority_fraction = 0.5;
+    otbv::simplify(encoding, resolution, options);
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  assert(thrown);
+  return 0;
+}
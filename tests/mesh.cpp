@@ -0,0 +1,48 @@
+#include "../include/otbv.h"
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+static otbv::TriangleMesh box_mesh(const std::array<double, 3> &lo,
+                                   const std::array<double, 3> &hi) {
+  otbv::TriangleMesh mesh;
+  for (int i = 0; i < 8; i++) {
+    mesh.vertices.push_back({i & 4 ? hi[0] : lo[0], i & 2 ? hi[1] : lo[1],
+                             i & 1 ? hi[2] : lo[2]});
+  }
+  // outward facing, counter-clockwise
+  mesh.triangles = {{0, 1, 3}, {0, 3, 2}, {4, 6, 7}, {4, 7, 5},
+                    {0, 4, 5}, {0, 5, 1}, {2, 3, 7}, {2, 7, 6},
+                    {0, 2, 6}, {0, 6, 4}, {1, 5, 7}, {1, 7, 3}};
+  return mesh;
+}
+
+int tests_mesh(int argc, char **argv) {
+  const std::string filename = "test_mesh.otbv";
+  const size_t x_res = 12, y_res = 9, z_res = 7;
+  const auto mesh = box_mesh({1.2, 1.2, 1.2}, {6.8, 5.8, 4.3});
+
+  for (auto rule : {otbv::InsideRule::PARITY, otbv::InsideRule::WINDING}) {
+    for (size_t threads : {1, 4}) {
+      std::vector<bool> encoding = otbv::voxelize_mesh(
+          mesh, {x_res, y_res, z_res}, {0, 0, 0}, 1.0, rule, threads);
+      otbv::save_encoding(filename, encoding, {x_res, y_res, z_res});
+      auto loaded = otbv::load(filename);
+      for (size_t x = 0; x < x_res; x++) {
+        for (size_t y = 0; y < y_res; y++) {
+          for (size_t z = 0; z < z_res; z++) {
+            // voxels touching the solid box, surface or interior
+            bool expected = x >= 1 && x <= 6 && y >= 1 && y <= 5 && z >= 1 &&
+                            z <= 4;
+            assert(loaded[x][y][z] == expected);
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}
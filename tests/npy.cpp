@@ -0,0 +1,120 @@
+#include "../include/otbv.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+static std::vector<char> read_bytes(const std::string &filename) {
+  std::ifstream file_in(filename, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file_in),
+          std::istreambuf_iterator<char>()};
+}
+
+int tests_npy(int argc, char **argv) {
+  const std::string filename = "test_npy.npy";
+  const size_t x_res = 13, y_res = 21, z_res = 35;
+  const std::tuple<size_t, size_t, size_t> resolution = {x_res, y_res, z_res};
+
+  // a solid block, so that runs merge into boxes, and scattered voxels
+  std::mt19937 rng(5);
+  std::vector<otbv::Coord> coords;
+  std::vector<uint8_t> expected(x_res * y_res * z_res);
+  for (uint32_t x = 0; x < x_res; x++) {
+    for (uint32_t y = 0; y < y_res; y++) {
+      for (uint32_t z = 0; z < z_res; z++) {
+        const bool block = x >= 2 && x < 11 && y >= 3 && y < 17 && z < 30;
+        if (block || 0 == rng() % 7) {
+          coords.push_back({x, y, z});
+          expected[(x * y_res + y) * z_res + z] = 1;
+        }
+      }
+    }
+  }
+  const std::vector<bool> encoding =
+      otbv::encode_from_coords(coords, resolution);
+  const auto c_index = [&](size_t x, size_t y, size_t z) {
+    return (x * y_res + y) * z_res + z;
+  };
+  const auto f_index = [&](size_t x, size_t y, size_t z) {
+    return (z * y_res + y) * x_res + x;
+  };
+
+  for (const bool fortran_order : {false, true}) {
+    for (const otbv::NpyLayout layout :
+         {otbv::NpyLayout::BOOL, otbv::NpyLayout::UINT8}) {
+      otbv::decode_to_npy(filename, encoding, resolution, layout,
+                          fortran_order);
+      const std::vector<char> bytes = read_bytes(filename);
+      // the array starts on a 64 byte boundary
+      const size_t data = bytes.size() - expected.size();
+      assert(0 == data % 64);
+      for (size_t x = 0; x < x_res; x++) {
+        for (size_t y = 0; y < y_res; y++) {
+          for (size_t z = 0; z < z_res; z++) {
+            const size_t idx =
+                fortran_order ? f_index(x, y, z) : c_index(x, y, z);
+            assert(expected[c_index(x, y, z)] == bytes[data + idx]);
+          }
+        }
+      }
+      std::tuple<size_t, size_t, size_t> read_resolution;
+      assert(otbv::encode_npy(filename, read_resolution) == encoding);
+      assert(read_resolution == resolution);
+    }
+
+    otbv::decode_to_npy(filename, encoding, resolution,
+                        otbv::NpyLayout::PACKBITS, fortran_order);
+    const std::vector<char> bytes = read_bytes(filename);
+    const size_t data = bytes.size() - (expected.size() + 7) / 8;
+    for (size_t x = 0; x < x_res; x++) {
+      for (size_t y = 0; y < y_res; y++) {
+        for (size_t z = 0; z < z_res; z++) {
+          const size_t idx =
+              fortran_order ? f_index(x, y, z) : c_index(x, y, z);
+          const bool bit = (bytes[data + idx / 8] >> (7 - idx % 8)) & 1;
+          assert(expected[c_index(x, y, z)] == bit);
+        }
+      }
+    }
+    assert(otbv::encode_npy_packbits(filename, resolution, fortran_order) ==
+           encoding);
+  }
+
+  // volumes larger than a chunk are written slab by slab
+  const std::tuple<size_t, size_t, size_t> large = {3, 1500, 1500};
+  std::vector<otbv::Coord> large_coords;
+  for (uint32_t x = 0; x < 3; x++) {
+    for (uint32_t y = 0; y < 1500; y++) {
+      for (uint32_t z = 0; z < 1500; z++) {
+        if ((x > 0 && y < 200 && z < 300) || 0 == (7 * x + 3 * y + z) % 101) {
+          large_coords.push_back({x, y, z});
+        }
+      }
+    }
+  }
+  const std::vector<bool> large_encoding =
+      otbv::encode_from_coords(large_coords, large);
+  for (const bool fortran_order : {false, true}) {
+    otbv::decode_to_npy(filename, large_encoding, large,
+                        otbv::NpyLayout::UINT8, fortran_order);
+    std::tuple<size_t, size_t, size_t> read_resolution;
+    assert(otbv::encode_npy(filename, read_resolution) == large_encoding);
+    assert(read_resolution == large);
+  }
+
+  // the shape of a packed file must match
+  bool thrown = false;
+  try {
+    otbv::encode_npy_packbits(filename, {x_res, y_res, z_res + 8});
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+  return 0;
+}
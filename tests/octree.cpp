@@ -0,0 +1,83 @@
+#include "../include/otbv.h"
+#include "helpers.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+int tests_octree(int argc, char **argv) {
+  const size_t x_res = 26, y_res = 31, z_res = 12;
+  const std::tuple<size_t, size_t, size_t> resolution = {x_res, y_res, z_res};
+  std::vector<uint8_t> voxels(x_res * y_res * z_res);
+  const auto at = [&](size_t x, size_t y, size_t z) -> uint8_t & {
+    return voxels[(x * y_res + y) * z_res + z];
+  };
+
+  std::mt19937 rng(4);
+  for (size_t x = 0; x < x_res; x++) {
+    for (size_t y = 0; y < y_res; y++) {
+      for (size_t z = 0; z < z_res; z++) {
+        at(x, y, z) = (x < 12 && y > 5) || 0 == rng() % 5;
+      }
+    }
+  }
+  const std::vector<bool> encoding = encode_grid(voxels, resolution);
+  otbv::Octree tree(encoding, resolution);
+
+  // an untouched tree serialises to its source, and reads match
+  assert(tree.encode() == encoding);
+  for (size_t x = 0; x < x_res; x++) {
+    for (size_t y = 0; y < y_res; y++) {
+      for (size_t z = 0; z < z_res; z++) {
+        assert(at(x, y, z) == tree.get(x, y, z));
+      }
+    }
+  }
+
+  // edits, serialised every now and then
+  for (size_t i = 0; i < 400; i++) {
+    const bool value = rng() % 2;
+    if (i % 4) {
+      const size_t x = rng() % x_res, y = rng() % y_res, z = rng() % z_res;
+      tree.set(x, y, z, value);
+      at(x, y, z) = value;
+      assert(value == tree.get(x, y, z));
+    } else {
+      const size_t xs = rng() % 32, ys = rng() % 32, zs = rng() % 32;
+      const otbv::Box box = {xs, xs + 1 + rng() % 10, ys, ys + 1 + rng() % 10,
+                             zs, zs + 1 + rng() % 10};
+      tree.set_box(box, value);
+      for (size_t x = box.xs; x < std::min(box.xe, x_res); x++) {
+        for (size_t y = box.ys; y < std::min(box.ye, y_res); y++) {
+          for (size_t z = box.zs; z < std::min(box.ze, z_res); z++) {
+            at(x, y, z) = value;
+          }
+        }
+      }
+    }
+    if (0 == i % 25) {
+      assert(encode_grid(voxels, resolution) == tree.encode());
+    }
+  }
+  assert(encode_grid(voxels, resolution) == tree.encode());
+
+  // filling the volume frees every node
+  tree.set_box({0, x_res, 0, y_res, 0, z_res}, true);
+  assert(0 == tree.node_count());
+  assert((std::vector<bool>{0, 1}) == tree.encode());
+  tree.set(0, 0, 0, false);
+  assert(tree.node_count() > 0 && !tree.get(0, 0, 0) && tree.get(0, 0, 1));
+
+  bool thrown = false;
+  try {
+    tree.get(0, y_res, 0);
+  } catch (const std::out_of_range &) {
+    thrown = true;
+  }
+  assert(thrown);
+  return 0;
+}
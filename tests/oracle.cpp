@@ -0,0 +1,82 @@
+#include "../include/otbv.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <tuple>
+#include <vector>
+
+static const double cx = 9.5, cy = 6.0, cz = 4.0, radius = 6.5;
+
+static bool inside(double x, double y, double z) {
+  double dx = x - cx, dy = y - cy, dz = z - cz;
+  return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+static double axis_distance(double s, double e, double c, bool farthest) {
+  // voxel centres in [s, e) lie in [s + .5, e - .5]
+  double lo = s + 0.5, hi = e - 0.5;
+  if (farthest) {
+    return std::max(c - lo, hi - c);
+  }
+  return c < lo ? lo - c : (c > hi ? c - hi : 0);
+}
+
+static otbv::Occupancy classify_sphere(const otbv::Box &box) {
+  double near = 0, far = 0;
+  for (auto [s, e, c] : {std::make_tuple(box.xs, box.xe, cx),
+                         std::make_tuple(box.ys, box.ye, cy),
+                         std::make_tuple(box.zs, box.ze, cz)}) {
+    double n = axis_distance(s, e, c, false), f = axis_distance(s, e, c, true);
+    near += n * n;
+    far += f * f;
+  }
+  if (far <= radius * radius)
+    return otbv::Occupancy::FULL;
+  if (near > radius * radius)
+    return otbv::Occupancy::EMPTY;
+  return otbv::Occupancy::MIXED;
+}
+
+int tests_oracle(int argc, char **argv) {
+  const std::string filename = "test_oracle.otbv";
+  const size_t x_res = 20, y_res = 13, z_res = 9;
+  std::vector<std::vector<std::vector<bool>>> expected(
+      x_res, std::vector<std::vector<bool>>(y_res, std::vector<bool>(z_res)));
+  for (size_t x = 0; x < x_res; x++)
+    for (size_t y = 0; y < y_res; y++)
+      for (size_t z = 0; z < z_res; z++)
+        expected[x][y][z] = inside(x + 0.5, y + 0.5, z + 0.5);
+
+  size_t voxel_queries = 0;
+  std::vector<bool> encoding = otbv::encode_from_oracle(
+      {x_res, y_res, z_res}, classify_sphere,
+      [&](size_t x, size_t y, size_t z) {
+        voxel_queries++;
+        return inside(x + 0.5, y + 0.5, z + 0.5);
+      });
+  assert(voxel_queries > 0 && voxel_queries < x_res * y_res * z_res);
+  otbv::save_encoding(filename, encoding, {x_res, y_res, z_res});
+  auto loaded = otbv::load(filename);
+  assert(loaded == expected);
+
+  // uniform volumes collapse to a single leaf
+  auto full = otbv::encode_from_oracle(
+      {x_res, y_res, z_res},
+      [](const otbv::Box &) { return otbv::Occupancy::FULL; });
+  assert(full == std::vector<bool>({0, 1}));
+  // so do conservative ones, whose padding children are empty leaves
+  for (size_t threads : {1, 4}) {
+    auto conservative = otbv::encode_from_oracle(
+        {3, 3, 3},
+        [](const otbv::Box &box) {
+          return 1 == (box.xe - box.xs) * (box.ye - box.ys) * (box.ze - box.zs)
+                     ? otbv::Occupancy::FULL
+                     : otbv::Occupancy::MIXED;
+        },
+        nullptr, threads);
+    assert(conservative == std::vector<bool>({0, 1}));
+  }
+  return 0;
+}
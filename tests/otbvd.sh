@@ -0,0 +1,43 @@
+#!/bin/sh
+# Starts otbvd on a private socket and runs otbvd_load against it.
+# usage: otbvd.sh <otbvd> <otbvd_load> <op> <file.otbv>...
+set -u
+otbvd=$1 load=$2 op=$3
+shift 3
+
+dir=$(mktemp -d "${TMPDIR:-/tmp}/otbvd_test.XXXXXX") || exit 1
+socket=$dir/otbvd.sock
+daemon=
+cleanup() {
+  [ -n "$daemon" ] && kill "$daemon" 2>/dev/null && wait "$daemon"
+  rm -rf "$dir"
+}
+trap cleanup EXIT
+
+# a path that is not a socket is left alone
+touch "$dir/file"
+if "$otbvd" --socket "$dir/file" >/dev/null 2>&1 || [ ! -f "$dir/file" ]; then
+  echo "otbvd replaced a regular file" >&2
+  exit 1
+fi
+
+"$otbvd" --socket "$socket" --max-clients 2 >/dev/null &
+daemon=$!
+tries=0
+until [ -S "$socket" ]; do
+  tries=$((tries + 1))
+  if [ "$tries" -gt 100 ] || ! kill -0 "$daemon" 2>/dev/null; then
+    echo "otbvd did not start" >&2
+    exit 1
+  fi
+  sleep 0.1
+done
+
+# a second daemon must not take over a live socket
+if "$otbvd" --socket "$socket" >/dev/null 2>&1; then
+  echo "otbvd took over a live socket" >&2
+  exit 1
+fi
+
+# more clients than the daemon serves at once, so some of them wait
+"$load" --socket "$socket" --op "$op" --connections 4 --requests 50 "$@"
@@ -0,0 +1,55 @@
+#include "../include/otbv.h"
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+int tests_points(int argc, char **argv) {
+  const std::string filename = "test_points.otbv";
+  const size_t x_res = 40, y_res = 30, z_res = 20;
+  const std::array<double, 3> origin = {-2.0, 1.0, 0.5};
+  const double voxel_size = 0.25;
+
+  // a dense blob and a sparse scatter, some of it outside of the volume
+  std::mt19937 rng(7);
+  std::normal_distribution<float> blob(0.0f, 1.0f);
+  std::uniform_real_distribution<float> scatter(-3.0f, 12.0f);
+  std::vector<std::array<float, 3>> first, second;
+  for (size_t i = 0; i < 200000; i++) {
+    first.push_back({blob(rng) + 3, blob(rng) + 4, blob(rng) + 2.5f});
+  }
+  for (size_t i = 0; i < 500; i++) {
+    second.push_back({scatter(rng), scatter(rng), scatter(rng)});
+  }
+
+  std::vector<std::vector<std::vector<bool>>> expected(
+      x_res, std::vector<std::vector<bool>>(y_res, std::vector<bool>(z_res)));
+  for (const auto *batch : {&first, &second}) {
+    for (const auto &p : *batch) {
+      double x = std::floor((p[0] - origin[0]) / voxel_size),
+             y = std::floor((p[1] - origin[1]) / voxel_size),
+             z = std::floor((p[2] - origin[2]) / voxel_size);
+      if (x >= 0 && y >= 0 && z >= 0 && x < x_res && y < y_res && z < z_res) {
+        expected[x][y][z] = 1;
+      }
+    }
+  }
+
+  otbv::PointCloudEncoder encoder({x_res, y_res, z_res}, origin, voxel_size,
+                                  4);
+  encoder.insert(first);
+  encoder.insert(second);
+  std::vector<bool> encoding = encoder.encode();
+  otbv::save_encoding(filename, encoding, {x_res, y_res, z_res});
+  assert(otbv::load(filename) == expected);
+
+  std::vector<std::array<float, 3>> all = first;
+  all.insert(all.end(), second.begin(), second.end());
+  assert(otbv::encode_from_points(all, {x_res, y_res, z_res}, origin,
+                                  voxel_size, 1) == encoding);
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include "../include/otbv.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+static std::vector<char> read_bytes(const std::string &filename) {
+  std::ifstream file_in(filename, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file_in),
+          std::istreambuf_iterator<char>()};
+}
+
+int tests_raw(int argc, char **argv) {
+  const std::string filename = "test_raw.raw";
+  const size_t x_res = 9, y_res = 14, z_res = 20;
+  const std::tuple<size_t, size_t, size_t> resolution = {x_res, y_res, z_res};
+
+  std::mt19937 rng(3);
+  std::vector<otbv::Coord> coords;
+  std::vector<uint8_t> expected(x_res * y_res * z_res);
+  for (uint32_t x = 0; x < x_res; x++) {
+    for (uint32_t y = 0; y < y_res; y++) {
+      for (uint32_t z = 0; z < z_res; z++) {
+        if ((x < 6 && y < 11 && z > 4) || 0 == rng() % 5) {
+          coords.push_back({x, y, z});
+          expected[(x * y_res + y) * z_res + z] = 1;
+        }
+      }
+    }
+  }
+  const std::vector<bool> encoding =
+      otbv::encode_from_coords(coords, resolution);
+
+  // every element type, both orders and both byte orders, behind a header
+  for (const otbv::ScalarType type :
+       {otbv::ScalarType::UINT8, otbv::ScalarType::INT16,
+        otbv::ScalarType::UINT32, otbv::ScalarType::FLOAT32,
+        otbv::ScalarType::FLOAT64}) {
+    for (const bool fortran_order : {false, true}) {
+      for (const bool big_endian : {false, true}) {
+        otbv::RawLayout layout;
+        layout.shape = resolution;
+        layout.type = type;
+        layout.fortran_order = fortran_order;
+        layout.big_endian = big_endian;
+        layout.offset = 3;
+        otbv::decode_to_raw(filename, encoding, layout);
+        assert(otbv::encode_raw(filename, layout) == encoding);
+        // 0.5 is between off and on, whatever the type
+        assert(otbv::encode_raw(filename, layout, 0.5) == encoding);
+        assert(otbv::encode_raw(filename, layout, 1).size() == 2);
+      }
+    }
+  }
+
+  // the byte layout matches what other tools expect
+  otbv::RawLayout layout;
+  layout.shape = resolution;
+  layout.type = otbv::ScalarType::UINT16;
+  layout.fortran_order = true;
+  layout.big_endian = true;
+  otbv::decode_to_raw(filename, encoding, layout);
+  const std::vector<char> bytes = read_bytes(filename);
+  assert(bytes.size() == 2 * expected.size());
+  for (size_t x = 0; x < x_res; x++) {
+    for (size_t y = 0; y < y_res; y++) {
+      for (size_t z = 0; z < z_res; z++) {
+        const size_t idx = 2 * ((z * y_res + y) * x_res + x);
+        assert(0 == bytes[idx]);
+        assert(expected[(x * y_res + y) * z_res + z] == bytes[idx + 1]);
+      }
+    }
+  }
+
+  // NRRD with attached data
+  const std::string nrrd = "test_raw.nrrd";
+  otbv::decode_to_nrrd(nrrd, encoding, resolution, otbv::ScalarType::INT16);
+  std::tuple<size_t, size_t, size_t> read_resolution;
+  assert(otbv::encode_nrrd(nrrd, read_resolution) == encoding);
+  assert(read_resolution == resolution);
+
+  // NRRD with a detached header, big endian intensities and a threshold
+  std::vector<uint8_t> intensities(2 * expected.size());
+  for (size_t x = 0; x < x_res; x++) {
+    for (size_t y = 0; y < y_res; y++) {
+      for (size_t z = 0; z < z_res; z++) {
+        const uint16_t value =
+            expected[(x * y_res + y) * z_res + z] ? 900 + rng() % 100
+                                                  : rng() % 800;
+        const size_t idx = 2 * ((z * y_res + y) * x_res + x);
+        intensities[idx] = value >> 8;
+        intensities[idx + 1] = value & 0xff;
+      }
+    }
+  }
+  std::ofstream data_out("test_raw_data.raw", std::ios::binary);
+  data_out << "skipped line\n";
+  data_out.write(reinterpret_cast<const char *>(intensities.data()),
+                 intensities.size());
+  data_out.close();
+  std::ofstream header_out("test_raw.nhdr");
+  header_out << "NRRD0005\n# comment\ntype: unsigned short\ndimension: 3\n"
+             << "sizes: " << x_res << " " << y_res << " " << z_res << "\n"
+             << "encoding: raw\nendian: big\nline skip: 1\n"
+             << "data file: test_raw_data.raw\n";
+  header_out.close();
+  assert(otbv::encode_nrrd("test_raw.nhdr", read_resolution, 850) ==
+         encoding);
+  return 0;
+}
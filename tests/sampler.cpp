@@ -0,0 +1,109 @@
+#include "../include/otbv.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+
+int tests_sampler(int argc, char **argv) {
+  const size_t x_res = 40, y_res = 33, z_res = 20;
+  const std::tuple<size_t, size_t, size_t> resolution = {x_res, y_res, z_res};
+  const auto index = [&](size_t x, size_t y, size_t z) {
+    return (x * y_res + y) * z_res + z;
+  };
+
+  // a solid block and a few scattered voxels in an otherwise empty volume
+  std::mt19937 rng(3);
+  std::vector<otbv::Coord> coords;
+  std::vector<uint8_t> expected(x_res * y_res * z_res);
+  for (uint32_t x = 0; x < x_res; x++) {
+    for (uint32_t y = 0; y < y_res; y++) {
+      for (uint32_t z = 0; z < z_res; z++) {
+        const bool block = x >= 8 && x < 24 && y >= 16 && y < 32 && z < 8;
+        if (block || 0 == rng() % 400) {
+          coords.push_back({x, y, z});
+          expected[index(x, y, z)] = 1;
+        }
+      }
+    }
+  }
+  const std::vector<bool> encoding =
+      otbv::encode_from_coords(coords, resolution);
+
+  std::mt19937_64 draws(1);
+  for (const size_t cell : {1, 4, 16, 64}) {
+    const otbv::PatchSampler sampler(encoding, resolution, cell);
+    assert(coords.size() == sampler.occupied());
+
+    // foreground draws only land on occupied voxels, and reach all of them
+    std::map<otbv::Coord, size_t> hits;
+    for (size_t i = 0; i < 40 * coords.size(); i++) {
+      const otbv::Coord voxel = sampler.sample_voxel(draws);
+      assert(expected[index(voxel[0], voxel[1], voxel[2])]);
+      hits[voxel]++;
+    }
+    assert(coords.size() == hits.size());
+
+    // background draws cover the whole volume
+    size_t empty = 0;
+    for (size_t i = 0; i < 1000; i++) {
+      const otbv::Coord voxel = sampler.sample_voxel(draws, 0);
+      assert(voxel[0] < x_res && voxel[1] < y_res && voxel[2] < z_res);
+      empty += !expected[index(voxel[0], voxel[1], voxel[2])];
+    }
+    assert(empty > 800);
+
+    // regions, partly outside of the volume, match the voxels
+    std::uniform_int_distribution<size_t> corner(0, 45), edge(1, 20);
+    for (size_t i = 0; i < 50; i++) {
+      const size_t xs = corner(draws), ys = corner(draws), zs = corner(draws);
+      const otbv::Box region = {xs, xs + edge(draws), ys, ys + edge(draws),
+                                zs, zs + edge(draws)};
+      const size_t ys_len = region.ye - region.ys, zs_len = region.ze - region.zs;
+      std::vector<uint8_t> out((region.xe - region.xs) * ys_len * zs_len, 7);
+      sampler.decode_region(region, out.data());
+      for (size_t x = region.xs; x < region.xe; x++) {
+        for (size_t y = region.ys; y < region.ye; y++) {
+          for (size_t z = region.zs; z < region.ze; z++) {
+            const bool inside = x < x_res && y < y_res && z < z_res;
+            const size_t at =
+                ((x - region.xs) * ys_len + y - region.ys) * zs_len + z -
+                region.zs;
+            assert((inside ? expected[index(x, y, z)] : 0) == out[at]);
+          }
+        }
+      }
+    }
+
+    // patches stay inside the volume and contain the drawn voxel's region
+    std::vector<uint8_t> patch(16 * 16 * 16);
+    for (size_t i = 0; i < 20; i++) {
+      const otbv::Coord start =
+          sampler.sample_patch({16, 16, 16}, patch.data(), draws);
+      assert(start[0] + 16 <= x_res && start[1] + 16 <= y_res &&
+             start[2] + 16 <= z_res);
+      size_t occupied = 0;
+      for (size_t x = 0; x < 16; x++) {
+        for (size_t y = 0; y < 16; y++) {
+          for (size_t z = 0; z < 16; z++) {
+            const uint8_t value = patch[(x * 16 + y) * 16 + z];
+            assert(expected[index(start[0] + x, start[1] + y, start[2] + z)] ==
+                   value);
+            occupied += value;
+          }
+        }
+      }
+      assert(occupied > 0);
+    }
+  }
+
+  // an empty volume falls back to uniform draws
+  const otbv::PatchSampler empty(
+      otbv::encode_from_coords({}, resolution), resolution);
+  assert(0 == empty.occupied());
+  const otbv::Coord voxel = empty.sample_voxel(draws);
+  assert(voxel[0] < x_res && voxel[1] < y_res && voxel[2] < z_res);
+  return 0;
+}
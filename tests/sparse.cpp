@@ -0,0 +1,61 @@
+#include "../include/otbv.h"
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+int tests_sparse(int argc, char **argv) {
+  const std::string filename = "test_sparse.otbv";
+  const size_t x_res = 13, y_res = 21, z_res = 35;
+  const std::tuple<size_t, size_t, size_t> resolution = {x_res, y_res, z_res};
+
+  // overlapping runs of random length
+  std::mt19937 rng(11);
+  std::vector<otbv::Run> runs;
+  for (size_t i = 0; i < 300; i++) {
+    uint32_t x = rng() % x_res, y = rng() % y_res, a = rng() % z_res,
+             b = rng() % z_res;
+    runs.push_back({x, y, std::min(a, b), std::max(a, b)});
+  }
+  runs.push_back({0, 0, 0, static_cast<uint32_t>(z_res)});
+
+  std::vector<std::vector<std::vector<bool>>> expected(
+      x_res, std::vector<std::vector<bool>>(y_res, std::vector<bool>(z_res)));
+  std::vector<otbv::Coord> coords;
+  for (const auto &run : runs) {
+    for (uint32_t z = run.z_start; z < run.z_end; z++) {
+      expected[run.x][run.y][z] = 1;
+      coords.push_back({run.x, run.y, z});
+    }
+  }
+
+  std::vector<bool> from_runs = otbv::encode_from_runs(runs, resolution);
+  otbv::save_encoding(filename, from_runs, resolution);
+  assert(otbv::load(filename) == expected);
+  assert(otbv::encode_from_coords(coords, resolution) == from_runs);
+
+  // decoded runs are maximal and sorted, so they re-encode identically
+  std::vector<otbv::Run> decoded_runs =
+      otbv::decode_to_runs(from_runs, resolution);
+  assert(otbv::encode_from_runs(decoded_runs, resolution) == from_runs);
+  for (size_t i = 1; i < decoded_runs.size(); i++) {
+    const auto &a = decoded_runs[i - 1], &b = decoded_runs[i];
+    assert(a.x < b.x || (a.x == b.x && a.y < b.y) ||
+           (a.x == b.x && a.y == b.y && a.z_end < b.z_start));
+  }
+
+  size_t occupied = 0;
+  for (const auto &coord : otbv::decode_to_coords(from_runs, resolution)) {
+    assert(expected[coord[0]][coord[1]][coord[2]]);
+    occupied++;
+  }
+  for (const auto &run : decoded_runs) {
+    occupied -= run.z_end - run.z_start;
+  }
+  assert(0 == occupied);
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include "../include/otbv.h"
+#include <cassert>
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+int tests_traversal(int argc, char **argv) {
+  const std::string filename = "test_traversal.otbv";
+  const size_t x_res = 19, y_res = 7, z_res = 12;
+  const std::tuple<size_t, size_t, size_t> resolution = {x_res, y_res, z_res};
+  std::vector<std::vector<std::vector<bool>>> data(
+      x_res, std::vector<std::vector<bool>>(y_res, std::vector<bool>(z_res)));
+  for (size_t x = 0; x < x_res; x++)
+    for (size_t y = 0; y < y_res; y++)
+      for (size_t z = 0; z < z_res; z++)
+        data[x][y][z] = (x * x + 3 * y + z) % 7 < 3 || x > 12;
+  otbv::save(filename, data);
+
+  std::tuple<size_t, size_t, size_t> loaded_resolution;
+  std::vector<bool> encoding =
+      otbv::load_encoding(filename, loaded_resolution);
+  assert(loaded_resolution == resolution);
+
+  // every voxel is covered by exactly one leaf holding its value
+  std::vector<std::vector<std::vector<int>>> hits(
+      x_res, std::vector<std::vector<int>>(y_res, std::vector<int>(z_res)));
+  std::vector<otbv::Leaf> leaves;
+  otbv::for_each_leaf(encoding, resolution, [&](const otbv::Leaf &leaf) {
+    leaves.push_back(leaf);
+    for (size_t x = leaf.box.xs; x < leaf.box.xe; x++)
+      for (size_t y = leaf.box.ys; y < leaf.box.ye; y++)
+        for (size_t z = leaf.box.zs; z < leaf.box.ze; z++) {
+          assert(data[x][y][z] == leaf.value);
+          hits[x][y][z]++;
+        }
+  });
+  for (const auto &plane : hits)
+    for (const auto &row : plane)
+      for (int count : row)
+        assert(1 == count);
+
+  // the iterator over the raw file bytes yields the same occupied leaves
+  std::ifstream file(filename, std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(file)),
+                          std::istreambuf_iterator<char>());
+  otbv::LeafIterator iterator(bytes.data(), bytes.size(),
+                              otbv::LeafFilter::OCCUPIED);
+  assert(iterator.resolution() == resolution);
+  otbv::Leaf leaf;
+  size_t idx = 0, occupied = 0;
+  while (iterator.next(leaf)) {
+    while (!leaves[idx].value)
+      idx++;
+    assert(leaf.box.xs == leaves[idx].box.xs &&
+           leaf.box.ze == leaves[idx].box.ze &&
+           leaf.depth == leaves[idx].depth);
+    idx++;
+    occupied++;
+  }
+
+  std::mutex mutex;
+  size_t parallel_occupied = 0;
+  otbv::for_each_leaf_parallel(
+      encoding, resolution,
+      [&](const otbv::Leaf &leaf) {
+        std::lock_guard<std::mutex> lock(mutex);
+        assert(leaf.value);
+        parallel_occupied++;
+      },
+      otbv::LeafFilter::OCCUPIED, 4);
+  assert(parallel_occupied == occupied);
+  return 0;
+}
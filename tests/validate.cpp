@@ -0,0 +1,106 @@
+#include "../include/otbv.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+static std::vector<char> read_bytes(const std::string &filename) {
+  std::ifstream file_in(filename, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file_in),
+          std::istreambuf_iterator<char>()};
+}
+
+// 0 if valid, 1 if truncated, 2 if otherwise malformed
+template <typename Check> static int outcome(Check check) {
+  try {
+    check();
+  } catch (const std::out_of_range &) {
+    return 1;
+  } catch (const std::runtime_error &) {
+    return 2;
+  }
+  return 0;
+}
+
+int tests_validate(int argc, char **argv) {
+  const std::string filename = "test_validate.otbv";
+  const std::tuple<size_t, size_t, size_t> resolution = {21, 9, 30};
+  std::mt19937 rng(4);
+  std::vector<otbv::Coord> coords;
+  for (uint32_t x = 0; x < 21; x++) {
+    for (uint32_t y = 0; y < 9; y++) {
+      for (uint32_t z = 0; z < 30; z++) {
+        if (x + z < 20 || 0 == rng() % 5) {
+          coords.push_back({x, y, z});
+        }
+      }
+    }
+  }
+  const std::vector<bool> encoding =
+      otbv::encode_from_coords(coords, resolution);
+  otbv::validate(encoding, resolution);
+  otbv::save_encoding(filename, encoding, resolution);
+  std::vector<char> bytes = read_bytes(filename);
+  otbv::validate(bytes.data(), bytes.size());
+
+  // truncated and overlong encodings
+  assert(1 == outcome([&]() {
+           otbv::validate(std::vector<bool>(encoding.begin(),
+                                            encoding.end() - 1),
+                          resolution);
+         }));
+  std::vector<bool> longer = encoding;
+  longer.insert(longer.end(), {0, 0});
+  assert(2 == outcome([&]() { otbv::validate(longer, resolution); }));
+  // a voxel cannot be split
+  assert(2 == outcome([&]() {
+           otbv::validate({1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+                          {1, 1, 1});
+         }));
+
+  // mutated streams: the packed file walk agrees with the token walk, at
+  // every alignment of the data
+  for (size_t i = 0; i < 400; i++) {
+    std::vector<bool> mutated = encoding;
+    for (size_t j = 0; j < 1 + i % 3; j++) {
+      const size_t at = rng() % mutated.size();
+      if (rng() % 2) {
+        mutated[at] = !mutated[at];
+      } else {
+        mutated.erase(mutated.begin() + at);
+      }
+    }
+    const int expected =
+        outcome([&]() { otbv::validate(mutated, resolution); });
+    otbv::save_encoding(filename, mutated, resolution);
+    const std::vector<char> file = read_bytes(filename);
+    assert(expected ==
+           outcome([&]() { otbv::validate(file.data(), file.size()); }));
+    std::tuple<size_t, size_t, size_t> read_resolution;
+    assert(expected == outcome([&]() {
+             otbv::load_encoding(filename, read_resolution);
+           }));
+  }
+
+  // header consistency
+  const auto corrupt = [&](size_t offset, char value) {
+    std::vector<char> copy = bytes;
+    copy[offset] = value;
+    return outcome([&]() { otbv::validate(copy.data(), copy.size()); });
+  };
+  assert(2 == corrupt(5, bytes[5] | 1));
+  assert(2 == corrupt(5, bytes[5] & ~0x10));
+  const uint8_t padding = static_cast<uint8_t>(bytes[5]) >> 5;
+  if (padding) {
+    assert(2 == corrupt(22, bytes[22] | (1 << (8 - padding))));
+  }
+  bytes.push_back(0);
+  assert(2 == outcome([&]() { otbv::validate(bytes.data(), bytes.size()); }));
+  return 0;
+}
@@ -0,0 +1,679 @@
+// otbv command-line tool: convert, inspect, verify and benchmark OTBV files.
+// Every processed file prints one JSON object per line on stdout.
+
+#include "../include/otbv.h"
+#include "../src/bits.h"
+#include "../src/canonical.h"
+#include "../src/conversion.h"
+#include "../src/io.h"
+#include "../src/parallel.h"
+#include "../src/strided.h"
+#include "../src/traversal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char USAGE[] =
+    "usage: otbv <command> [options] <path>...\n"
+    "\n"
+    "commands:\n"
+    "  info     print the header of every file\n"
+    "  encode   encode raw, .npy or NRRD volumes into .otbv files\n"
+    "  decode   decode .otbv files into raw, .npy or NRRD volumes\n"
+    "  verify   check the header and tree of every file without decoding it\n"
+    "  stats    print tree statistics of every file\n"
+    "  bench    time decoding and re-encoding of every file\n"
+    "  canonicalize\n"
+    "           rewrite .otbv files into their minimal form, in place unless\n"
+    "           -o is given\n"
+    "\n"
+    "Directories are searched recursively for .otbv files, or .raw, .npy,\n"
+    ".nrrd and .nhdr files for encode. One JSON object is printed per file.\n"
+    "\n"
+    "options:\n"
+    "  -j, --threads N     files processed at once (default: all cores, 1 for "
+    "bench)\n"
+    "  -o, --output PATH   output file, or output directory for several inputs\n"
+    "  --shape X,Y,Z       shape of raw and packed .npy volumes (encode)\n"
+    "  --dtype TYPE        raw or NRRD element type: uint8, int8, uint16, int16,\n"
+    "                      uint32, int32, float32, float64 (default: uint8)\n"
+    "  --order C|F         raw or .npy memory order (default: C)\n"
+    "  --format F          decoded file format: raw, npy, nrrd (default: raw)\n"
+    "  --layout L          .npy layout: bool, uint8, packbits (default: bool)\n"
+    "  --threshold V       raw or NRRD values above V are occupied (default: 0)\n"
+    "  --repeat N          bench repetitions per file (default: 5)\n"
+    "  --checksum          store a CRC32C of the data in the header (encode,\n"
+    "                      canonicalize)\n"
+    "  --anisotropic       pad every axis to a power of two of its own instead\n"
+    "                      of the volume to a cube (encode)\n"
+    "  --lossy F           let nodes whose minority voxels make up at most F of\n"
+    "                      them become leaves (encode, default: 0)\n"
+    "  --error-budget N    let up to N voxels be misclassified in all (encode)\n";
+
+struct Options {
+  std::string command;
+  std::vector<fs::path> inputs;
+  fs::path output;
+  size_t threads = 0;
+  bool threads_set = false;
+  std::tuple<size_t, size_t, size_t> shape = {0, 0, 0};
+  bool shape_set = false;
+  std::string dtype = "uint8";
+  std::string format = "raw";
+  otbv::NpyLayout layout = otbv::NpyLayout::BOOL;
+  char order = 'C';
+  double threshold = 0;
+  size_t repeat = 5;
+  bool checksum = false;
+  bool anisotropic = false;
+  otbv::LossyOptions lossy;
+};
+
+struct Job {
+  fs::path input;
+  fs::path output;
+};
+
+/**
+ * @brief Builds one line of JSON output, field by field
+ */
+class JsonLine {
+public:
+  JsonLine &text(const char *key, const std::string &value) {
+    add_key(key);
+    body += escape(value);
+    return *this;
+  }
+
+  JsonLine &integer(const char *key, uint64_t value) {
+    add_key(key);
+    body += std::to_string(value);
+    return *this;
+  }
+
+  JsonLine &real(const char *key, double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+    add_key(key);
+    body += buffer;
+    return *this;
+  }
+
+  JsonLine &flag(const char *key, bool value) {
+    add_key(key);
+    body += value ? "true" : "false";
+    return *this;
+  }
+
+  JsonLine &shape(const char *key,
+                  const std::tuple<size_t, size_t, size_t> &value) {
+    add_key(key);
+    body += "[" + std::to_string(std::get<0>(value)) + "," +
+            std::to_string(std::get<1>(value)) + "," +
+            std::to_string(std::get<2>(value)) + "]";
+    return *this;
+  }
+
+  std::string str() const { return "{" + body + "}"; }
+
+private:
+  std::string body;
+
+  void add_key(const char *key) {
+    if (!body.empty()) {
+      body += ",";
+    }
+    body += escape(key);
+    body += ":";
+  }
+
+  static std::string escape(const std::string &value) {
+    std::string out = "\"";
+    for (const char c : value) {
+      if ('"' == c || '\\' == c) {
+        out += '\\';
+        out += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char buffer[8];
+        std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+        out += buffer;
+      } else {
+        out += c;
+      }
+    }
+    return out + "\"";
+  }
+};
+
+std::vector<char> read_file(const fs::path &path) {
+  std::ifstream file_in(path, std::ios::binary | std::ios::ate);
+  if (!file_in) {
+    throw std::runtime_error("Could not open file for reading.");
+  }
+  std::vector<char> bytes(static_cast<size_t>(file_in.tellg()));
+  file_in.seekg(0);
+  if (!file_in.read(bytes.data(), bytes.size())) {
+    throw std::runtime_error("Could not read the file.");
+  }
+  return bytes;
+}
+
+size_t voxel_count(const std::tuple<size_t, size_t, size_t> &shape) {
+  return std::get<0>(shape) * std::get<1>(shape) * std::get<2>(shape);
+}
+
+/**
+ * @brief Returns the element type named \p dtype
+ */
+otbv::ScalarType scalar_type(const std::string &dtype) {
+  const std::pair<const char *, otbv::ScalarType> types[] = {
+      {"uint8", otbv::ScalarType::UINT8},     {"bool", otbv::ScalarType::UINT8},
+      {"int8", otbv::ScalarType::INT8},       {"uint16", otbv::ScalarType::UINT16},
+      {"int16", otbv::ScalarType::INT16},     {"uint32", otbv::ScalarType::UINT32},
+      {"int32", otbv::ScalarType::INT32},     {"float32", otbv::ScalarType::FLOAT32},
+      {"float64", otbv::ScalarType::FLOAT64},
+  };
+  for (const auto &type : types) {
+    if (dtype == type.first) {
+      return type.second;
+    }
+  }
+  throw std::invalid_argument("Unknown dtype " + dtype);
+}
+
+/**
+ * @brief Creates the directory that \p path goes in, if needed
+ */
+void create_parent(const fs::path &path) {
+  if (path.has_parent_path()) {
+    fs::create_directories(path.parent_path());
+  }
+}
+
+std::tuple<size_t, size_t, size_t> header_shape(const otbv::Header &header) {
+  return {header.x_res, header.y_res, header.z_res};
+}
+
+JsonLine info(const Job &job, const Options &) {
+  const std::vector<char> bytes = read_file(job.input);
+  const otbv::Header header = otbv::parse_header(bytes.data(), bytes.size());
+  const otbv::PackedBits bits =
+      otbv::data_bits(bytes.data() + header.data_offset, header);
+  JsonLine line;
+  line.text("file", job.input.string())
+      .shape("shape", header_shape(header))
+      .flag("padded", header.padded)
+      .flag("checksum", header.checksummed)
+      .flag("anisotropic", header.anisotropic)
+      .integer("channels", header.channels)
+      .integer("file_bytes", bytes.size())
+      .integer("data_bytes", header.data_length)
+      .integer("tokens", bits.size());
+  return line;
+}
+
+JsonLine verify(const Job &job, const Options &) {
+  const std::vector<char> bytes = read_file(job.input);
+  otbv::validate(bytes.data(), bytes.size());
+  JsonLine line;
+  line.text("file", job.input.string()).flag("ok", true);
+  return line;
+}
+
+JsonLine stats(const Job &job, const Options &) {
+  const std::vector<char> bytes = read_file(job.input);
+  const otbv::Header header = otbv::parse_header(bytes.data(), bytes.size());
+  otbv::require_single_channel(header);
+  const otbv::PackedBits bits =
+      otbv::data_bits(bytes.data() + header.data_offset, header);
+  const auto shape = header_shape(header);
+  size_t leaves = 0, occupied_leaves = 0, occupied_voxels = 0, max_depth = 0;
+  otbv::visit_leaves(
+      bits, shape, otbv::LeafFilter::ALL,
+      [&](const otbv::Leaf &leaf) {
+        leaves++;
+        max_depth = std::max(max_depth, leaf.depth);
+        if (leaf.value) {
+          occupied_leaves++;
+          occupied_voxels += otbv::volume(leaf.box);
+        }
+      },
+      header.anisotropic);
+  const size_t voxels = voxel_count(shape);
+  JsonLine line;
+  line.text("file", job.input.string())
+      .shape("shape", shape)
+      .integer("voxels", voxels)
+      .integer("occupied_voxels", occupied_voxels)
+      .real("occupancy",
+            voxels ? static_cast<double>(occupied_voxels) / voxels : 0)
+      .integer("leaves", leaves)
+      .integer("occupied_leaves", occupied_leaves)
+      .integer("max_depth", max_depth)
+      .integer("tokens", bits.size())
+      .real("bits_per_voxel",
+            voxels ? 8.0 * header.data_length / voxels : 0);
+  return line;
+}
+
+JsonLine encode(const Job &job, const Options &options) {
+  std::vector<bool> encoding;
+  std::tuple<size_t, size_t, size_t> shape = options.shape;
+  const fs::path extension = job.input.extension();
+  if (".nrrd" == extension || ".nhdr" == extension) {
+    encoding = otbv::encode_nrrd(job.input, shape, options.threshold);
+  } else if (".npy" != extension) {
+    if (!options.shape_set) {
+      throw std::invalid_argument("Raw volumes require --shape");
+    }
+    otbv::RawLayout layout;
+    layout.shape = shape;
+    layout.type = scalar_type(options.dtype);
+    layout.fortran_order = 'F' == options.order;
+    encoding = otbv::encode_raw(job.input, layout, options.threshold);
+  } else if (otbv::NpyLayout::PACKBITS == options.layout) {
+    if (!options.shape_set) {
+      throw std::invalid_argument("Packed .npy volumes require --shape");
+    }
+    encoding =
+        otbv::encode_npy_packbits(job.input, shape, 'F' == options.order);
+  } else {
+    encoding = otbv::encode_npy(job.input, shape);
+  }
+
+  size_t error_voxels = 0;
+  if (options.lossy.max_minority_fraction > 0 || options.lossy.error_budget) {
+    otbv::LossyEncoding lossy = otbv::simplify(encoding, shape, options.lossy);
+    encoding = std::move(lossy.encoding);
+    error_voxels = lossy.error_voxels;
+  }
+  if (options.anisotropic) {
+    encoding = otbv::to_anisotropic(encoding, shape);
+  }
+
+  create_parent(job.output);
+  std::ofstream file_out(job.output, std::ios::binary);
+  otbv::stream_data_as_file_bytes(file_out, encoding, shape,
+                                  otbv::is_padded(shape), options.checksum,
+                                  options.anisotropic);
+  const size_t written = static_cast<size_t>(file_out.tellp());
+  if (!file_out) {
+    throw std::runtime_error("Could not write " + job.output.string());
+  }
+  const size_t input_bytes = fs::file_size(job.input);
+  JsonLine line;
+  line.text("file", job.input.string())
+      .text("output", job.output.string())
+      .shape("shape", shape)
+      .integer("input_bytes", input_bytes)
+      .integer("output_bytes", written)
+      .real("ratio", written ? static_cast<double>(input_bytes) / written : 0)
+      .integer("error_voxels", error_voxels);
+  return line;
+}
+
+JsonLine decode(const Job &job, const Options &options) {
+  std::tuple<size_t, size_t, size_t> shape;
+  const std::vector<bool> encoding = otbv::load_encoding(job.input, shape);
+  create_parent(job.output);
+  if ("npy" == options.format) {
+    otbv::decode_to_npy(job.output, encoding, shape, options.layout,
+                        'F' == options.order);
+  } else if ("nrrd" == options.format) {
+    otbv::decode_to_nrrd(job.output, encoding, shape,
+                         scalar_type(options.dtype));
+  } else {
+    otbv::RawLayout layout;
+    layout.shape = shape;
+    layout.type = scalar_type(options.dtype);
+    layout.fortran_order = 'F' == options.order;
+    otbv::decode_to_raw(job.output, encoding, layout);
+  }
+  JsonLine line;
+  line.text("file", job.input.string())
+      .text("output", job.output.string())
+      .shape("shape", shape)
+      .text("format", options.format)
+      .integer("output_bytes", fs::file_size(job.output));
+  return line;
+}
+
+JsonLine bench(const Job &job, const Options &options) {
+  using clock = std::chrono::steady_clock;
+  const std::vector<char> bytes = read_file(job.input);
+  const otbv::Header header = otbv::parse_header(bytes.data(), bytes.size());
+  otbv::require_single_channel(header);
+  const otbv::PackedBits bits =
+      otbv::data_bits(bytes.data() + header.data_offset, header);
+  const auto shape = header_shape(header);
+  const size_t dims[3] = {std::get<0>(shape), std::get<1>(shape),
+                          std::get<2>(shape)};
+
+  otbv::StridedVolume<uint8_t> view{nullptr, {dims[0], dims[1], dims[2]}, {},
+                                    0};
+  otbv::contiguous_strides(dims, 1, view.strides);
+  std::vector<uint8_t> voxels(voxel_count(shape));
+  view.data = voxels.data();
+
+  std::vector<double> decode_ms, encode_ms;
+  for (size_t i = 0; i < options.repeat; i++) {
+    const auto start = clock::now();
+    otbv::decode_strided(bits, shape, voxels.data(), view.strides, uint8_t(1),
+                         uint8_t(0), header.anisotropic);
+    const auto decoded = clock::now();
+    const std::vector<bool> encoding = otbv::encode_view(view, shape);
+    const auto encoded = clock::now();
+    decode_ms.push_back(
+        std::chrono::duration<double, std::milli>(decoded - start).count());
+    encode_ms.push_back(
+        std::chrono::duration<double, std::milli>(encoded - decoded).count());
+  }
+  const auto median = [](std::vector<double> &samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+  };
+  const double decode_median = median(decode_ms),
+               encode_median = median(encode_ms);
+  const auto per_second = [&](double ms) {
+    return ms > 0 ? voxels.size() / (ms / 1000) : 0;
+  };
+  JsonLine line;
+  line.text("file", job.input.string())
+      .shape("shape", shape)
+      .integer("file_bytes", bytes.size())
+      .integer("repeat", options.repeat)
+      .real("decode_ms", decode_median)
+      .real("encode_ms", encode_median)
+      .real("decode_voxels_per_s", per_second(decode_median))
+      .real("encode_voxels_per_s", per_second(encode_median));
+  return line;
+}
+
+JsonLine canonicalize(const Job &job, const Options &options) {
+  const std::vector<char> bytes = read_file(job.input);
+  const otbv::Header header = otbv::parse_header(bytes.data(), bytes.size());
+  otbv::require_single_channel(header);
+  const otbv::PackedBits bits =
+      otbv::data_bits(bytes.data() + header.data_offset, header);
+  const auto shape = header_shape(header);
+  otbv::require_isotropic(header);
+  otbv::check_checksum(bytes.data() + header.data_offset, header);
+  const std::vector<bool> encoding = otbv::canonicalize_bits(bits, shape);
+  const bool checksum = header.checksummed || options.checksum;
+  bool changed =
+      encoding.size() != bits.size() || checksum != header.checksummed;
+  for (size_t i = 0; !changed && i < encoding.size(); i++) {
+    changed = encoding[i] != bits[i];
+  }
+
+  // canonical files rewritten in place are left untouched
+  if (changed || job.output != job.input) {
+    // write next to the output first, so an interrupted run keeps the original
+    create_parent(job.output);
+    const fs::path temporary = job.output.string() + ".tmp";
+    {
+      std::ofstream file_out(temporary, std::ios::binary);
+      otbv::stream_data_as_file_bytes(file_out, encoding, shape,
+                                      otbv::is_padded(shape), checksum);
+      if (!file_out.flush()) {
+        throw std::runtime_error("Could not write " + temporary.string());
+      }
+    }
+    fs::rename(temporary, job.output);
+  }
+  JsonLine line;
+  line.text("file", job.input.string())
+      .text("output", job.output.string())
+      .integer("tokens_before", bits.size())
+      .integer("tokens_after", encoding.size())
+      .flag("changed", changed);
+  return line;
+}
+
+size_t parse_count(const std::string &value, const char *name) {
+  size_t used = 0;
+  unsigned long long count = 0;
+  try {
+    count = std::stoull(value, &used);
+  } catch (const std::exception &) {
+    used = 0;
+  }
+  if (used != value.size() || value.empty() || '-' == value[0]) {
+    throw std::invalid_argument(std::string("Invalid value for ") + name +
+                                ": " + value);
+  }
+  return count;
+}
+
+std::tuple<size_t, size_t, size_t> parse_shape(const std::string &value) {
+  size_t dims[3];
+  size_t first = 0;
+  for (int axis = 0; axis < 3; axis++) {
+    const size_t last = 2 == axis ? value.size() : value.find(',', first);
+    if (std::string::npos == last) {
+      throw std::invalid_argument("--shape expects X,Y,Z");
+    }
+    dims[axis] = parse_count(value.substr(first, last - first), "--shape");
+    first = last + 1;
+  }
+  return {dims[0], dims[1], dims[2]};
+}
+
+Options parse_options(int argc, char **argv) {
+  Options options;
+  options.command = argv[1];
+  for (int i = 2; i < argc; i++) {
+    const std::string arg = argv[i];
+    const auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("Missing value for " + arg);
+      }
+      return argv[++i];
+    };
+    if ("-j" == arg || "--threads" == arg) {
+      options.threads = parse_count(value(), "--threads");
+      options.threads_set = true;
+    } else if (0 == arg.rfind("-j", 0)) {
+      options.threads = parse_count(arg.substr(2), "--threads");
+      options.threads_set = true;
+    } else if ("-o" == arg || "--output" == arg) {
+      options.output = value();
+    } else if ("--shape" == arg) {
+      options.shape = parse_shape(value());
+      options.shape_set = true;
+    } else if ("--dtype" == arg) {
+      options.dtype = value();
+      scalar_type(options.dtype);
+    } else if ("--format" == arg) {
+      options.format = value();
+      if ("raw" != options.format && "npy" != options.format &&
+          "nrrd" != options.format) {
+        throw std::invalid_argument("--format expects raw, npy or nrrd");
+      }
+    } else if ("--layout" == arg) {
+      const std::string layout = value();
+      if ("bool" == layout) {
+        options.layout = otbv::NpyLayout::BOOL;
+      } else if ("uint8" == layout) {
+        options.layout = otbv::NpyLayout::UINT8;
+      } else if ("packbits" == layout) {
+        options.layout = otbv::NpyLayout::PACKBITS;
+      } else {
+        throw std::invalid_argument("--layout expects bool, uint8 or packbits");
+      }
+    } else if ("--order" == arg) {
+      const std::string order = value();
+      if ("C" != order && "F" != order) {
+        throw std::invalid_argument("--order expects C or F");
+      }
+      options.order = order[0];
+    } else if ("--threshold" == arg) {
+      options.threshold = std::stod(value());
+    } else if ("--repeat" == arg) {
+      options.repeat = std::max<size_t>(1, parse_count(value(), "--repeat"));
+    } else if ("--checksum" == arg) {
+      options.checksum = true;
+    } else if ("--anisotropic" == arg) {
+      options.anisotropic = true;
+    } else if ("--lossy" == arg) {
+      options.lossy.max_minority_fraction = std::stod(value());
+      if (!(options.lossy.max_minority_fraction >= 0 &&
+            options.lossy.max_minority_fraction < 0.5)) {
+        throw std::invalid_argument("--lossy expects a value in [0, 0.5)");
+      }
+    } else if ("--error-budget" == arg) {
+      options.lossy.error_budget = parse_count(value(), "--error-budget");
+    } else if (!arg.empty() && '-' == arg[0] && "-" != arg) {
+      throw std::invalid_argument("Unknown option " + arg);
+    } else {
+      options.inputs.push_back(arg);
+    }
+  }
+  if (options.inputs.empty()) {
+    throw std::invalid_argument("No input paths given");
+  }
+  if (options.shape_set) {
+    otbv::check_resolution(options.shape);
+  }
+  if ("bench" == options.command && !options.threads_set) {
+    // concurrent files would skew each other's timings
+    options.threads = 1;
+  }
+  return options;
+}
+
+/**
+ * @brief Expands directories into the files they hold, and pairs every input
+ * with its output path, if the command writes one
+ */
+std::vector<Job> collect_jobs(const Options &options) {
+  const bool encoding = "encode" == options.command;
+  const bool canonical = "canonicalize" == options.command;
+  const bool writes =
+      encoding || canonical || "decode" == options.command;
+  const std::vector<std::string> wanted =
+      encoding ? std::vector<std::string>{".raw", ".npy", ".nrrd", ".nhdr"}
+               : std::vector<std::string>{".otbv"};
+  const std::string produced =
+      encoding || canonical ? ".otbv" : "." + options.format;
+
+  std::vector<Job> jobs;
+  bool expanded = options.inputs.size() > 1;
+  for (const fs::path &input : options.inputs) {
+    if (!fs::is_directory(input)) {
+      jobs.push_back({input, input.filename()});
+      continue;
+    }
+    expanded = true;
+    std::vector<Job> found;
+    for (const auto &entry : fs::recursive_directory_iterator(input)) {
+      if (entry.is_regular_file() &&
+          wanted.end() != std::find(wanted.begin(), wanted.end(),
+                                    entry.path().extension())) {
+        found.push_back({entry.path(), fs::relative(entry.path(), input)});
+      }
+    }
+    std::sort(found.begin(), found.end(), [](const Job &a, const Job &b) {
+      return a.input < b.input;
+    });
+    jobs.insert(jobs.end(), found.begin(), found.end());
+  }
+  if (!writes) {
+    return jobs;
+  }
+
+  for (Job &job : jobs) {
+    if (options.output.empty()) {
+      job.output = fs::path(job.input).replace_extension(produced);
+    } else if (expanded) {
+      job.output =
+          options.output / fs::path(job.output).replace_extension(produced);
+    } else {
+      job.output = options.output;
+    }
+  }
+  return jobs;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2 || std::string("-h") == argv[1] ||
+      std::string("--help") == argv[1]) {
+    std::fputs(USAGE, argc < 2 ? stderr : stdout);
+    return argc < 2 ? 2 : 0;
+  }
+
+  JsonLine (*command)(const Job &, const Options &) = nullptr;
+  const std::string name = argv[1];
+  if ("info" == name) {
+    command = info;
+  } else if ("encode" == name) {
+    command = encode;
+  } else if ("decode" == name) {
+    command = decode;
+  } else if ("verify" == name) {
+    command = verify;
+  } else if ("stats" == name) {
+    command = stats;
+  } else if ("bench" == name) {
+    command = bench;
+  } else if ("canonicalize" == name) {
+    command = canonicalize;
+  } else {
+    std::fprintf(stderr, "otbv: unknown command '%s'\n\n%s", argv[1], USAGE);
+    return 2;
+  }
+
+  Options options;
+  std::vector<Job> jobs;
+  try {
+    options = parse_options(argc, argv);
+    jobs = collect_jobs(options);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "otbv: %s\n", e.what());
+    return 2;
+  }
+
+  std::mutex output_mutex;
+  std::atomic<size_t> next_job{0};
+  std::atomic<bool> failed{false};
+  otbv::run_workers(
+      std::min(otbv::resolve_threads(options.threads), jobs.size()),
+      [&](size_t) {
+        for (size_t j = next_job++; j < jobs.size(); j = next_job++) {
+          JsonLine line;
+          try {
+            line = command(jobs[j], options);
+          } catch (const std::exception &e) {
+            failed = true;
+            line = JsonLine();
+            line.text("file", jobs[j].input.string())
+                .flag("ok", false)
+                .text("error", e.what());
+          }
+          const std::lock_guard<std::mutex> lock(output_mutex);
+          std::cout << line.str() << '\n';
+        }
+      });
+  std::cout.flush();
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,504 @@
+// otbvd: local volume query daemon.
+//
+// Serves info, point, slice, region and count queries over a Unix domain
+// socket, so that the processes of a node share one mapping and one decoded
+// copy of every volume. Protocol in otbvd_protocol.h.
+
+#include "../include/otbv.h"
+#include "../include/otbv_c.h"
+#include "../src/bits.h"
+#include "../src/conversion.h"
+#include "../src/io.h"
+#include "../src/mapped_file.h"
+#include "../src/strided.h"
+#include "otbvd_protocol.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const char USAGE[] =
+    "usage: otbvd [options]\n"
+    "\n"
+    "options:\n"
+    "  --socket PATH     socket to listen on (default: /tmp/otbvd.sock)\n"
+    "  --cache-mb N      decoded volumes kept in memory (default: 1024)\n"
+    "  --max-clients N   connections served at once (default: 64)\n";
+
+/**
+ * @brief A mapped OTBV file, and its voxels decoded in C order
+ */
+struct Volume {
+  otbv::MappedFile file;
+  otbv::Header header;
+  otbv::PackedBits bits;
+  std::tuple<size_t, size_t, size_t> shape;
+  size_t dims[3];
+  ptrdiff_t strides[3];
+  std::vector<uint8_t> voxels;
+
+  explicit Volume(const std::string &path) : file(path) {
+    header = otbv::parse_header(file.data(), file.size());
+    otbv::require_single_channel(header);
+    bits = otbv::data_bits(file.data() + header.data_offset, header);
+    shape = {header.x_res, header.y_res, header.z_res};
+    dims[0] = header.x_res;
+    dims[1] = header.y_res;
+    dims[2] = header.z_res;
+    otbv::contiguous_strides(dims, 1, strides);
+    voxels.resize(dims[0] * dims[1] * dims[2]);
+    otbv::decode_strided(bits, shape, voxels.data(), strides, uint8_t(1),
+                         uint8_t(0), header.anisotropic);
+  }
+
+  size_t memory() const { return voxels.size() + file.size(); }
+};
+
+/**
+ * @brief Volumes by path, evicted least recently used first once they take
+ * more than the capacity. Concurrent requests for a volume that is not cached
+ * yet wait for a single load.
+ */
+class VolumeCache {
+public:
+  explicit VolumeCache(size_t capacity) : capacity(capacity) {}
+
+  std::shared_ptr<const Volume> get(const std::string &path) {
+    struct stat st;
+    if (::stat(path.c_str(), &st)) {
+      throw std::system_error(errno, std::generic_category(),
+                              "Could not stat " + path);
+    }
+    const Stamp stamp = {st.st_ino, st.st_size, st.st_mtime};
+
+    std::promise<std::shared_ptr<const Volume>> promise;
+    std::shared_future<std::shared_ptr<const Volume>> volume;
+    size_t generation = 0;
+    {
+      const std::lock_guard<std::mutex> lock(mutex);
+      auto it = slots.find(path);
+      if (slots.end() != it && !(it->second.stamp == stamp)) {
+        // the file changed on disk
+        drop(it);
+        it = slots.end();
+      }
+      if (slots.end() != it) {
+        lru.splice(lru.begin(), lru, it->second.position);
+        volume = it->second.volume;
+      } else {
+        generation = ++generations;
+        volume = promise.get_future().share();
+        lru.push_front(path);
+        slots.emplace(path, Slot{volume, stamp, 0, generation, lru.begin()});
+      }
+    }
+    if (!generation) {
+      // cached, or being loaded by another request
+      return volume.get();
+    }
+
+    try {
+      auto loaded = std::make_shared<const Volume>(path);
+      promise.set_value(loaded);
+      const std::lock_guard<std::mutex> lock(mutex);
+      const auto it = slots.find(path);
+      if (slots.end() != it && generation == it->second.generation) {
+        it->second.memory = loaded->memory();
+        used += it->second.memory;
+        evict();
+      }
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+      const std::lock_guard<std::mutex> lock(mutex);
+      const auto it = slots.find(path);
+      if (slots.end() != it && generation == it->second.generation) {
+        drop(it);
+      }
+    }
+    return volume.get();
+  }
+
+private:
+  struct Stamp {
+    ino_t inode;
+    off_t size;
+    time_t modified;
+    bool operator==(const Stamp &other) const {
+      return inode == other.inode && size == other.size &&
+             modified == other.modified;
+    }
+  };
+
+  struct Slot {
+    std::shared_future<std::shared_ptr<const Volume>> volume;
+    Stamp stamp;
+    // 0 while loading
+    size_t memory;
+    size_t generation;
+    std::list<std::string>::iterator position;
+  };
+
+  size_t capacity, used = 0, generations = 0;
+  std::mutex mutex;
+  std::list<std::string> lru;
+  std::unordered_map<std::string, Slot> slots;
+
+  void drop(std::unordered_map<std::string, Slot>::iterator it) {
+    used -= it->second.memory;
+    lru.erase(it->second.position);
+    slots.erase(it);
+  }
+
+  void evict() {
+    // the most recent volume stays, even if it alone is over capacity
+    while (used > capacity && lru.size() > 1) {
+      drop(slots.find(lru.back()));
+    }
+  }
+};
+
+/**
+ * @brief Anonymous shared memory handed to a client by descriptor
+ */
+class SharedBuffer {
+public:
+  explicit SharedBuffer(size_t size) : length(size) {
+    static std::atomic<size_t> counter{0};
+    const std::string name = "/otbvd-" + std::to_string(::getpid()) + "-" +
+                             std::to_string(counter++);
+    fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) {
+      throw std::bad_alloc();
+    }
+    // only the descriptor keeps it alive, nothing leaks if a client dies
+    ::shm_unlink(name.c_str());
+    if (::ftruncate(fd, length)) {
+      ::close(fd);
+      throw std::bad_alloc();
+    }
+    void *mapped =
+        ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == mapped) {
+      ::close(fd);
+      throw std::bad_alloc();
+    }
+    bytes = static_cast<uint8_t *>(mapped);
+  }
+
+  ~SharedBuffer() {
+    ::munmap(bytes, length);
+    ::close(fd);
+  }
+
+  SharedBuffer(const SharedBuffer &) = delete;
+  SharedBuffer &operator=(const SharedBuffer &) = delete;
+
+  uint8_t *data() { return bytes; }
+  int descriptor() const { return fd; }
+
+private:
+  int fd = -1;
+  uint8_t *bytes = nullptr;
+  size_t length;
+};
+
+/**
+ * @brief Returns the box of a region request, checked against \p volume
+ *
+ * @throws std::invalid_argument If the box is empty or leaves the volume
+ */
+otbv::Box request_box(const otbvd::Request &request, const Volume &volume) {
+  const uint32_t *a = request.args;
+  if (a[0] >= a[1] || a[2] >= a[3] || a[4] >= a[5] || a[1] > volume.dims[0] ||
+      a[3] > volume.dims[1] || a[5] > volume.dims[2]) {
+    throw std::invalid_argument("The region is empty or outside the volume");
+  }
+  return {a[0], a[1], a[2], a[3], a[4], a[5]};
+}
+
+/**
+ * @brief Copies the voxels of \p box out of \p volume into \p out, in C order
+ */
+void copy_box(const Volume &volume, const otbv::Box &box, uint8_t *out) {
+  for (size_t x = box.xs; x < box.xe; x++) {
+    for (size_t y = box.ys; y < box.ye; y++) {
+      const uint8_t *row =
+          volume.voxels.data() + otbv::offset(volume.strides, x, y, box.zs);
+      out = std::copy(row, row + (box.ze - box.zs), out);
+    }
+  }
+}
+
+/**
+ * @brief Answers \p request. Bulk results are written to \p payload.
+ */
+otbvd::Response answer(const otbvd::Request &request, const std::string &path,
+                       VolumeCache &cache,
+                       std::unique_ptr<SharedBuffer> &payload) {
+  otbvd::Response response = {};
+  const std::shared_ptr<const Volume> volume = cache.get(path);
+  const size_t *dims = volume->dims;
+  const uint32_t *a = request.args;
+
+  switch (static_cast<otbvd::Op>(request.op)) {
+  case otbvd::Op::INFO: {
+    response.value = volume->file.size();
+    std::copy(dims, dims + 3, response.shape);
+    break;
+  }
+  case otbvd::Op::POINT: {
+    if (a[0] >= dims[0] || a[1] >= dims[1] || a[2] >= dims[2]) {
+      throw std::invalid_argument("The point lies outside the volume");
+    }
+    response.value =
+        volume->voxels[otbv::offset(volume->strides, a[0], a[1], a[2])];
+    response.shape[0] = response.shape[1] = response.shape[2] = 1;
+    break;
+  }
+  case otbvd::Op::SLICE: {
+    const size_t axis = request.axis;
+    if (axis > 2 || a[0] >= dims[axis]) {
+      throw std::invalid_argument("The slice lies outside the volume");
+    }
+    otbv::Box box = {0, dims[0], 0, dims[1], 0, dims[2]};
+    if (0 == axis) {
+      box.xs = a[0], box.xe = a[0] + 1;
+    } else if (1 == axis) {
+      box.ys = a[0], box.ye = a[0] + 1;
+    } else {
+      box.zs = a[0], box.ze = a[0] + 1;
+    }
+    const size_t u = 0 == axis ? 1 : 0, v = 2 == axis ? 1 : 2;
+    response.shape[0] = static_cast<uint32_t>(dims[u]);
+    response.shape[1] = static_cast<uint32_t>(dims[v]);
+    response.shape[2] = 1;
+    response.value = dims[u] * dims[v];
+    payload.reset(new SharedBuffer(response.value));
+    copy_box(*volume, box, payload->data());
+    break;
+  }
+  case otbvd::Op::REGION: {
+    const otbv::Box box = request_box(request, *volume);
+    response.shape[0] = static_cast<uint32_t>(box.xe - box.xs);
+    response.shape[1] = static_cast<uint32_t>(box.ye - box.ys);
+    response.shape[2] = static_cast<uint32_t>(box.ze - box.zs);
+    response.value = otbv::volume(box);
+    payload.reset(new SharedBuffer(response.value));
+    copy_box(*volume, box, payload->data());
+    break;
+  }
+  case otbvd::Op::COUNT: {
+    const otbv::Box box = request_box(request, *volume);
+    for (size_t x = box.xs; x < box.xe; x++) {
+      for (size_t y = box.ys; y < box.ye; y++) {
+        const uint8_t *row = volume->voxels.data() +
+                             otbv::offset(volume->strides, x, y, box.zs);
+        response.value += std::count(row, row + (box.ze - box.zs), uint8_t(1));
+      }
+    }
+    std::copy(dims, dims + 3, response.shape);
+    break;
+  }
+  default:
+    throw std::invalid_argument("Unknown request");
+  }
+  return response;
+}
+
+/**
+ * @brief Answers the requests of one client until it disconnects
+ */
+void serve(int fd, VolumeCache &cache) {
+  otbvd::Request request;
+  std::string path;
+  while (otbvd::read_all(fd, &request, sizeof(request))) {
+    if (otbvd::PROTOCOL_MAGIC != request.magic ||
+        request.path_length > otbvd::MAX_PATH_LENGTH) {
+      break;
+    }
+    path.resize(request.path_length);
+    if (!otbvd::read_all(fd, &path[0], path.size())) {
+      break;
+    }
+
+    otbvd::Response response = {};
+    std::string message;
+    std::unique_ptr<SharedBuffer> payload;
+    try {
+      response = answer(request, path, cache, payload);
+      response.status = OTBV_OK;
+    } catch (const std::system_error &e) {
+      response.status = OTBV_ERROR_IO;
+      message = e.what();
+    } catch (const std::bad_alloc &e) {
+      response.status = OTBV_ERROR_OUT_OF_MEMORY;
+      message = e.what();
+    } catch (const std::invalid_argument &e) {
+      response.status = OTBV_ERROR_INVALID_ARGUMENT;
+      message = e.what();
+    } catch (const std::exception &e) {
+      // malformed files surface as runtime_error or out_of_range
+      response.status = OTBV_ERROR_FORMAT;
+      message = e.what();
+    }
+    if (OTBV_OK != response.status) {
+      payload.reset();
+      response.value = 0;
+    }
+    if (!otbvd::send_response(fd, response, message,
+                              payload ? payload->descriptor() : -1)) {
+      break;
+    }
+  }
+  ::close(fd);
+}
+
+volatile std::sig_atomic_t stopping = 0;
+
+void on_signal(int) { stopping = 1; }
+
+/**
+ * @brief Removes the socket a previous run left behind at \p path, after
+ * checking that it is a socket and that no daemon listens on it anymore
+ *
+ * @return An error message, empty if \p path is free to bind
+ */
+std::string claim_socket_path(const std::string &path) {
+  struct stat st;
+  if (::lstat(path.c_str(), &st)) {
+    return ENOENT == errno ? "" : std::strerror(errno);
+  }
+  if (!S_ISSOCK(st.st_mode)) {
+    return "the path exists and is not a socket";
+  }
+  const int fd = otbvd::connect_socket(path);
+  if (fd >= 0) {
+    ::close(fd);
+    return "another daemon is listening on it";
+  }
+  if (::unlink(path.c_str()) && ENOENT != errno) {
+    return std::strerror(errno);
+  }
+  return "";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string socket_path = otbvd::DEFAULT_SOCKET;
+  size_t cache_mb = 1024, max_clients = 64;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if ("--socket" == arg && i + 1 < argc) {
+      socket_path = argv[++i];
+    } else if ("--cache-mb" == arg && i + 1 < argc) {
+      cache_mb = std::strtoull(argv[++i], nullptr, 10);
+    } else if ("--max-clients" == arg && i + 1 < argc) {
+      max_clients = std::max(1ull, std::strtoull(argv[++i], nullptr, 10));
+    } else {
+      std::fputs(USAGE, "-h" == arg || "--help" == arg ? stdout : stderr);
+      return "-h" == arg || "--help" == arg ? 0 : 2;
+    }
+  }
+
+  sockaddr_un address;
+  if (!otbvd::socket_address(socket_path, address)) {
+    std::fprintf(stderr, "otbvd: socket path is too long\n");
+    return 2;
+  }
+  const std::string taken = claim_socket_path(socket_path);
+  if (!taken.empty()) {
+    std::fprintf(stderr, "otbvd: refusing to listen on %s: %s\n",
+                 socket_path.c_str(), taken.c_str());
+    return 1;
+  }
+  const int listen_fd =
+      ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (listen_fd < 0 ||
+      ::bind(listen_fd, reinterpret_cast<const sockaddr *>(&address),
+             sizeof(address)) ||
+      ::listen(listen_fd, SOMAXCONN)) {
+    std::fprintf(stderr, "otbvd: could not listen on %s: %s\n",
+                 socket_path.c_str(), std::strerror(errno));
+    return 1;
+  }
+
+  struct sigaction action = {};
+  action.sa_handler = on_signal;
+  ::sigaction(SIGINT, &action, nullptr);
+  ::sigaction(SIGTERM, &action, nullptr);
+  std::signal(SIGPIPE, SIG_IGN);
+  // blocked everywhere but in ppoll, so that no signal slips in between the
+  // check of stopping and the wait. Connection threads inherit the mask.
+  sigset_t signals, unblocked;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  ::pthread_sigmask(SIG_BLOCK, &signals, &unblocked);
+
+  // outlive the detached connection threads
+  VolumeCache *cache = new VolumeCache(cache_mb << 20);
+  std::atomic<size_t> *clients = new std::atomic<size_t>(0);
+  std::printf("{\"socket\":\"%s\",\"cache_mb\":%zu,\"max_clients\":%zu}\n",
+              socket_path.c_str(), cache_mb, max_clients);
+  std::fflush(stdout);
+  while (!stopping) {
+    // once every slot is taken, further clients wait in the listen backlog
+    const bool full = clients->load() >= max_clients;
+    pollfd listening = {listen_fd, POLLIN, 0};
+    const timespec recheck = {0, 100000000};
+    const int ready = ::ppoll(&listening, full ? 0 : 1,
+                              full ? &recheck : nullptr, &unblocked);
+    if (ready < 0 && EINTR != errno) {
+      std::fprintf(stderr, "otbvd: poll failed: %s\n", std::strerror(errno));
+      break;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+    const int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (EAGAIN == errno || ECONNABORTED == errno) {
+        continue;
+      }
+      std::fprintf(stderr, "otbvd: accept failed: %s\n", std::strerror(errno));
+      break;
+    }
+    (*clients)++;
+    std::thread([fd, cache, clients]() {
+      serve(fd, *cache);
+      (*clients)--;
+    }).detach();
+  }
+  ::close(listen_fd);
+  ::unlink(socket_path.c_str());
+  return 0;
+}
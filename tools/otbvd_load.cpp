@@ -0,0 +1,212 @@
+// otbvd_load: load generator for the otbvd daemon.
+//
+// Opens several connections to a running daemon, sends random queries of one
+// kind against the given files, and prints latency percentiles as JSON.
+
+#include "otbvd_protocol.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+const char USAGE[] =
+    "usage: otbvd_load [options] <file.otbv>...\n"
+    "\n"
+    "options:\n"
+    "  --socket PATH       daemon socket (default: /tmp/otbvd.sock)\n"
+    "  --op OP             info, point, slice, region or count (default: "
+    "point)\n"
+    "  --connections N     concurrent clients (default: 8)\n"
+    "  --requests N        requests per client (default: 1000)\n"
+    "  --edge N            edge of region and count boxes (default: 32)\n";
+
+struct Target {
+  std::string path;
+  uint32_t shape[3];
+};
+
+/**
+ * @brief Sends \p request and waits for the answer, reading any bulk payload
+ * once like a real client would
+ *
+ * @return false if the connection failed or the daemon reported an error
+ */
+bool query(int fd, const otbvd::Request &request, const std::string &path,
+           otbvd::Response &response) {
+  std::string message;
+  int payload_fd = -1;
+  if (!otbvd::send_request(fd, request, path) ||
+      !otbvd::receive_response(fd, response, message, payload_fd)) {
+    return false;
+  }
+  if (payload_fd >= 0) {
+    void *mapped =
+        ::mmap(nullptr, response.value, PROT_READ, MAP_SHARED, payload_fd, 0);
+    ::close(payload_fd);
+    if (MAP_FAILED == mapped) {
+      return false;
+    }
+    const uint8_t *voxels = static_cast<const uint8_t *>(mapped);
+    volatile size_t occupied =
+        std::count(voxels, voxels + response.value, uint8_t(1));
+    static_cast<void>(occupied);
+    ::munmap(mapped, response.value);
+  }
+  return OTBV_OK == response.status;
+}
+
+/**
+ * @brief Returns a random request of kind \p op against \p target
+ */
+otbvd::Request random_request(otbvd::Op op, const Target &target, uint32_t edge,
+                              std::mt19937 &rng) {
+  otbvd::Request request = {};
+  request.op = static_cast<uint8_t>(op);
+  const auto below = [&](uint32_t bound) {
+    return std::uniform_int_distribution<uint32_t>(0, bound - 1)(rng);
+  };
+  switch (op) {
+  case otbvd::Op::POINT:
+    for (int a = 0; a < 3; a++) {
+      request.args[a] = below(target.shape[a]);
+    }
+    break;
+  case otbvd::Op::SLICE:
+    request.axis = static_cast<uint8_t>(below(3));
+    request.args[0] = below(target.shape[request.axis]);
+    break;
+  case otbvd::Op::REGION:
+  case otbvd::Op::COUNT:
+    for (int a = 0; a < 3; a++) {
+      const uint32_t size = std::min(edge, target.shape[a]);
+      request.args[2 * a] = below(target.shape[a] - size + 1);
+      request.args[2 * a + 1] = request.args[2 * a] + size;
+    }
+    break;
+  default:
+    break;
+  }
+  return request;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string socket_path = otbvd::DEFAULT_SOCKET, op_name = "point";
+  size_t connections = 8, requests = 1000;
+  uint32_t edge = 32;
+  std::vector<Target> targets;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if ("--socket" == arg && has_value) {
+      socket_path = argv[++i];
+    } else if ("--op" == arg && has_value) {
+      op_name = argv[++i];
+    } else if ("--connections" == arg && has_value) {
+      connections = std::max(1ull, std::strtoull(argv[++i], nullptr, 10));
+    } else if ("--requests" == arg && has_value) {
+      requests = std::max(1ull, std::strtoull(argv[++i], nullptr, 10));
+    } else if ("--edge" == arg && has_value) {
+      edge = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+    } else if (!arg.empty() && '-' != arg[0]) {
+      targets.push_back({arg, {}});
+    } else {
+      std::fputs(USAGE, stderr);
+      return 2;
+    }
+  }
+  const char *names[] = {"info", "point", "slice", "region", "count"};
+  const auto name = std::find(std::begin(names), std::end(names), op_name);
+  if (targets.empty() || std::end(names) == name) {
+    std::fputs(USAGE, stderr);
+    return 2;
+  }
+  const otbvd::Op op = static_cast<otbvd::Op>(1 + (name - std::begin(names)));
+
+  // shapes first, which also warms the daemon's cache
+  const int probe = otbvd::connect_socket(socket_path);
+  if (probe < 0) {
+    std::fprintf(stderr, "otbvd_load: could not connect to %s\n",
+                 socket_path.c_str());
+    return 1;
+  }
+  for (Target &target : targets) {
+    otbvd::Request request = {};
+    request.op = static_cast<uint8_t>(otbvd::Op::INFO);
+    otbvd::Response response;
+    if (!query(probe, request, target.path, response)) {
+      std::fprintf(stderr, "otbvd_load: could not query %s\n",
+                   target.path.c_str());
+      return 1;
+    }
+    std::copy(response.shape, response.shape + 3, target.shape);
+  }
+  ::close(probe);
+
+  using clock = std::chrono::steady_clock;
+  std::vector<std::vector<double>> latencies(connections);
+  std::atomic<size_t> errors{0};
+  std::vector<std::thread> clients;
+  const auto start = clock::now();
+  for (size_t c = 0; c < connections; c++) {
+    clients.emplace_back([&, c]() {
+      const int fd = otbvd::connect_socket(socket_path);
+      if (fd < 0) {
+        errors += requests;
+        return;
+      }
+      std::mt19937 rng(static_cast<uint32_t>(c));
+      latencies[c].reserve(requests);
+      for (size_t r = 0; r < requests; r++) {
+        const Target &target = targets[r % targets.size()];
+        const otbvd::Request request = random_request(op, target, edge, rng);
+        otbvd::Response response;
+        const auto sent = clock::now();
+        if (!query(fd, request, target.path, response)) {
+          errors++;
+          continue;
+        }
+        latencies[c].push_back(
+            std::chrono::duration<double, std::micro>(clock::now() - sent)
+                .count());
+      }
+      ::close(fd);
+    });
+  }
+  for (auto &client : clients) {
+    client.join();
+  }
+  const double seconds =
+      std::chrono::duration<double>(clock::now() - start).count();
+
+  std::vector<double> all;
+  for (const auto &samples : latencies) {
+    all.insert(all.end(), samples.begin(), samples.end());
+  }
+  std::sort(all.begin(), all.end());
+  const auto percentile = [&](double p) {
+    return all.empty() ? 0.0 : all[std::min(all.size() - 1,
+                                            static_cast<size_t>(p * all.size()))];
+  };
+  std::printf("{\"op\":\"%s\",\"connections\":%zu,\"requests\":%zu,"
+              "\"errors\":%zu,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,"
+              "\"requests_per_s\":%.1f}\n",
+              op_name.c_str(), connections, all.size(), errors.load(),
+              percentile(0.5), percentile(0.99),
+              all.empty() ? 0.0 : all.back(), all.size() / seconds);
+  return errors ? 1 : 0;
+}
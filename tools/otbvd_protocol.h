@@ -0,0 +1,224 @@
+// Wire protocol shared by the otbvd daemon and its clients.
+//
+// Both ends run on the same host, so messages are fixed-size structs in host
+// byte order. A request is a Request followed by path_length bytes of file
+// path. A response is a Response followed by message_length bytes of error
+// message. Bulk results (slices and regions) are not sent over the socket: the
+// response carries a shared memory file descriptor (SCM_RIGHTS) holding
+// Response::value bytes of voxels, one uint8_t per voxel in C order.
+
+#pragma once
+
+#include "../include/otbv_c.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace otbvd {
+
+// "OTBD", little endian
+static constexpr uint32_t PROTOCOL_MAGIC = 0x4442544f;
+static constexpr size_t MAX_PATH_LENGTH = 4096;
+static constexpr char DEFAULT_SOCKET[] = "/tmp/otbvd.sock";
+
+enum class Op : uint8_t {
+  // shape of the volume, and the file size in value
+  INFO = 1,
+  // args x, y, z. The voxel value in value
+  POINT = 2,
+  // axis, args index. A plane of the two remaining axes, via shared memory
+  SLICE = 3,
+  // args xs, xe, ys, ye, zs, ze. The region, via shared memory
+  REGION = 4,
+  // args xs, xe, ys, ye, zs, ze. Occupied voxels of the region in value
+  COUNT = 5,
+};
+
+struct Request {
+  uint32_t magic;
+  uint8_t op;
+  uint8_t axis;
+  uint16_t path_length;
+  uint32_t args[6];
+};
+static_assert(32 == sizeof(Request), "Request must stay packed");
+
+struct Response {
+  uint32_t magic;
+  // otbv_status
+  int32_t status;
+  // result, or the payload size in bytes if a descriptor is attached
+  uint64_t value;
+  uint32_t shape[3];
+  uint32_t message_length;
+};
+static_assert(32 == sizeof(Response), "Response must stay packed");
+
+/**
+ * @brief Reads exactly \p size bytes from \p fd
+ *
+ * @return false on error or end of stream
+ */
+inline bool read_all(int fd, void *data, size_t size) {
+  char *out = static_cast<char *>(data);
+  while (size) {
+    const ssize_t got = ::read(fd, out, size);
+    if (got < 0 && EINTR == errno) {
+      continue;
+    }
+    if (got <= 0) {
+      return false;
+    }
+    out += got;
+    size -= got;
+  }
+  return true;
+}
+
+/**
+ * @brief Writes exactly \p size bytes to the socket \p fd
+ */
+inline bool write_all(int fd, const void *data, size_t size) {
+  const char *in = static_cast<const char *>(data);
+  while (size) {
+    const ssize_t sent = ::send(fd, in, size, MSG_NOSIGNAL);
+    if (sent < 0 && EINTR == errno) {
+      continue;
+    }
+    if (sent <= 0) {
+      return false;
+    }
+    in += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+/**
+ * @brief Sends \p response and \p message, attaching \p payload_fd unless it
+ * is negative
+ */
+inline bool send_response(int fd, Response response, const std::string &message,
+                          int payload_fd) {
+  response.magic = PROTOCOL_MAGIC;
+  response.message_length = static_cast<uint32_t>(message.size());
+
+  iovec io = {&response, sizeof(response)};
+  msghdr msg = {};
+  msg.msg_iov = &io;
+  msg.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  if (payload_fd >= 0) {
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &payload_fd, sizeof(int));
+  }
+  ssize_t sent;
+  do {
+    sent = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+  } while (sent < 0 && EINTR == errno);
+  if (sent <= 0) {
+    return false;
+  }
+  // the descriptor went with the first byte, the rest is plain data
+  return write_all(fd, reinterpret_cast<const char *>(&response) + sent,
+                   sizeof(response) - sent) &&
+         write_all(fd, message.data(), message.size());
+}
+
+/**
+ * @brief Receives a response and its message. \p payload_fd is set to the
+ * attached descriptor, which the caller must close, or -1.
+ */
+inline bool receive_response(int fd, Response &response, std::string &message,
+                             int &payload_fd) {
+  payload_fd = -1;
+  iovec io = {&response, sizeof(response)};
+  msghdr msg = {};
+  msg.msg_iov = &io;
+  msg.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t got;
+  do {
+    got = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+  } while (got < 0 && EINTR == errno);
+  if (got <= 0) {
+    return false;
+  }
+  for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (SOL_SOCKET == cmsg->cmsg_level && SCM_RIGHTS == cmsg->cmsg_type) {
+      std::memcpy(&payload_fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+  }
+  if (!read_all(fd, reinterpret_cast<char *>(&response) + got,
+                sizeof(response) - got) ||
+      PROTOCOL_MAGIC != response.magic) {
+    return false;
+  }
+  message.resize(response.message_length);
+  return read_all(fd, &message[0], message.size());
+}
+
+/**
+ * @brief Sends a request for \p path
+ */
+inline bool send_request(int fd, Request request, const std::string &path) {
+  request.magic = PROTOCOL_MAGIC;
+  request.path_length = static_cast<uint16_t>(path.size());
+  return path.size() <= MAX_PATH_LENGTH &&
+         write_all(fd, &request, sizeof(request)) &&
+         write_all(fd, path.data(), path.size());
+}
+
+/**
+ * @brief Fills \p address for the socket at \p path
+ *
+ * @return false if the path does not fit
+ */
+inline bool socket_address(const std::string &path, sockaddr_un &address) {
+  address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+/**
+ * @brief Connects to the daemon listening on \p path
+ *
+ * @return The connected socket, or -1
+ */
+inline int connect_socket(const std::string &path) {
+  sockaddr_un address;
+  if (!socket_address(path, address)) {
+    return -1;
+  }
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (::connect(fd, reinterpret_cast<const sockaddr *>(&address),
+                sizeof(address))) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+} // namespace otbvd